@@ -17,7 +17,7 @@ echo "deb-src http://packages.ros.org/ros/ubuntu xenial main" >> /etc/apt/source
 
 apt-get update
 ##--- install ros-kinetic-desktop-full
-apt-get install -y ros-kinetic-desktop-full ros-kinetic-rviz-visual-tools ros-kinetic-ompl autoconf libtool
+apt-get install -y ros-kinetic-desktop-full ros-kinetic-rviz-visual-tools ros-kinetic-ompl autoconf libtool liblz4-dev libzstd-dev
 
 ############
 # ROS OpenCV (installation)
@@ -89,12 +89,25 @@ fi
 cd $base_dir/src/pcl
 if [[ ! `git status --porcelain`  ]]; then
     cp $base_dir/build_scripts/lzf_image_io.cpp $base_dir/src/pcl/io/src/ 
+    cp $base_dir/build_scripts/lzf_image_io.h $base_dir/src/pcl/io/include/pcl/io/ 
+    cp $base_dir/build_scripts/lzf_image_io.hpp $base_dir/src/pcl/io/include/pcl/io/impl/
+    cp $base_dir/build_scripts/lzf_image_io_deps.cmake $base_dir/src/pcl/io/
+    echo 'include(${CMAKE_CURRENT_SOURCE_DIR}/lzf_image_io_deps.cmake)' >> $base_dir/src/pcl/io/CMakeLists.txt
 fi
 
 cd $base_dir/src/pcl && mkdir -p build && cd build && cmake -DCMAKE_BUILD_TYPE=Release -DCMAKE_CXX_FLAGS="-std=c++11" ..
 cd $base_dir/src/pcl/build && make -j 2
 cd $base_dir/src/pcl/build && make -j 2 install
 
+#--- LZF image I/O microbenchmark and replay harness (built against the pcl installed above)
+pcl_io_pc=$(basename $(ls /usr/local/lib/pkgconfig/pcl_io-*.pc | head -n 1) .pc)
+cd $base_dir/test_benches/benchmarks && \
+    g++ -std=c++11 -O2 -fopenmp lzf_image_io_bench.cpp -o lzf_image_io_bench \
+    $(PKG_CONFIG_PATH=/usr/local/lib/pkgconfig pkg-config --cflags --libs $pcl_io_pc) -lboost_filesystem -lboost_system
+cd $base_dir/test_benches/benchmarks && \
+    g++ -std=c++11 -O2 -fopenmp -pthread lzf_replay.cpp -o lzf_replay \
+    $(PKG_CONFIG_PATH=/usr/local/lib/pkgconfig pkg-config --cflags --libs $pcl_io_pc) -lboost_filesystem -lboost_system
+
 
 ########
 # AirSim 
@@ -36,10 +36,16 @@
  */
 #include <pcl/console/time.h>
 #include <pcl/io/lzf_image_io.h>
-#include <pcl/io/lzf.h>
 #include <pcl/console/print.h>
 #include <fcntl.h>
 #include <string.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <sstream>
 #include <boost/filesystem.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -50,507 +56,5495 @@
 # define pcl_open                    _open
 # define pcl_close(fd)               _close(fd)
 # define pcl_lseek(fd,offset,origin) _lseek(fd,offset,origin)
+# define pcl_write(fd,buf,size)      _write(fd,buf,size)
+# define pcl_ftruncate(fd,size)      _chsize_s(fd,size)
 #else
 # include <sys/mman.h>
-# define pcl_open                    open
-# define pcl_close(fd)               close(fd)
+# include <sys/stat.h>
+# include <sys/uio.h>
+# include <unistd.h>
+# define pcl_open                    ::open
+# define pcl_close(fd)               ::close(fd)
 # define pcl_lseek(fd,offset,origin) lseek(fd,offset,origin)
+# define pcl_write(fd,buf,size)      ::write(fd,buf,size)
+# define pcl_ftruncate(fd,size)      ftruncate(fd,size)
+#endif
+
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+#ifdef HAVE_LZ4
+# include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+#if defined(__linux__)
+# include <linux/futex.h>
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define PCL_LZF_X86_SIMD
+# include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+# define PCL_LZF_NEON_SIMD
+# include <arm_neon.h>
 #endif
 
 #define LZF_HEADER_SIZE 37
 
+// Extended (banded) header: the 37 byte PCLZF header with a "PCLZX"
+// signature, followed by version, flags, codec id (version 3 and up, 0 before),
+// number of pyramid levels (version 4 and up, 0 before), the number of
+// uncompressed bytes per band, the number of bands and one uint32_t compressed
+// size per band. With LZF_EXT_FLAG_PYRAMID, a level table (width, height,
+// scale, compressed and uncompressed size) and the compressed levels follow,
+// ahead of the bands. With LZF_EXT_FLAG_QUANTIZED (version 5 and up), the
+// bin size and the largest depth value of a quantized image sit between the
+// band table and the level table. With LZF_EXT_FLAG_REFERENCE (version 6 and
+// up), the 64-bit hash of the image a "depth16t" image was taken against
+// follows. Writers use the lowest version able to describe the image.
+// LZF_EXT_FLAG_STORED marks images written without any compression (a single
+// band stored as is); older readers ignore it and read the band as stored.
+#define LZF_EXT_HEADER_SIZE      49
+#define LZF_EXT_HEADER_VERSION   6
+#define LZF_EXT_HEADER_VERSION_QUANTIZED 5
+#define LZF_EXT_HEADER_VERSION_PYRAMID  4
+#define LZF_EXT_HEADER_VERSION_CODEC    3
+#define LZF_EXT_HEADER_VERSION_LZF_ONLY 2
+#define LZF_EXT_BAND_ENTRY_SIZE  4
+#define LZF_EXT_LEVEL_ENTRY_SIZE 20
+#define LZF_EXT_QUANT_ENTRY_SIZE 8
+#define LZF_EXT_REF_ENTRY_SIZE   8
+#define LZF_EXT_FLAG_PYRAMID     0x01
+#define LZF_EXT_FLAG_STORED      0x02
+#define LZF_EXT_FLAG_QUANTIZED   0x04
+#define LZF_EXT_FLAG_REFERENCE   0x08
+#define LZF_MAX_PYRAMID_LEVELS   8
+
+#define LZF_STREAM_HEADER_SIZE        8
+#define LZF_STREAM_RECORD_HEADER_SIZE 12
+#define LZF_STREAM_INDEX_ENTRY_SIZE   20
+#define LZF_STREAM_FOOTER_SIZE        16
+#define LZF_STREAM_VERSION            1
+
+#define LZF_FRAME_INDEX_HEADER_SIZE   8
+#define LZF_FRAME_INDEX_RECORD_SIZE   18    // + file name
+#define LZF_FRAME_INDEX_VERSION       1
+
+// Flight recorder ring records: 64-bit timestamp, 32-bit blob size, 4 bytes
+// of padding and the blob, rounded up to 8 bytes
+#define LZF_RECORDER_RECORD_HEADER_SIZE 16
+#define LZF_RECORDER_WRAP               0xffffffffu
+
+// Shared memory ring: a control block, then one slot header and one blob area
+// per slot (see LZFSharedRingWriter). Control block fields: nr slots [8],
+// slot size [12], number of published images [16], wake up counter [24],
+// number of waiting readers [28], closed flag [32]. Slot header fields:
+// sequence word [0], timestamp [8], blob size [16].
+#define LZF_RING_HEADER_SIZE      64
+#define LZF_RING_SLOT_HEADER_SIZE 64
+#define LZF_RING_VERSION          1
+
+// LZF format: a control byte below 32 starts a run of (byte + 1) literals,
+// anything else is a back reference of (byte >> 5) + 2 bytes, the length
+// continuing in the next byte when (byte >> 5) is 7, followed by the low byte
+// of the distance - 1. The kernels below write the same format as liblzf.
+#define LZF_HASH_LOG   13
+#define LZF_MAX_LIT    (1 << 5)
+#define LZF_MAX_OFF    (1 << 13)
+#define LZF_MAX_REF    ((1 << 8) + (1 << 3))
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define PCL_LZF_WORD_MATCH
+#endif
+
+namespace
+{
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Map a whole file read-only. Returns NULL on failure. The file
+    * descriptor is closed before returning, the mapping stays valid until
+    * unmapFile is called.
+    */
+  char*
+  mapFile (const std::string &filename, uint64_t &size)
+  {
+    int fd = pcl_open (filename.c_str (), O_RDONLY);
+    if (fd == -1)
+      return (NULL);
+
+    off_t data_size = pcl_lseek (fd, 0, SEEK_END);
+    if (data_size <= 0)
+    {
+      pcl_close (fd);
+      return (NULL);
+    }
+    pcl_lseek (fd, 0, SEEK_SET);
+    size = static_cast<uint64_t> (data_size);
+
+#ifdef _WIN32
+    HANDLE fm = CreateFileMapping ((HANDLE) _get_osfhandle (fd), NULL, PAGE_READONLY, 0, 0, NULL);
+    char *map = static_cast<char*> (MapViewOfFile (fm, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle (fm);
+    pcl_close (fd);
+    return (map);
+#else
+    char *map = static_cast<char*> (mmap (0, data_size, PROT_READ, MAP_SHARED, fd, 0));
+    pcl_close (fd);
+    if (map == reinterpret_cast<char*> (-1))    // MAP_FAILED
+      return (NULL);
+    return (map);
+#endif
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  unmapFile (char *map, uint64_t size)
+  {
+#ifdef _WIN32
+    (void) size;
+    UnmapViewOfFile (map);
+#else
+    munmap (map, size);
+#endif
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Ask the kernel to start reading a whole file in the background. */
+  void
+  adviseWillNeed (const std::string &filename)
+  {
+#ifdef POSIX_FADV_WILLNEED
+    int fd = pcl_open (filename.c_str (), O_RDONLY);
+    if (fd == -1)
+      return;
+    posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+    pcl_close (fd);
+#else
+    (void) filename;
+#endif
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Ask the kernel to start paging in a range of a file mapping. */
+  void
+  adviseWillNeed (const char *address, uint64_t size)
+  {
+#ifndef _WIN32
+    // madvise wants a page aligned start address
+    uintptr_t page_size = static_cast<uintptr_t> (sysconf (_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t> (address) & ~(page_size - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t> (address) + size;
+    madvise (reinterpret_cast<void*> (begin), end - begin, MADV_WILLNEED);
+#else
+    (void) address;
+    (void) size;
+#endif
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Fill in the 37 byte part common to all PCLZF headers. */
+  void
+  writeHeader (char *output, const char *signature,
+               uint32_t width, uint32_t height,
+               const std::string &image_type,
+               uint32_t compressed_size, uint32_t uncompressed_size)
+  {
+    memcpy (&output[0],  signature, 5);
+    memcpy (&output[5],  &width, sizeof (uint32_t));
+    memcpy (&output[9],  &height, sizeof (uint32_t));
+    // Cut or pad the string, without going through a temporary std::string
+    size_t itype_size = image_type.size ();
+    if (itype_size > 16)
+    {
+      PCL_WARN ("[pcl::io::LZFImageWriter::compress] Image type should be a string of maximum 16 characters! Cutting %s to %s.\n", image_type.c_str (), image_type.substr (0, 15).c_str ());
+      itype_size = 15;
+    }
+    memset (&output[13], ' ', 16);
+    memcpy (&output[13], image_type.c_str (), itype_size);
+    memcpy (&output[29], &compressed_size, sizeof (uint32_t));
+    memcpy (&output[33], &uncompressed_size, sizeof (uint32_t));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Check the (space padded) image type identifier read from a header. */
+  bool
+  hasImageType (const std::string &identifier, const char *image_type)
+  {
+    size_t size = strlen (image_type);
+    if (identifier.compare (0, size, image_type) != 0)
+      return (false);
+    return (identifier.size () == size || identifier[size] == ' ' || identifier[size] == '\0');
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Check whether a PCLZF blob holds a "depth16t" image, i.e. depends on the previous image. */
+  bool
+  isTemporalBlob (const char *blob, size_t blob_size)
+  {
+    if (blob_size < LZF_HEADER_SIZE)
+      return (false);
+    return (hasImageType (std::string (&blob[13], 16), "depth16t"));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief 64-bit hash of an image, 8 bytes at a time, identifying the reference of a "depth16t" image. */
+  uint64_t
+  hashImage (const char *data, size_t size)
+  {
+    uint64_t hash = 14695981039346656037ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+      uint64_t word;
+      memcpy (&word, &data[i], sizeof (uint64_t));
+      hash = (hash ^ word) * 1099511628211ull;
+      hash ^= hash >> 29;
+    }
+    for (; i < size; ++i)
+      hash = (hash ^ static_cast<unsigned char> (data[i])) * 1099511628211ull;
+    return (hash);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Resolve a user given thread count, where 0 lets OpenMP decide. */
+  int
+  getNumberOfThreads (unsigned int nr_threads)
+  {
+#ifdef _OPENMP
+    return (nr_threads > 0 ? static_cast<int> (nr_threads) : omp_get_max_threads ());
+#else
+    (void) nr_threads;
+    return (1);
+#endif
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Grow a scratch buffer to at least \a size bytes. The buffer never
+    * shrinks, so a stream of same-sized images only allocates once.
+    */
+  char*
+  growBuffer (std::vector<char> &buffer, size_t size)
+  {
+    if (buffer.size () < size)
+      buffer.resize (size);
+    return (&buffer[0]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Write the whole buffer, retrying on short writes. */
+  bool
+  writeAll (int fd, const char *data, size_t size)
+  {
+    while (size > 0)
+    {
+      int written = static_cast<int> (pcl_write (fd, data, static_cast<unsigned int> (size)));
+      if (written <= 0)
+      {
+        if (written < 0 && errno == EINTR)
+          continue;
+        return (false);
+      }
+      data += written;
+      size -= written;
+    }
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Decimate a depth image by \a scale in both directions, keeping
+    * the minimum valid (non zero) depth of every block. Blocks without any
+    * valid depth stay 0.
+    */
+  void
+  minPoolDepth16 (const char *depth, uint32_t width, uint32_t height, uint32_t scale, char *output)
+  {
+    uint32_t out_width = (width + scale - 1) / scale, out_height = (height + scale - 1) / scale;
+    uint16_t *out = reinterpret_cast<uint16_t*> (output);
+    for (uint32_t v = 0; v < out_height; ++v)
+    {
+      uint16_t *row = &out[size_t (v) * out_width];
+      std::fill (row, row + out_width, std::numeric_limits<uint16_t>::max ());
+      // 0 - 1 wraps around to the largest value, so invalid depths never win
+      for (uint32_t y = v * scale; y < std::min ((v + 1) * scale, height); ++y)
+      {
+        const char *src = &depth[size_t (y) * width * 2];
+        for (uint32_t x = 0; x < width; ++x)
+        {
+          uint16_t value;
+          memcpy (&value, &src[x * 2], sizeof (uint16_t));
+          row[x / scale] = std::min (row[x / scale], static_cast<uint16_t> (value - 1));
+        }
+      }
+      for (uint32_t u = 0; u < out_width; ++u)
+        row[u] = static_cast<uint16_t> (row[u] + 1);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Sort the frames of an index by timestamp. \a order is left empty
+    * if the frames already are in capture time order.
+    */
+  template <typename EntryT> void
+  buildTimeOrder (const std::vector<EntryT> &entries, std::vector<size_t> &order)
+  {
+    order.clear ();
+    for (size_t i = 1; i < entries.size (); ++i)
+    {
+      if (entries[i].timestamp >= entries[i - 1].timestamp)
+        continue;
+      order.resize (entries.size ());
+      for (size_t j = 0; j < order.size (); ++j)
+        order[j] = j;
+      std::stable_sort (order.begin (), order.end (),
+                        [&entries] (size_t a, size_t b) { return (entries[a].timestamp < entries[b].timestamp); });
+      return;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Frame number at a given position in capture time order. */
+  inline size_t
+  frameAt (const std::vector<size_t> &order, size_t position)
+  {
+    return (order.empty () ? position : order[position]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Position in capture time order of the first frame captured at or after \a timestamp. */
+  template <typename EntryT> size_t
+  lowerBound (const std::vector<EntryT> &entries, const std::vector<size_t> &order, uint64_t timestamp)
+  {
+    size_t first = 0, count = entries.size ();
+    while (count > 0)
+    {
+      size_t step = count / 2;
+      if (entries[frameAt (order, first + step)].timestamp < timestamp)
+      {
+        first += step + 1;
+        count -= step + 1;
+      }
+      else
+        count = step;
+    }
+    return (first);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename EntryT> bool
+  findFrame (const std::vector<EntryT> &entries, const std::vector<size_t> &order,
+             uint64_t timestamp, size_t &index)
+  {
+    // Last frame captured at or before the timestamp
+    size_t position = lowerBound (entries, order, timestamp);
+    if (position < entries.size () && entries[frameAt (order, position)].timestamp == timestamp)
+    {
+      while (position + 1 < entries.size () && entries[frameAt (order, position + 1)].timestamp == timestamp)
+        ++position;
+    }
+    else if (position == 0)
+      return (false);
+    else
+      --position;
+    index = frameAt (order, position);
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename EntryT> bool
+  findNearestFrame (const std::vector<EntryT> &entries, const std::vector<size_t> &order,
+                    uint64_t timestamp, size_t &index)
+  {
+    if (entries.empty ())
+      return (false);
+    size_t position = lowerBound (entries, order, timestamp);
+    if (position == entries.size () ||
+        (position > 0 && timestamp - entries[frameAt (order, position - 1)].timestamp <
+                         entries[frameAt (order, position)].timestamp - timestamp))
+      --position;
+    index = frameAt (order, position);
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  template <typename EntryT> size_t
+  findFrames (const std::vector<EntryT> &entries, const std::vector<size_t> &order,
+              uint64_t begin, uint64_t end, std::vector<size_t> &indices)
+  {
+    indices.clear ();
+    for (size_t position = lowerBound (entries, order, begin);
+         position < entries.size () && entries[frameAt (order, position)].timestamp < end; ++position)
+      indices.push_back (frameAt (order, position));
+    return (indices.size ());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Look up a numeric parameter parsed from a parameters file. */
+  bool
+  getParameter (const pcl::io::LZFImageReader::ParameterMap &values,
+                const char *tag, double &value)
+  {
+    pcl::io::LZFImageReader::ParameterMap::const_iterator it = values.find (tag);
+    if (it == values.end ())
+      return (false);
+    value = it->second;
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Collect the numeric leaves of a property tree, indexed by their path. */
+  void
+  flattenParameters (const boost::property_tree::ptree &tree, const std::string &path,
+                     pcl::io::LZFImageReader::ParameterMap &values)
+  {
+    for (boost::property_tree::ptree::const_iterator it = tree.begin (); it != tree.end (); ++it)
+    {
+      if (it->first == "<xmlattr>" || it->first == "<xmlcomment>")
+        continue;
+      std::string child_path = path.empty () ? it->first : path + "." + it->first;
+      if (it->second.empty ())
+      {
+        boost::optional<double> value = it->second.get_value_optional<double> ();
+        if (value)
+          values[child_path] = *value;
+      }
+      else
+        flattenParameters (it->second, child_path, values);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Fast parser for the plain element-only XML files written by the
+    * LZF writers. Returns false for anything it does not understand (DTDs,
+    * CDATA, malformed nesting, ...), in which case the caller falls back to
+    * boost::property_tree.
+    */
+  bool
+  parseParametersFast (const std::string &xml, pcl::io::LZFImageReader::ParameterMap &values)
+  {
+    std::vector<std::string> path;
+    std::string key;
+    size_t pos = 0, text_begin = 0;
+    bool leaf = false;
+    while (pos < xml.size ())
+    {
+      size_t lt = xml.find ('<', pos);
+      if (lt == std::string::npos)
+        break;
+      if (xml.compare (lt, 4, "<!--") == 0)
+      {
+        size_t end = xml.find ("-->", lt + 4);
+        if (end == std::string::npos)
+          return (false);
+        pos = end + 3;
+        continue;
+      }
+      if (lt + 1 >= xml.size () || xml[lt + 1] == '!')
+        return (false);
+      size_t gt = xml.find ('>', lt);
+      if (gt == std::string::npos)
+        return (false);
+
+      if (xml[lt + 1] == '?')                               // XML declaration
+      {
+        pos = gt + 1;
+        continue;
+      }
+
+      if (xml[lt + 1] == '/')                               // closing tag
+      {
+        size_t name_end = xml.find_first_of (" \t\r\n>", lt + 2);
+        if (path.empty () || xml.compare (lt + 2, name_end - lt - 2, path.back ()) != 0)
+          return (false);
+        if (leaf)
+        {
+          std::string text = xml.substr (text_begin, lt - text_begin);
+          const char *begin = text.c_str ();
+          char *end;
+          double value = strtod (begin, &end);
+          while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n')
+            ++end;
+          if (end != begin && *end == '\0')
+          {
+            key.clear ();
+            for (size_t i = 0; i < path.size (); ++i)
+              key.append (i == 0 ? "" : ".").append (path[i]);
+            values[key] = value;
+          }
+        }
+        path.pop_back ();
+        leaf = false;
+        pos = gt + 1;
+        continue;
+      }
+
+      // Opening tag. Attributes are ignored, as property_tree files do not use them.
+      size_t name_end = xml.find_first_of (" \t\r\n/>", lt + 1);
+      if (name_end == lt + 1)
+        return (false);
+      if (xml[gt - 1] != '/')
+      {
+        path.push_back (xml.substr (lt + 1, name_end - lt - 1));
+        leaf = true;
+        text_begin = gt + 1;
+      }
+      else
+        leaf = false;
+      pos = gt + 1;
+    }
+    return (path.empty ());
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Parse a parameters file, trying the fast parser first. */
+  bool
+  parseParameters (std::istream &is, pcl::io::LZFImageReader::ParameterMap &values)
+  {
+    std::string xml ((std::istreambuf_iterator<char> (is)), std::istreambuf_iterator<char> ());
+    if (parseParametersFast (xml, values))
+      return (true);
+
+    values.clear ();
+    boost::property_tree::ptree pt;
+    try
+    {
+      std::istringstream xml_stream (xml);
+      read_xml (xml_stream, pt, boost::property_tree::xml_parser::trim_whitespace);
+    }
+    catch (std::exception &e)
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::readParameters] Error parsing parameters: %s\n", e.what ());
+      return (false);
+    }
+    flattenParameters (pt, "", values);
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Process wide cache of parsed parameters files. Entries are
+    * checked against the identity of the file (device, inode), its size and
+    * its modification and change times in nanoseconds on every lookup.
+    */
+  class ParametersCache
+  {
+    public:
+      typedef boost::shared_ptr<const pcl::io::LZFImageReader::ParameterMap> ParameterMapConstPtr;
+
+      ParameterMapConstPtr
+      get (const std::string &filename)
+      {
+        FileVersion version;
+        if (!getFileVersion (filename, version))
+          return (ParameterMapConstPtr ());
+
+        {
+          std::lock_guard<std::mutex> lock (mutex_);
+          std::map<std::string, Entry>::const_iterator it = entries_.find (filename);
+          if (it != entries_.end () && it->second.version == version)
+            return (it->second.values);
+        }
+
+        std::ifstream is (filename.c_str ());
+        if (!is)
+          return (ParameterMapConstPtr ());
+        boost::shared_ptr<pcl::io::LZFImageReader::ParameterMap> values (new pcl::io::LZFImageReader::ParameterMap);
+        if (!parseParameters (is, *values))
+          return (ParameterMapConstPtr ());
+
+        std::lock_guard<std::mutex> lock (mutex_);
+        Entry &entry = entries_[filename];
+        entry.version = version;
+        entry.values = values;
+        return (values);
+      }
+
+      void
+      invalidate (const std::string &filename)
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        entries_.erase (filename);
+      }
+
+      void
+      clear ()
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        entries_.clear ();
+      }
+
+    private:
+      struct FileVersion
+      {
+        uint64_t device, inode, size;
+        int64_t mtime_ns, ctime_ns;
+
+        bool
+        operator == (const FileVersion &other) const
+        {
+          return (device == other.device && inode == other.inode && size == other.size &&
+                  mtime_ns == other.mtime_ns && ctime_ns == other.ctime_ns);
+        }
+      };
+
+      /** \brief Stat a file. A rewrite within the same second, or a file
+        * replaced by a rename, changes at least one of the fields.
+        */
+      static bool
+      getFileVersion (const std::string &filename, FileVersion &version)
+      {
+#ifdef _WIN32
+        boost::system::error_code ec;
+        version.device = version.inode = 0;
+        version.mtime_ns = static_cast<int64_t> (boost::filesystem::last_write_time (filename, ec)) * 1000000000;
+        version.ctime_ns = 0;
+        if (ec)
+          return (false);
+        version.size = boost::filesystem::file_size (filename, ec);
+        return (!ec);
+#else
+        struct stat st;
+        if (::stat (filename.c_str (), &st) != 0)
+          return (false);
+        version.device = static_cast<uint64_t> (st.st_dev);
+        version.inode = static_cast<uint64_t> (st.st_ino);
+        version.size = static_cast<uint64_t> (st.st_size);
+# ifdef __APPLE__
+        version.mtime_ns = int64_t (st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+        version.ctime_ns = int64_t (st.st_ctimespec.tv_sec) * 1000000000 + st.st_ctimespec.tv_nsec;
+# else
+        version.mtime_ns = int64_t (st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        version.ctime_ns = int64_t (st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+# endif
+        return (true);
+#endif
+      }
+
+      struct Entry
+      {
+        FileVersion version;
+        ParameterMapConstPtr values;
+      };
+
+      std::mutex mutex_;
+      std::map<std::string, Entry> entries_;
+  };
+
+  ParametersCache&
+  getParametersCache ()
+  {
+    static ParametersCache cache;
+    return (cache);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Per thread perf_event counters for the cycles and cache misses of
+    * the calling thread, opened on first use.
+    */
+  class PerfCounters
+  {
+    public:
+      PerfCounters ()
+        : cycles_fd_ (openCounter (PERF_COUNT_HW_CPU_CYCLES_ID))
+        , cache_misses_fd_ (openCounter (PERF_COUNT_HW_CACHE_MISSES_ID))
+      {}
+
+      ~PerfCounters ()
+      {
+        if (cycles_fd_ >= 0)
+          pcl_close (cycles_fd_);
+        if (cache_misses_fd_ >= 0)
+          pcl_close (cache_misses_fd_);
+      }
+
+      bool
+      read (uint64_t &cycles, uint64_t &cache_misses) const
+      {
+        if (cycles_fd_ < 0 || cache_misses_fd_ < 0)
+          return (false);
+        return (::read (cycles_fd_, &cycles, sizeof (uint64_t)) == sizeof (uint64_t) &&
+                ::read (cache_misses_fd_, &cache_misses, sizeof (uint64_t)) == sizeof (uint64_t));
+      }
+
+    private:
+#if defined(__linux__)
+      static const uint64_t PERF_COUNT_HW_CPU_CYCLES_ID = PERF_COUNT_HW_CPU_CYCLES;
+      static const uint64_t PERF_COUNT_HW_CACHE_MISSES_ID = PERF_COUNT_HW_CACHE_MISSES;
+
+      static int
+      openCounter (uint64_t config)
+      {
+        struct perf_event_attr attr;
+        memset (&attr, 0, sizeof (attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof (attr);
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (static_cast<int> (syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0)));
+      }
+#else
+      static const uint64_t PERF_COUNT_HW_CPU_CYCLES_ID = 0;
+      static const uint64_t PERF_COUNT_HW_CACHE_MISSES_ID = 1;
+
+      static int
+      openCounter (uint64_t)
+      {
+        return (-1);
+      }
+#endif
+
+      int cycles_fd_;
+      int cache_misses_fd_;
+  };
+
+  bool
+  readPerfCounters (uint64_t &cycles, uint64_t &cache_misses)
+  {
+    static thread_local PerfCounters counters;
+    return (counters.read (cycles, cache_misses));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Times the enclosing scope into a stage of an LZFIOStatistics
+    * object. Does nothing if no statistics object is given.
+    */
+  class StageTimer
+  {
+    public:
+      StageTimer (pcl::io::LZFIOStatistics *statistics, pcl::io::LZFIOStatistics::Stage stage)
+        : statistics_ (statistics)
+        , stage_ (stage)
+        , perf_ (false)
+        , cycles_ (0)
+        , cache_misses_ (0)
+      {
+        if (!statistics_)
+          return;
+        perf_ = statistics_->getPerfCountersEnabled () && readPerfCounters (cycles_, cache_misses_);
+        start_ = std::chrono::steady_clock::now ();
+      }
+
+      ~StageTimer ()
+      {
+        if (!statistics_)
+          return;
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now () - start_).count ();
+        uint64_t cycles = 0, cache_misses = 0;
+        if (perf_ && readPerfCounters (cycles, cache_misses))
+        {
+          cycles -= cycles_;
+          cache_misses -= cache_misses_;
+        }
+        else
+          cycles = cache_misses = 0;
+        statistics_->record (stage_, ns, cycles, cache_misses);
+      }
+
+    private:
+      pcl::io::LZFIOStatistics *statistics_;
+      pcl::io::LZFIOStatistics::Stage stage_;
+      bool perf_;
+      uint64_t cycles_;
+      uint64_t cache_misses_;
+      std::chrono::steady_clock::time_point start_;
+  };
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Largest LZF output for \a size input bytes: a control byte every 32 literals. */
+  inline size_t
+  lzfMaxCompressedSize (size_t size)
+  {
+    return (((size * 33) >> 5) + 1);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Copy a run of literals, behind its control bytes. False if the output is full. */
+  inline bool
+  lzfWriteLiterals (const unsigned char *literals, const unsigned char *end, const unsigned char *in_end,
+                    unsigned char *&op, const unsigned char *out_end)
+  {
+    while (literals < end)
+    {
+      size_t run = std::min<size_t> (end - literals, LZF_MAX_LIT);
+      if (size_t (out_end - op) < run + 1)
+        return (false);
+      *op++ = static_cast<unsigned char> (run - 1);
+      // Whole runs are copied with fixed size moves where both buffers have room for them
+      if (out_end - op >= LZF_MAX_LIT && in_end - literals >= LZF_MAX_LIT)
+        memcpy (op, literals, LZF_MAX_LIT);
+      else
+        memcpy (op, literals, run);
+      op += run;
+      literals += run;
+    }
+    return (true);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief The 3 bytes at \a p, first one lowest. Reads a 4th byte with PCL_LZF_WORD_MATCH. */
+  inline uint32_t
+  lzfLoad24 (const unsigned char *p)
+  {
+#ifdef PCL_LZF_WORD_MATCH
+    uint32_t word;
+    memcpy (&word, p, 4);
+    return (word & 0xffffff);
+#else
+    return (p[0] | (p[1] << 8) | (p[2] << 16));
+#endif
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Hash table slot of 3 input bytes. */
+  inline uint32_t
+  lzfHash (uint32_t sequence)
+  {
+    return ((sequence * 2654435761u) >> (32 - LZF_HASH_LOG));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief LZF compression, the output of which any LZF decompressor reads.
+    *
+    * Unlike liblzf, the hash table holds 32-bit positions (32 KB, i.e. L1
+    * sized), matches are extended 8 bytes at a time and literals are moved
+    * as whole runs. Never writes more than lzfMaxCompressedSize (input_size).
+    * \return the compressed size, 0 if it does not fit \a output_size
+    */
+  uint32_t
+  lzfCompressData (const char *input, uint32_t input_size, char *output, uint32_t output_size)
+  {
+    if (input_size == 0 || output_size == 0)
+      return (0);
+    const unsigned char *in = reinterpret_cast<const unsigned char*> (input);
+    const unsigned char *in_end = in + input_size;
+    unsigned char *op = reinterpret_cast<unsigned char*> (output);
+    const unsigned char *out_end = op + output_size;
+
+    uint32_t hash_table[1 << LZF_HASH_LOG];
+    memset (hash_table, 0, sizeof (hash_table));
+    const unsigned char *ip = in, *literals = in;
+    // The next 3 input bytes (first one lowest), rolled in one byte at a time
+    uint32_t sequence = input_size >= 2 ? (ip[0] << 8) | (ip[1] << 16) : 0;
+    while (in_end - ip >= 3)
+    {
+      sequence = (sequence >> 8) | (ip[2] << 16);
+      uint32_t &slot = hash_table[lzfHash (sequence)];
+      const unsigned char *ref = in + slot;
+      slot = static_cast<uint32_t> (ip - in);
+      // ref + 4 <= ip + 3 <= in_end, lzfLoad24 stays within the input
+      if (ref >= ip || ip - ref > LZF_MAX_OFF || lzfLoad24 (ref) != sequence)
+      {
+        ++ip;
+        continue;
+      }
+
+      size_t max_length = std::min<size_t> (in_end - ip, LZF_MAX_REF);
+      size_t length = 3;
+#ifdef PCL_LZF_WORD_MATCH
+      while (length + 8 <= max_length)
+      {
+        uint64_t a, b;
+        memcpy (&a, &ref[length], 8);
+        memcpy (&b, &ip[length], 8);
+        if (a != b)
+        {
+          length += __builtin_ctzll (a ^ b) >> 3;
+          max_length = length;
+        }
+        else
+          length += 8;
+      }
+#endif
+      while (length < max_length && ref[length] == ip[length])
+        ++length;
+
+      if (!lzfWriteLiterals (literals, ip, in_end, op, out_end))
+        return (0);
+      size_t offset = ip - ref - 1;
+      size_t code = length - 2;
+      if (size_t (out_end - op) < (code < 7 ? 2u : 3u))
+        return (0);
+      if (code < 7)
+        *op++ = static_cast<unsigned char> ((offset >> 8) + (code << 5));
+      else
+      {
+        *op++ = static_cast<unsigned char> ((offset >> 8) + (7 << 5));
+        *op++ = static_cast<unsigned char> (code - 7);
+      }
+      *op++ = static_cast<unsigned char> (offset);
+      ip += length;
+      literals = ip;
+
+      // The end of a match is the most likely start of the next one
+      for (const unsigned char *p = ip - 2; p < ip && in_end - p >= 3; ++p)
+        hash_table[lzfHash (p[0] | (p[1] << 8) | (p[2] << 16))] = static_cast<uint32_t> (p - in);
+      if (in_end - ip >= 2)
+        sequence = (ip[0] << 8) | (ip[1] << 16);
+    }
+    if (!lzfWriteLiterals (literals, in_end, in_end, op, out_end))
+      return (0);
+    return (static_cast<uint32_t> (op - reinterpret_cast<unsigned char*> (output)));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief LZF decompression, with the bounds checks (and errno values) of liblzf.
+    *
+    * Literal runs and back references are moved with fixed size, possibly
+    * overlapping copies while the output has room for them, byte by byte
+    * near its end and for references closer than 8 bytes.
+    * \return the decompressed size, 0 on error (errno E2BIG if the output is
+    * too small, EINVAL if the data is corrupted)
+    */
+  uint32_t
+  lzfDecompressData (const char *input, uint32_t input_size, char *output, uint32_t output_size)
+  {
+    const unsigned char *ip = reinterpret_cast<const unsigned char*> (input);
+    const unsigned char *in_end = ip + input_size;
+    unsigned char *out = reinterpret_cast<unsigned char*> (output);
+    unsigned char *op = out;
+    const unsigned char *out_end = out + output_size;
+
+    while (ip < in_end)
+    {
+      size_t ctrl = *ip++;
+      if (ctrl < LZF_MAX_LIT)
+      {
+        size_t length = ctrl + 1;
+        if (size_t (out_end - op) < length)
+        {
+          errno = E2BIG;
+          return (0);
+        }
+        if (size_t (in_end - ip) < length)
+        {
+          errno = EINVAL;
+          return (0);
+        }
+        if (out_end - op >= LZF_MAX_LIT && in_end - ip >= LZF_MAX_LIT)
+          memcpy (op, ip, LZF_MAX_LIT);
+        else
+          memcpy (op, ip, length);
+        op += length;
+        ip += length;
+        continue;
+      }
+
+      size_t length = ctrl >> 5;
+      if (length == 7)
+      {
+        if (ip >= in_end)
+        {
+          errno = EINVAL;
+          return (0);
+        }
+        length += *ip++;
+      }
+      length += 2;
+      if (ip >= in_end)
+      {
+        errno = EINVAL;
+        return (0);
+      }
+      size_t distance = ((ctrl & 0x1f) << 8) + *ip++ + 1;
+      if (size_t (out_end - op) < length)
+      {
+        errno = E2BIG;
+        return (0);
+      }
+      if (size_t (op - out) < distance)
+      {
+        errno = EINVAL;
+        return (0);
+      }
+
+      const unsigned char *ref = op - distance;
+      if (distance >= 8 && size_t (out_end - op) >= length + 8)
+      {
+        // 8 byte moves, each reading bytes written before it; the up to 7 bytes written past the match are overwritten later
+        unsigned char *end = op + length;
+        do
+        {
+          memcpy (op, ref, 8);
+          op += 8;
+          ref += 8;
+        }
+        while (op < end);
+        op = end;
+      }
+      else
+      {
+        for (size_t i = 0; i < length; ++i)
+          op[i] = ref[i];
+        op += length;
+      }
+    }
+    return (static_cast<uint32_t> (op - out));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  class LZFCodec : public pcl::io::ImageCodec
+  {
+    public:
+      virtual Id getId () const { return (LZF); }
+      virtual const char* getName () const { return ("lzf"); }
+
+      virtual uint32_t
+      compress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const
+      {
+        return (lzfCompressData (input, input_size, output, output_size));
+      }
+
+      virtual uint32_t
+      decompress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const
+      {
+        return (lzfDecompressData (input, input_size, output, output_size));
+      }
+  };
+
+#ifdef HAVE_LZ4
+  //////////////////////////////////////////////////////////////////////////////
+  class LZ4Codec : public pcl::io::ImageCodec
+  {
+    public:
+      virtual Id getId () const { return (LZ4); }
+      virtual const char* getName () const { return ("lz4"); }
+
+      virtual uint32_t
+      compress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const
+      {
+        int size = LZ4_compress_default (input, output, static_cast<int> (input_size), static_cast<int> (output_size));
+        return (size > 0 ? static_cast<uint32_t> (size) : 0);
+      }
+
+      virtual uint32_t
+      decompress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const
+      {
+        int size = LZ4_decompress_safe (input, output, static_cast<int> (input_size), static_cast<int> (output_size));
+        return (size > 0 ? static_cast<uint32_t> (size) : 0);
+      }
+  };
+#endif
+
+#ifdef HAVE_ZSTD
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief zstd contexts kept for the lifetime of a thread. ZSTD_compress and
+    * ZSTD_decompress would allocate and free one per call, i.e. per band.
+    */
+  struct ZstdCompressionContext
+  {
+    ZstdCompressionContext () : context (ZSTD_createCCtx ()) {}
+    ~ZstdCompressionContext () { ZSTD_freeCCtx (context); }
+    ZSTD_CCtx *context;
+  };
+
+  struct ZstdDecompressionContext
+  {
+    ZstdDecompressionContext () : context (ZSTD_createDCtx ()) {}
+    ~ZstdDecompressionContext () { ZSTD_freeDCtx (context); }
+    ZSTD_DCtx *context;
+  };
+
+  //////////////////////////////////////////////////////////////////////////////
+  class ZstdCodec : public pcl::io::ImageCodec
+  {
+    public:
+      virtual Id getId () const { return (ZSTD); }
+      virtual const char* getName () const { return ("zstd"); }
+
+      virtual uint32_t
+      compress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const
+      {
+        static thread_local ZstdCompressionContext cctx;
+        if (cctx.context == NULL)
+          return (0);
+        // Level 1 is the fastest level available in every zstd release
+        size_t size = ZSTD_compressCCtx (cctx.context, output, output_size, input, input_size, 1);
+        return (ZSTD_isError (size) ? 0 : static_cast<uint32_t> (size));
+      }
+
+      virtual uint32_t
+      decompress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const
+      {
+        static thread_local ZstdDecompressionContext dctx;
+        if (dctx.context == NULL)
+          return (0);
+        size_t size = ZSTD_decompressDCtx (dctx.context, output, output_size, input, input_size);
+        return (ZSTD_isError (size) ? 0 : static_cast<uint32_t> (size));
+      }
+  };
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Planar reordering kernels.
+//
+// RGB24 images are stored as [RR..RGG..GBB..B] and YUV422 (UYVY) images as
+// [UU..UYY..YVV..V] to improve compression. Every kernel has a scalar
+// reference version; the SIMD versions process the bulk of the image and hand
+// the remainder to it, so all of them produce bit-identical output. The YUV422
+// kernels count in macropixels (U, Y0, V, Y1), i.e., pairs of pixels.
+//////////////////////////////////////////////////////////////////////////////
+namespace
+{
+  typedef void (*DeinterleaveKernel) (const char *input, char *plane0, char *plane1, char *plane2, size_t size);
+  typedef void (*InterleaveKernel) (const char *plane0, const char *plane1, const char *plane2, char *output, size_t size);
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  deinterleaveRGB24Scalar (const char *rgb, char *r, char *g, char *b, size_t nr_pixels)
+  {
+    for (size_t i = 0; i < nr_pixels; ++i)
+    {
+      r[i] = rgb[i * 3 + 0];
+      g[i] = rgb[i * 3 + 1];
+      b[i] = rgb[i * 3 + 2];
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  interleaveRGB24Scalar (const char *r, const char *g, const char *b, char *rgb, size_t nr_pixels)
+  {
+    for (size_t i = 0; i < nr_pixels; ++i)
+    {
+      rgb[i * 3 + 0] = r[i];
+      rgb[i * 3 + 1] = g[i];
+      rgb[i * 3 + 2] = b[i];
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  deinterleaveYUV422Scalar (const char *uyvy, char *u, char *y, char *v, size_t nr_macropixels)
+  {
+    for (size_t i = 0; i < nr_macropixels; ++i)
+    {
+      u[i]         = uyvy[i * 4 + 0];
+      y[i * 2 + 0] = uyvy[i * 4 + 1];
+      y[i * 2 + 1] = uyvy[i * 4 + 3];
+      v[i]         = uyvy[i * 4 + 2];
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  interleaveYUV422Scalar (const char *u, const char *y, const char *v, char *uyvy, size_t nr_macropixels)
+  {
+    for (size_t i = 0; i < nr_macropixels; ++i)
+    {
+      uyvy[i * 4 + 0] = u[i];
+      uyvy[i * 4 + 1] = y[i * 2 + 0];
+      uyvy[i * 4 + 3] = y[i * 2 + 1];
+      uyvy[i * 4 + 2] = v[i];
+    }
+  }
+
+#ifdef PCL_LZF_X86_SIMD
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief pshufb control masks moving 16 RGB pixels (3 x 16 bytes) between
+    * interleaved and planar layout, indexed as [plane][block][byte].
+    */
+  struct RGB24ShuffleMasks
+  {
+    RGB24ShuffleMasks ()
+    {
+      for (int c = 0; c < 3; ++c)
+        for (int k = 0; k < 3; ++k)
+          for (int j = 0; j < 16; ++j)
+          {
+            // Byte j of plane c comes from interleaved byte 3 * j + c
+            int src = 3 * j + c - 16 * k;
+            deinterleave[c][k][j] = (src >= 0 && src < 16) ? static_cast<unsigned char> (src) : 0x80;
+            // Interleaved byte 16 * k + j comes from plane (16 * k + j) % 3
+            int dst = 16 * k + j;
+            interleave[c][k][j] = (dst % 3 == c) ? static_cast<unsigned char> (dst / 3) : 0x80;
+          }
+    }
+
+    unsigned char deinterleave[3][3][16];
+    unsigned char interleave[3][3][16];
+  };
+
+  const RGB24ShuffleMasks&
+  getRGB24ShuffleMasks ()
+  {
+    static const RGB24ShuffleMasks masks;
+    return (masks);
+  }
+
+  /** \brief pshufb control mask gathering 4 UYVY macropixels as [UUUUVVVVYYYYYYYY]. */
+  const unsigned char yuv422_shuffle_mask[16] = {0, 4, 8, 12, 2, 6, 10, 14, 1, 3, 5, 7, 9, 11, 13, 15};
+
+#define PCL_LZF_LOAD128(ptr) _mm_loadu_si128 (reinterpret_cast<const __m128i*> (ptr))
+#define PCL_LZF_STORE128(ptr,val) _mm_storeu_si128 (reinterpret_cast<__m128i*> (ptr), val)
+#define PCL_LZF_LOAD256(ptr) _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (ptr))
+#define PCL_LZF_STORE256(ptr,val) _mm256_storeu_si256 (reinterpret_cast<__m256i*> (ptr), val)
+#define PCL_LZF_LOAD2X128(lo,hi) _mm256_inserti128_si256 (_mm256_castsi128_si256 (PCL_LZF_LOAD128 (lo)), PCL_LZF_LOAD128 (hi), 1)
+
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("ssse3"))) void
+  deinterleaveRGB24SSSE3 (const char *rgb, char *r, char *g, char *b, size_t nr_pixels)
+  {
+    const RGB24ShuffleMasks &m = getRGB24ShuffleMasks ();
+    __m128i mask[3][3];
+    for (int c = 0; c < 3; ++c)
+      for (int k = 0; k < 3; ++k)
+        mask[c][k] = PCL_LZF_LOAD128 (m.deinterleave[c][k]);
+
+    size_t i = 0;
+    for (; i + 16 <= nr_pixels; i += 16)
+    {
+      const char *src = &rgb[i * 3];
+      __m128i in0 = PCL_LZF_LOAD128 (src), in1 = PCL_LZF_LOAD128 (src + 16), in2 = PCL_LZF_LOAD128 (src + 32);
+      char *dst[3] = {&r[i], &g[i], &b[i]};
+      for (int c = 0; c < 3; ++c)
+        PCL_LZF_STORE128 (dst[c], _mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (in0, mask[c][0]),
+                                                              _mm_shuffle_epi8 (in1, mask[c][1])),
+                                                _mm_shuffle_epi8 (in2, mask[c][2])));
+    }
+    deinterleaveRGB24Scalar (&rgb[i * 3], &r[i], &g[i], &b[i], nr_pixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("ssse3"))) void
+  interleaveRGB24SSSE3 (const char *r, const char *g, const char *b, char *rgb, size_t nr_pixels)
+  {
+    const RGB24ShuffleMasks &m = getRGB24ShuffleMasks ();
+    __m128i mask[3][3];
+    for (int c = 0; c < 3; ++c)
+      for (int k = 0; k < 3; ++k)
+        mask[c][k] = PCL_LZF_LOAD128 (m.interleave[c][k]);
+
+    size_t i = 0;
+    for (; i + 16 <= nr_pixels; i += 16)
+    {
+      __m128i in[3] = {PCL_LZF_LOAD128 (&r[i]), PCL_LZF_LOAD128 (&g[i]), PCL_LZF_LOAD128 (&b[i])};
+      for (int k = 0; k < 3; ++k)
+        PCL_LZF_STORE128 (&rgb[i * 3 + k * 16], _mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (in[0], mask[0][k]),
+                                                                            _mm_shuffle_epi8 (in[1], mask[1][k])),
+                                                              _mm_shuffle_epi8 (in[2], mask[2][k])));
+    }
+    interleaveRGB24Scalar (&r[i], &g[i], &b[i], &rgb[i * 3], nr_pixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("ssse3"))) void
+  deinterleaveYUV422SSSE3 (const char *uyvy, char *u, char *y, char *v, size_t nr_macropixels)
+  {
+    const __m128i mask = PCL_LZF_LOAD128 (yuv422_shuffle_mask);
+    size_t i = 0;
+    for (; i + 16 <= nr_macropixels; i += 16)
+    {
+      const char *src = &uyvy[i * 4];
+      __m128i s0 = _mm_shuffle_epi8 (PCL_LZF_LOAD128 (src),      mask),
+              s1 = _mm_shuffle_epi8 (PCL_LZF_LOAD128 (src + 16), mask),
+              s2 = _mm_shuffle_epi8 (PCL_LZF_LOAD128 (src + 32), mask),
+              s3 = _mm_shuffle_epi8 (PCL_LZF_LOAD128 (src + 48), mask);
+      // [U0..U3 U4..U7 V0..V3 V4..V7] and the same for macropixels 8..15
+      __m128i uv0 = _mm_unpacklo_epi32 (s0, s1),
+              uv1 = _mm_unpacklo_epi32 (s2, s3);
+      PCL_LZF_STORE128 (&u[i], _mm_unpacklo_epi64 (uv0, uv1));
+      PCL_LZF_STORE128 (&v[i], _mm_unpackhi_epi64 (uv0, uv1));
+      PCL_LZF_STORE128 (&y[i * 2],      _mm_unpackhi_epi64 (s0, s1));
+      PCL_LZF_STORE128 (&y[i * 2 + 16], _mm_unpackhi_epi64 (s2, s3));
+    }
+    deinterleaveYUV422Scalar (&uyvy[i * 4], &u[i], &y[i * 2], &v[i], nr_macropixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("sse2"))) void
+  interleaveYUV422SSE2 (const char *u, const char *y, const char *v, char *uyvy, size_t nr_macropixels)
+  {
+    size_t i = 0;
+    for (; i + 16 <= nr_macropixels; i += 16)
+    {
+      __m128i in_u = PCL_LZF_LOAD128 (&u[i]), in_v = PCL_LZF_LOAD128 (&v[i]);
+      __m128i in_y0 = PCL_LZF_LOAD128 (&y[i * 2]), in_y1 = PCL_LZF_LOAD128 (&y[i * 2 + 16]);
+      __m128i uv_lo = _mm_unpacklo_epi8 (in_u, in_v),
+              uv_hi = _mm_unpackhi_epi8 (in_u, in_v);
+      char *dst = &uyvy[i * 4];
+      PCL_LZF_STORE128 (dst,      _mm_unpacklo_epi8 (uv_lo, in_y0));
+      PCL_LZF_STORE128 (dst + 16, _mm_unpackhi_epi8 (uv_lo, in_y0));
+      PCL_LZF_STORE128 (dst + 32, _mm_unpacklo_epi8 (uv_hi, in_y1));
+      PCL_LZF_STORE128 (dst + 48, _mm_unpackhi_epi8 (uv_hi, in_y1));
+    }
+    interleaveYUV422Scalar (&u[i], &y[i * 2], &v[i], &uyvy[i * 4], nr_macropixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // The AVX2 kernels run the SSSE3 algorithm independently in both 128-bit
+  // lanes: the low lane handles the first half of the block, the high lane the
+  // second half, which keeps every per-lane shuffle mask unchanged.
+  __attribute__ ((target ("avx2"))) void
+  deinterleaveRGB24AVX2 (const char *rgb, char *r, char *g, char *b, size_t nr_pixels)
+  {
+    const RGB24ShuffleMasks &m = getRGB24ShuffleMasks ();
+    __m256i mask[3][3];
+    for (int c = 0; c < 3; ++c)
+      for (int k = 0; k < 3; ++k)
+        mask[c][k] = _mm256_broadcastsi128_si256 (PCL_LZF_LOAD128 (m.deinterleave[c][k]));
+
+    size_t i = 0;
+    for (; i + 32 <= nr_pixels; i += 32)
+    {
+      const char *src = &rgb[i * 3];
+      __m256i in0 = PCL_LZF_LOAD2X128 (src,      src + 48),
+              in1 = PCL_LZF_LOAD2X128 (src + 16, src + 64),
+              in2 = PCL_LZF_LOAD2X128 (src + 32, src + 80);
+      char *dst[3] = {&r[i], &g[i], &b[i]};
+      for (int c = 0; c < 3; ++c)
+        PCL_LZF_STORE256 (dst[c], _mm256_or_si256 (_mm256_or_si256 (_mm256_shuffle_epi8 (in0, mask[c][0]),
+                                                                    _mm256_shuffle_epi8 (in1, mask[c][1])),
+                                                   _mm256_shuffle_epi8 (in2, mask[c][2])));
+    }
+    deinterleaveRGB24SSSE3 (&rgb[i * 3], &r[i], &g[i], &b[i], nr_pixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("avx2"))) void
+  interleaveRGB24AVX2 (const char *r, const char *g, const char *b, char *rgb, size_t nr_pixels)
+  {
+    const RGB24ShuffleMasks &m = getRGB24ShuffleMasks ();
+    __m256i mask[3][3];
+    for (int c = 0; c < 3; ++c)
+      for (int k = 0; k < 3; ++k)
+        mask[c][k] = _mm256_broadcastsi128_si256 (PCL_LZF_LOAD128 (m.interleave[c][k]));
+
+    size_t i = 0;
+    for (; i + 32 <= nr_pixels; i += 32)
+    {
+      __m256i in[3] = {PCL_LZF_LOAD256 (&r[i]), PCL_LZF_LOAD256 (&g[i]), PCL_LZF_LOAD256 (&b[i])};
+      char *dst = &rgb[i * 3];
+      for (int k = 0; k < 3; ++k)
+      {
+        __m256i out = _mm256_or_si256 (_mm256_or_si256 (_mm256_shuffle_epi8 (in[0], mask[0][k]),
+                                                        _mm256_shuffle_epi8 (in[1], mask[1][k])),
+                                       _mm256_shuffle_epi8 (in[2], mask[2][k]));
+        PCL_LZF_STORE128 (dst + k * 16,      _mm256_castsi256_si128 (out));
+        PCL_LZF_STORE128 (dst + k * 16 + 48, _mm256_extracti128_si256 (out, 1));
+      }
+    }
+    interleaveRGB24SSSE3 (&r[i], &g[i], &b[i], &rgb[i * 3], nr_pixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("avx2"))) void
+  deinterleaveYUV422AVX2 (const char *uyvy, char *u, char *y, char *v, size_t nr_macropixels)
+  {
+    const __m256i mask = _mm256_broadcastsi128_si256 (PCL_LZF_LOAD128 (yuv422_shuffle_mask));
+    size_t i = 0;
+    for (; i + 32 <= nr_macropixels; i += 32)
+    {
+      const char *src = &uyvy[i * 4];
+      __m256i s0 = _mm256_shuffle_epi8 (PCL_LZF_LOAD2X128 (src,      src + 64), mask),
+              s1 = _mm256_shuffle_epi8 (PCL_LZF_LOAD2X128 (src + 16, src + 80), mask),
+              s2 = _mm256_shuffle_epi8 (PCL_LZF_LOAD2X128 (src + 32, src + 96), mask),
+              s3 = _mm256_shuffle_epi8 (PCL_LZF_LOAD2X128 (src + 48, src + 112), mask);
+      __m256i uv0 = _mm256_unpacklo_epi32 (s0, s1),
+              uv1 = _mm256_unpacklo_epi32 (s2, s3);
+      PCL_LZF_STORE256 (&u[i], _mm256_unpacklo_epi64 (uv0, uv1));
+      PCL_LZF_STORE256 (&v[i], _mm256_unpackhi_epi64 (uv0, uv1));
+      // Y of macropixels [0..7 | 16..23] and [8..15 | 24..31]
+      __m256i y0 = _mm256_unpackhi_epi64 (s0, s1),
+              y1 = _mm256_unpackhi_epi64 (s2, s3);
+      PCL_LZF_STORE256 (&y[i * 2],      _mm256_permute2x128_si256 (y0, y1, 0x20));
+      PCL_LZF_STORE256 (&y[i * 2 + 32], _mm256_permute2x128_si256 (y0, y1, 0x31));
+    }
+    deinterleaveYUV422SSSE3 (&uyvy[i * 4], &u[i], &y[i * 2], &v[i], nr_macropixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("avx2"))) void
+  interleaveYUV422AVX2 (const char *u, const char *y, const char *v, char *uyvy, size_t nr_macropixels)
+  {
+    size_t i = 0;
+    for (; i + 32 <= nr_macropixels; i += 32)
+    {
+      __m256i in_u = PCL_LZF_LOAD256 (&u[i]), in_v = PCL_LZF_LOAD256 (&v[i]);
+      __m256i in_y0 = PCL_LZF_LOAD256 (&y[i * 2]), in_y1 = PCL_LZF_LOAD256 (&y[i * 2 + 32]);
+      // UV pairs of macropixels [0..7 | 16..23] and [8..15 | 24..31], with the matching Y
+      __m256i uv_lo = _mm256_unpacklo_epi8 (in_u, in_v),
+              uv_hi = _mm256_unpackhi_epi8 (in_u, in_v);
+      __m256i y_lo = _mm256_permute2x128_si256 (in_y0, in_y1, 0x20),
+              y_hi = _mm256_permute2x128_si256 (in_y0, in_y1, 0x31);
+      __m256i out0 = _mm256_unpacklo_epi8 (uv_lo, y_lo),     // [0..3   | 16..19]
+              out1 = _mm256_unpackhi_epi8 (uv_lo, y_lo),     // [4..7   | 20..23]
+              out2 = _mm256_unpacklo_epi8 (uv_hi, y_hi),     // [8..11  | 24..27]
+              out3 = _mm256_unpackhi_epi8 (uv_hi, y_hi);     // [12..15 | 28..31]
+      char *dst = &uyvy[i * 4];
+      PCL_LZF_STORE256 (dst,      _mm256_permute2x128_si256 (out0, out1, 0x20));
+      PCL_LZF_STORE256 (dst + 32, _mm256_permute2x128_si256 (out2, out3, 0x20));
+      PCL_LZF_STORE256 (dst + 64, _mm256_permute2x128_si256 (out0, out1, 0x31));
+      PCL_LZF_STORE256 (dst + 96, _mm256_permute2x128_si256 (out2, out3, 0x31));
+    }
+    interleaveYUV422SSE2 (&u[i], &y[i * 2], &v[i], &uyvy[i * 4], nr_macropixels - i);
+  }
+#endif // PCL_LZF_X86_SIMD
+
+#ifdef PCL_LZF_NEON_SIMD
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  deinterleaveRGB24NEON (const char *rgb, char *r, char *g, char *b, size_t nr_pixels)
+  {
+    size_t i = 0;
+    for (; i + 16 <= nr_pixels; i += 16)
+    {
+      uint8x16x3_t in = vld3q_u8 (reinterpret_cast<const uint8_t*> (&rgb[i * 3]));
+      vst1q_u8 (reinterpret_cast<uint8_t*> (&r[i]), in.val[0]);
+      vst1q_u8 (reinterpret_cast<uint8_t*> (&g[i]), in.val[1]);
+      vst1q_u8 (reinterpret_cast<uint8_t*> (&b[i]), in.val[2]);
+    }
+    deinterleaveRGB24Scalar (&rgb[i * 3], &r[i], &g[i], &b[i], nr_pixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  interleaveRGB24NEON (const char *r, const char *g, const char *b, char *rgb, size_t nr_pixels)
+  {
+    size_t i = 0;
+    for (; i + 16 <= nr_pixels; i += 16)
+    {
+      uint8x16x3_t out;
+      out.val[0] = vld1q_u8 (reinterpret_cast<const uint8_t*> (&r[i]));
+      out.val[1] = vld1q_u8 (reinterpret_cast<const uint8_t*> (&g[i]));
+      out.val[2] = vld1q_u8 (reinterpret_cast<const uint8_t*> (&b[i]));
+      vst3q_u8 (reinterpret_cast<uint8_t*> (&rgb[i * 3]), out);
+    }
+    interleaveRGB24Scalar (&r[i], &g[i], &b[i], &rgb[i * 3], nr_pixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  deinterleaveYUV422NEON (const char *uyvy, char *u, char *y, char *v, size_t nr_macropixels)
+  {
+    size_t i = 0;
+    for (; i + 16 <= nr_macropixels; i += 16)
+    {
+      uint8x16x4_t in = vld4q_u8 (reinterpret_cast<const uint8_t*> (&uyvy[i * 4]));
+      uint8x16x2_t yy;
+      yy.val[0] = in.val[1];
+      yy.val[1] = in.val[3];
+      vst1q_u8 (reinterpret_cast<uint8_t*> (&u[i]), in.val[0]);
+      vst2q_u8 (reinterpret_cast<uint8_t*> (&y[i * 2]), yy);
+      vst1q_u8 (reinterpret_cast<uint8_t*> (&v[i]), in.val[2]);
+    }
+    deinterleaveYUV422Scalar (&uyvy[i * 4], &u[i], &y[i * 2], &v[i], nr_macropixels - i);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  void
+  interleaveYUV422NEON (const char *u, const char *y, const char *v, char *uyvy, size_t nr_macropixels)
+  {
+    size_t i = 0;
+    for (; i + 16 <= nr_macropixels; i += 16)
+    {
+      uint8x16x2_t yy = vld2q_u8 (reinterpret_cast<const uint8_t*> (&y[i * 2]));
+      uint8x16x4_t out;
+      out.val[0] = vld1q_u8 (reinterpret_cast<const uint8_t*> (&u[i]));
+      out.val[1] = yy.val[0];
+      out.val[2] = vld1q_u8 (reinterpret_cast<const uint8_t*> (&v[i]));
+      out.val[3] = yy.val[1];
+      vst4q_u8 (reinterpret_cast<uint8_t*> (&uyvy[i * 4]), out);
+    }
+    interleaveYUV422Scalar (&u[i], &y[i * 2], &v[i], &uyvy[i * 4], nr_macropixels - i);
+  }
+#endif // PCL_LZF_NEON_SIMD
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief The reordering kernels picked for the CPU we are running on. */
+  struct ShuffleKernels
+  {
+    ShuffleKernels ()
+      : deinterleave_rgb24 (&deinterleaveRGB24Scalar)
+      , interleave_rgb24 (&interleaveRGB24Scalar)
+      , deinterleave_yuv422 (&deinterleaveYUV422Scalar)
+      , interleave_yuv422 (&interleaveYUV422Scalar)
+    {
+#if defined(PCL_LZF_X86_SIMD)
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("sse2"))
+        interleave_yuv422 = &interleaveYUV422SSE2;
+      if (__builtin_cpu_supports ("ssse3"))
+      {
+        deinterleave_rgb24 = &deinterleaveRGB24SSSE3;
+        interleave_rgb24 = &interleaveRGB24SSSE3;
+        deinterleave_yuv422 = &deinterleaveYUV422SSSE3;
+      }
+      if (__builtin_cpu_supports ("avx2"))
+      {
+        deinterleave_rgb24 = &deinterleaveRGB24AVX2;
+        interleave_rgb24 = &interleaveRGB24AVX2;
+        deinterleave_yuv422 = &deinterleaveYUV422AVX2;
+        interleave_yuv422 = &interleaveYUV422AVX2;
+      }
+#elif defined(PCL_LZF_NEON_SIMD)
+      deinterleave_rgb24 = &deinterleaveRGB24NEON;
+      interleave_rgb24 = &interleaveRGB24NEON;
+      deinterleave_yuv422 = &deinterleaveYUV422NEON;
+      interleave_yuv422 = &interleaveYUV422NEON;
+#endif
+    }
+
+    DeinterleaveKernel deinterleave_rgb24;
+    InterleaveKernel interleave_rgb24;
+    DeinterleaveKernel deinterleave_yuv422;
+    InterleaveKernel interleave_yuv422;
+  };
+
+  const ShuffleKernels&
+  getShuffleKernels ()
+  {
+    static const ShuffleKernels kernels;
+    return (kernels);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Depth projection kernels.
+  //
+  // Turn one row of 16-bit depth values into XYZ points: z = depth * z_factor,
+  // x = x_factors[i] * z, y = y_factor * z. Invalid (0) and out of range depth
+  // values give NaN points. Every stride-th depth value is used. The kernels
+  // return the number of NaN points they wrote.
+  //////////////////////////////////////////////////////////////////////////////
+  typedef size_t (*ProjectKernel) (const char *depth, size_t nr_points, unsigned int stride,
+                                   const float *x_factors, float y_factor, float z_factor,
+                                   float min_depth, float max_depth, pcl::PointXYZ *points);
+
+  //////////////////////////////////////////////////////////////////////////////
+  size_t
+  projectDepthScalar (const char *depth, size_t nr_points, unsigned int stride,
+                      const float *x_factors, float y_factor, float z_factor,
+                      float min_depth, float max_depth, pcl::PointXYZ *points)
+  {
+    const float nan = std::numeric_limits<float>::quiet_NaN ();
+    size_t nr_invalid = 0;
+    for (size_t i = 0; i < nr_points; ++i)
+    {
+      uint16_t value;
+      memcpy (&value, &depth[i * stride * 2], sizeof (uint16_t));
+      float z = static_cast<float> (value) * z_factor;
+      if (value == 0 || !(z >= min_depth && z <= max_depth))
+      {
+        z = nan;
+        ++nr_invalid;
+      }
+      points[i].x = x_factors[i] * z;
+      points[i].y = y_factor * z;
+      points[i].z = z;
+    }
+    return (nr_invalid);
+  }
+
+#ifdef PCL_LZF_X86_SIMD
+  //////////////////////////////////////////////////////////////////////////////
+  __attribute__ ((target ("sse2"))) size_t
+  projectDepthSSE2 (const char *depth, size_t nr_points, unsigned int stride,
+                    const float *x_factors, float y_factor, float z_factor,
+                    float min_depth, float max_depth, pcl::PointXYZ *points)
+  {
+    // Decimated rows are gathered, which the scalar kernel does just as well
+    if (stride != 1 || sizeof (pcl::PointXYZ) != 4 * sizeof (float))
+      return (projectDepthScalar (depth, nr_points, stride, x_factors, y_factor, z_factor, min_depth, max_depth, points));
+
+    const __m128 nan = _mm_set1_ps (std::numeric_limits<float>::quiet_NaN ());
+    const __m128 one = _mm_set1_ps (1.0f);
+    const __m128 yf = _mm_set1_ps (y_factor), zf = _mm_set1_ps (z_factor);
+    const __m128 lo = _mm_set1_ps (min_depth), hi = _mm_set1_ps (max_depth);
+    const __m128i zero = _mm_setzero_si128 ();
+    size_t nr_invalid = 0, i = 0;
+    for (; i + 4 <= nr_points; i += 4)
+    {
+      __m128i values = _mm_unpacklo_epi16 (_mm_loadl_epi64 (reinterpret_cast<const __m128i*> (&depth[i * 2])), zero);
+      __m128 z = _mm_mul_ps (_mm_cvtepi32_ps (values), zf);
+      __m128 valid = _mm_and_ps (_mm_castsi128_ps (_mm_xor_si128 (_mm_cmpeq_epi32 (values, zero), _mm_set1_epi32 (-1))),
+                                 _mm_and_ps (_mm_cmpge_ps (z, lo), _mm_cmple_ps (z, hi)));
+      nr_invalid += 4 - __builtin_popcount (_mm_movemask_ps (valid));
+      z = _mm_or_ps (_mm_and_ps (valid, z), _mm_andnot_ps (valid, nan));
+      __m128 x = _mm_mul_ps (_mm_loadu_ps (&x_factors[i]), z);
+      __m128 y = _mm_mul_ps (yf, z);
+      __m128 w = one;
+      _MM_TRANSPOSE4_PS (x, y, z, w);
+      float *dst = points[i].data;
+      _mm_storeu_ps (dst,      x);
+      _mm_storeu_ps (dst + 4,  y);
+      _mm_storeu_ps (dst + 8,  z);
+      _mm_storeu_ps (dst + 12, w);
+    }
+    return (nr_invalid + projectDepthScalar (&depth[i * 2], nr_points - i, 1, &x_factors[i], y_factor, z_factor,
+                                             min_depth, max_depth, &points[i]));
+  }
+#endif // PCL_LZF_X86_SIMD
+
+#ifdef PCL_LZF_NEON_SIMD
+  //////////////////////////////////////////////////////////////////////////////
+  size_t
+  projectDepthNEON (const char *depth, size_t nr_points, unsigned int stride,
+                    const float *x_factors, float y_factor, float z_factor,
+                    float min_depth, float max_depth, pcl::PointXYZ *points)
+  {
+    if (stride != 1 || sizeof (pcl::PointXYZ) != 4 * sizeof (float))
+      return (projectDepthScalar (depth, nr_points, stride, x_factors, y_factor, z_factor, min_depth, max_depth, points));
+
+    const float32x4_t nan = vdupq_n_f32 (std::numeric_limits<float>::quiet_NaN ());
+    const float32x4_t lo = vdupq_n_f32 (min_depth), hi = vdupq_n_f32 (max_depth);
+    size_t nr_invalid = 0, i = 0;
+    for (; i + 4 <= nr_points; i += 4)
+    {
+      uint32x4_t values = vmovl_u16 (vreinterpret_u16_u8 (vld1_u8 (reinterpret_cast<const uint8_t*> (&depth[i * 2]))));
+      float32x4_t z = vmulq_n_f32 (vcvtq_f32_u32 (values), z_factor);
+      uint32x4_t valid = vandq_u32 (vtstq_u32 (values, values), vandq_u32 (vcgeq_f32 (z, lo), vcleq_f32 (z, hi)));
+      uint32x2_t count = vpadd_u32 (vget_low_u32 (vshrq_n_u32 (valid, 31)), vget_high_u32 (vshrq_n_u32 (valid, 31)));
+      nr_invalid += 4 - (vget_lane_u32 (count, 0) + vget_lane_u32 (count, 1));
+      float32x4x4_t out;
+      out.val[2] = vbslq_f32 (valid, z, nan);
+      out.val[0] = vmulq_f32 (vld1q_f32 (&x_factors[i]), out.val[2]);
+      out.val[1] = vmulq_n_f32 (out.val[2], y_factor);
+      out.val[3] = vdupq_n_f32 (1.0f);
+      vst4q_f32 (points[i].data, out);
+    }
+    return (nr_invalid + projectDepthScalar (&depth[i * 2], nr_points - i, 1, &x_factors[i], y_factor, z_factor,
+                                             min_depth, max_depth, &points[i]));
+  }
+#endif // PCL_LZF_NEON_SIMD
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief The depth projection kernel picked for the CPU we are running on. */
+  ProjectKernel
+  getProjectKernel ()
+  {
+#if defined(PCL_LZF_X86_SIMD)
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("sse2"))
+      return (&projectDepthSSE2);
+#elif defined(PCL_LZF_NEON_SIMD)
+    return (&projectDepthNEON);
+#endif
+    return (&projectDepthScalar);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::deinterleaveRGB24 (const char *rgb, size_t nr_pixels, char *rrggbb)
+{
+  getShuffleKernels ().deinterleave_rgb24 (rgb, rrggbb, &rrggbb[nr_pixels], &rrggbb[2 * nr_pixels], nr_pixels);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::interleaveRGB24 (const char *rrggbb, size_t nr_pixels, char *rgb)
+{
+  getShuffleKernels ().interleave_rgb24 (rrggbb, &rrggbb[nr_pixels], &rrggbb[2 * nr_pixels], rgb, nr_pixels);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::deinterleaveYUV422 (const char *uyvy, size_t nr_pixels, char *uuyyvv)
+{
+  size_t nr_macropixels = nr_pixels / 2;
+  // An odd pixel count leaves two bytes of the planar layout unused
+  if (nr_pixels % 2)
+  {
+    uuyyvv[nr_macropixels * 3] = 0;
+    uuyyvv[nr_pixels * 2 - 1] = 0;
+  }
+  getShuffleKernels ().deinterleave_yuv422 (uyvy,
+                                            &uuyyvv[0],                             // u
+                                            &uuyyvv[nr_macropixels],                // y
+                                            &uuyyvv[nr_macropixels + nr_pixels],    // v
+                                            nr_macropixels);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::interleaveYUV422 (const char *uuyyvv, size_t nr_pixels, char *uyvy)
+{
+  size_t nr_macropixels = nr_pixels / 2;
+  getShuffleKernels ().interleave_yuv422 (&uuyyvv[0],
+                                          &uuyyvv[nr_macropixels],
+                                          &uuyyvv[nr_macropixels + nr_pixels],
+                                          uyvy,
+                                          nr_macropixels);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::encodeDepth16Delta (const char *depth, uint32_t width, uint32_t height, char *planes)
+{
+  size_t nr_pixels = size_t (width) * height;
+  unsigned char *low = reinterpret_cast<unsigned char*> (planes);
+  unsigned char *high = &low[nr_pixels];
+  uint16_t row_start = 0;
+  for (uint32_t v = 0; v < height; ++v)
+  {
+    const char *row = &depth[size_t (v) * width * 2];
+    uint16_t prediction = row_start;
+    for (uint32_t u = 0; u < width; ++u)
+    {
+      uint16_t val;
+      memcpy (&val, &row[u * 2], sizeof (uint16_t));
+      uint16_t delta = static_cast<uint16_t> (val - prediction);
+      *low++ = static_cast<unsigned char> (delta & 0xff);
+      *high++ = static_cast<unsigned char> (delta >> 8);
+      prediction = val;
+      if (u == 0)
+        row_start = val;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::decodeDepth16Delta (const char *planes, uint32_t width, uint32_t height, char *depth)
+{
+  size_t nr_pixels = size_t (width) * height;
+  const unsigned char *low = reinterpret_cast<const unsigned char*> (planes);
+  const unsigned char *high = &low[nr_pixels];
+  uint16_t row_start = 0;
+  for (uint32_t v = 0; v < height; ++v)
+  {
+    char *row = &depth[size_t (v) * width * 2];
+    uint16_t val = row_start;
+    for (uint32_t u = 0; u < width; ++u)
+    {
+      val = static_cast<uint16_t> (val + (*low++ | (*high++ << 8)));
+      memcpy (&row[u * 2], &val, sizeof (uint16_t));
+      if (u == 0)
+        row_start = val;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::encodeDepth16Temporal (const char *depth, const char *reference, size_t nr_pixels, char *planes)
+{
+  unsigned char *low = reinterpret_cast<unsigned char*> (planes);
+  unsigned char *high = &low[nr_pixels];
+  for (size_t i = 0; i < nr_pixels; ++i)
+  {
+    uint16_t val, ref;
+    memcpy (&val, &depth[i * 2], sizeof (uint16_t));
+    memcpy (&ref, &reference[i * 2], sizeof (uint16_t));
+    uint16_t delta = static_cast<uint16_t> (val - ref);
+    delta = static_cast<uint16_t> ((delta << 1) ^ (0 - (delta >> 15)));
+    low[i] = static_cast<unsigned char> (delta & 0xff);
+    high[i] = static_cast<unsigned char> (delta >> 8);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::decodeDepth16Temporal (const char *planes, const char *reference, size_t nr_pixels, char *depth)
+{
+  const unsigned char *low = reinterpret_cast<const unsigned char*> (planes);
+  const unsigned char *high = &low[nr_pixels];
+  for (size_t i = 0; i < nr_pixels; ++i)
+  {
+    uint16_t ref;
+    memcpy (&ref, &reference[i * 2], sizeof (uint16_t));
+    uint16_t zz = static_cast<uint16_t> (low[i] | (high[i] << 8));
+    uint16_t val = static_cast<uint16_t> (ref + ((zz >> 1) ^ (0 - (zz & 1))));
+    memcpy (&depth[i * 2], &val, sizeof (uint16_t));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::quantizeDepth16 (const char *depth, size_t nr_pixels, uint16_t step, uint16_t max_depth, char *planes)
+{
+  unsigned char *low = reinterpret_cast<unsigned char*> (planes);
+  unsigned char *high = &low[nr_pixels];
+  // value / step as a multiplication, exact for any 16-bit value and step
+  const uint64_t reciprocal = (uint64_t (1) << 32) / step + 1;
+  const uint16_t beyond = static_cast<uint16_t> (max_depth / step + 2);
+  for (size_t i = 0; i < nr_pixels; ++i)
+  {
+    uint16_t val;
+    memcpy (&val, &depth[i * 2], sizeof (uint16_t));
+    uint16_t code = val == 0 ? 0 : val > max_depth ? beyond : static_cast<uint16_t> (((val * reciprocal) >> 32) + 1);
+    low[i] = static_cast<unsigned char> (code & 0xff);
+    high[i] = static_cast<unsigned char> (code >> 8);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::dequantizeDepth16 (const char *planes, size_t nr_pixels, uint16_t step, uint16_t max_depth, char *depth)
+{
+  const unsigned char *low = reinterpret_cast<const unsigned char*> (planes);
+  const unsigned char *high = &low[nr_pixels];
+  const uint32_t beyond = max_depth / step + 2u;
+  const uint32_t center = step / 2u;
+  for (size_t i = 0; i < nr_pixels; ++i)
+  {
+    uint32_t code = low[i] | (high[i] << 8);
+    uint32_t val = code == 0 ? 0 : code >= beyond ? max_depth + 1u : std::min ((code - 1u) * step + center, uint32_t (max_depth));
+    uint16_t val16 = static_cast<uint16_t> (val);
+    memcpy (&depth[i * 2], &val16, sizeof (uint16_t));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+const pcl::io::ImageCodec*
+pcl::io::ImageCodec::get (Id id)
+{
+  static const LZFCodec lzf;
+#ifdef HAVE_LZ4
+  static const LZ4Codec lz4;
+#endif
+#ifdef HAVE_ZSTD
+  static const ZstdCodec zstd;
+#endif
+  switch (id)
+  {
+    case LZF:
+      return (&lzf);
+#ifdef HAVE_LZ4
+    case LZ4:
+      return (&lz4);
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD:
+      return (&zstd);
+#endif
+    default:
+      return (NULL);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+const pcl::io::ImageCodec*
+pcl::io::ImageCodec::get (const std::string &name)
+{
+  for (int id = LZF; id <= ZSTD; ++id)
+  {
+    const ImageCodec *codec = get (static_cast<Id> (id));
+    if (codec && name == codec->getName ())
+      return (codec);
+  }
+  return (NULL);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFIOStatistics::LZFIOStatistics ()
+  : perf_counters_ (false)
+{
+  reset ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFIOStatistics::reset ()
+{
+  for (int s = 0; s < NR_STAGES; ++s)
+  {
+    stages_[s].count.store (0);
+    stages_[s].total_ns.store (0);
+    stages_[s].min_ns.store (std::numeric_limits<uint64_t>::max ());
+    stages_[s].max_ns.store (0);
+    stages_[s].cycles.store (0);
+    stages_[s].cache_misses.store (0);
+    for (int b = 0; b < NR_BUCKETS; ++b)
+      stages_[s].histogram[b].store (0);
+  }
+  for (int d = 0; d < 2; ++d)
+  {
+    images_[d].store (0);
+    raw_bytes_[d].store (0);
+    compressed_bytes_[d].store (0);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFIOStatistics::record (Stage stage, uint64_t ns, uint64_t cycles, uint64_t cache_misses)
+{
+  AtomicStage &s = stages_[stage];
+  int bucket = 0;
+  for (uint64_t v = ns; v > 1 && bucket < NR_BUCKETS - 1; v >>= 1)
+    ++bucket;
+
+  s.count.fetch_add (1, std::memory_order_relaxed);
+  s.total_ns.fetch_add (ns, std::memory_order_relaxed);
+  s.histogram[bucket].fetch_add (1, std::memory_order_relaxed);
+  s.cycles.fetch_add (cycles, std::memory_order_relaxed);
+  s.cache_misses.fetch_add (cache_misses, std::memory_order_relaxed);
+
+  uint64_t min_ns = s.min_ns.load (std::memory_order_relaxed);
+  while (ns < min_ns && !s.min_ns.compare_exchange_weak (min_ns, ns, std::memory_order_relaxed));
+  uint64_t max_ns = s.max_ns.load (std::memory_order_relaxed);
+  while (ns > max_ns && !s.max_ns.compare_exchange_weak (max_ns, ns, std::memory_order_relaxed));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFIOStatistics::addImage (bool write, uint64_t raw_bytes, uint64_t compressed_bytes)
+{
+  int d = write ? 0 : 1;
+  images_[d].fetch_add (1, std::memory_order_relaxed);
+  raw_bytes_[d].fetch_add (raw_bytes, std::memory_order_relaxed);
+  compressed_bytes_[d].fetch_add (compressed_bytes, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFIOStatistics::StageStatistics
+pcl::io::LZFIOStatistics::getStageStatistics (Stage stage) const
+{
+  const AtomicStage &s = stages_[stage];
+  StageStatistics stats;
+  stats.count = s.count.load ();
+  stats.total_ns = s.total_ns.load ();
+  stats.min_ns = stats.count > 0 ? s.min_ns.load () : 0;
+  stats.max_ns = s.max_ns.load ();
+  stats.cycles = s.cycles.load ();
+  stats.cache_misses = s.cache_misses.load ();
+  for (int b = 0; b < NR_BUCKETS; ++b)
+    stats.histogram[b] = s.histogram[b].load ();
+  return (stats);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+uint64_t
+pcl::io::LZFIOStatistics::getPercentile (Stage stage, double percentile) const
+{
+  StageStatistics stats = getStageStatistics (stage);
+  uint64_t total = 0;
+  for (int b = 0; b < NR_BUCKETS; ++b)
+    total += stats.histogram[b];
+  if (total == 0)
+    return (0);
+
+  uint64_t target = static_cast<uint64_t> (std::ceil (std::min (std::max (percentile, 0.0), 100.0) / 100.0 * double (total)));
+  uint64_t seen = 0;
+  for (int b = 0; b < NR_BUCKETS; ++b)
+  {
+    seen += stats.histogram[b];
+    if (seen >= std::max<uint64_t> (target, 1))
+      return (std::min (uint64_t (2) << b, stats.max_ns));
+  }
+  return (stats.max_ns);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+const char*
+pcl::io::LZFIOStatistics::getStageName (Stage stage)
+{
+  static const char *names[NR_STAGES] = {"write_shuffle", "write_compress", "write_io",
+                                         "read_io", "read_decompress", "read_unshuffle"};
+  return (stage >= 0 && stage < NR_STAGES ? names[stage] : "unknown");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFIOStatistics::writeJSON (std::ostream &os, const std::string &prefix) const
+{
+  const char *directions[2] = {"write", "read"};
+  for (int d = 0; d < 2; ++d)
+  {
+    os << "\t\"" << prefix << "_" << directions[d] << "_images\":" << images_[d].load () << ",\n"
+       << "\t\"" << prefix << "_" << directions[d] << "_raw_bytes\":" << raw_bytes_[d].load () << ",\n"
+       << "\t\"" << prefix << "_" << directions[d] << "_compressed_bytes\":" << compressed_bytes_[d].load () << ",\n";
+  }
+
+  for (int i = 0; i < NR_STAGES; ++i)
+  {
+    Stage stage = static_cast<Stage> (i);
+    StageStatistics stats = getStageStatistics (stage);
+    std::string key = "\t\"" + prefix + "_" + getStageName (stage);
+    os << key << "_count\":" << stats.count << ",\n"
+       << key << "_mean_ms\":" << (stats.count > 0 ? double (stats.total_ns) / double (stats.count) * 1e-6 : 0.0) << ",\n"
+       << key << "_min_ms\":" << double (stats.min_ns) * 1e-6 << ",\n"
+       << key << "_p50_ms\":" << double (getPercentile (stage, 50)) * 1e-6 << ",\n"
+       << key << "_p99_ms\":" << double (getPercentile (stage, 99)) * 1e-6 << ",\n"
+       << key << "_max_ms\":" << double (stats.max_ns) * 1e-6 << ",\n";
+    if (getPerfCountersEnabled ())
+      os << key << "_cycles\":" << stats.cycles << ",\n"
+         << key << "_cache_misses\":" << stats.cache_misses << ",\n";
+
+    // Histogram as flat "<key>_hist_<bucket lower bound>_ns": count fields, like
+    // the other fields of the stats records. Empty buckets are left out.
+    for (int b = 0; b < NR_BUCKETS; ++b)
+    {
+      if (stats.histogram[b] == 0)
+        continue;
+      os << key << "_hist_" << (b == 0 ? 0 : uint64_t (1) << b) << "_ns\":" << stats.histogram[b] << ",\n";
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFIOStatistics::appendToStatsFile (const std::string &filename, const std::string &prefix) const
+{
+  std::ofstream os (filename.c_str (), std::ios::out | std::ios::app);
+  if (!os)
+  {
+    PCL_ERROR ("[pcl::io::LZFIOStatistics::appendToStatsFile] Could not open %s!\n", filename.c_str ());
+    return (false);
+  }
+  writeJSON (os, prefix);
+  return (static_cast<bool> (os));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFCompressionController::LZFCompressionController (double latency_budget_ms,
+                                                             double min_compression_ratio)
+  : latency_budget_ms_ (latency_budget_ms)
+  , min_compression_ratio_ (min_compression_ratio)
+  , probe_interval_ (30)
+  , frames_since_probe_ (0)
+  , level_ (FULL)
+{
+  reset ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFCompressionController::reset ()
+{
+  for (int l = 0; l < NR_LEVELS; ++l)
+  {
+    ms_per_mb_[l] = 0;
+    ratio_[l] = 0;
+    nr_frames_[l] = 0;
+  }
+  frames_since_probe_ = 0;
+  level_ = FULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFCompressionController::Level
+pcl::io::LZFCompressionController::select (size_t image_size)
+{
+  double image_mb = double (image_size) / (1024.0 * 1024.0);
+  // The best compressing level that is worth it and fits the budget. Levels
+  // never used yet are given a try.
+  Level level = STORED;
+  for (int l = FULL; l < STORED; ++l)
+  {
+    if (ratio_[l] > 0 && (ratio_[l] < min_compression_ratio_ || ms_per_mb_[l] * image_mb > latency_budget_ms_))
+      continue;
+    level = Level (l);
+    break;
+  }
+
+  if (level == FULL)
+    frames_since_probe_ = 0;
+  else if (++frames_since_probe_ >= probe_interval_)
+  {
+    level = Level (level - 1);
+    frames_since_probe_ = 0;
+  }
+  level_ = level;
+  return (level);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFCompressionController::update (Level level, size_t image_size, size_t blob_size, double elapsed_ms)
+{
+  level_ = level;
+  if (image_size == 0)
+    return;
+  // A failed encoding did not pay off at all: it counts as not compressing, at the time it took
+  if (blob_size > 0)
+    ++nr_frames_[level];
+
+  double cost = elapsed_ms / (double (image_size) / (1024.0 * 1024.0));
+  double ratio = blob_size > 0 ? double (image_size) / double (blob_size) : 1.0;
+  if (ratio_[level] == 0)
+  {
+    ms_per_mb_[level] = cost;
+    ratio_[level] = ratio;
+    return;
+  }
+  // React faster to slowdowns (lower processor frequency, fewer cores) than to speedups
+  double alpha = cost > ms_per_mb_[level] ? 0.5 : 0.25;
+  ms_per_mb_[level] += alpha * (cost - ms_per_mb_[level]);
+  ratio_[level] += 0.25 * (ratio - ratio_[level]);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::saveImageBlob (const char* data, 
+                                        size_t data_size, 
+                                        const std::string &filename)
+{
+  StageTimer timer (statistics_, LZFIOStatistics::WRITE_IO);
+#ifdef _WIN32
+  HANDLE h_native_file = CreateFile (filename.c_str (), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (h_native_file == INVALID_HANDLE_VALUE)
+    return (false);
+  HANDLE fm = CreateFileMapping (h_native_file, NULL, PAGE_READWRITE, 0, data_size, NULL);
+  char *map = static_cast<char*> (MapViewOfFile (fm, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, data_size));
+  CloseHandle (fm);
+  memcpy (&map[0], data, data_size);
+  UnmapViewOfFile (map);
+  CloseHandle (h_native_file);
+#else
+  int fd = pcl_open (filename.c_str (), O_RDWR | O_CREAT | O_TRUNC, static_cast<mode_t> (0600));
+  if (fd < 0)
+    return (false);
+  // Stretch the file size to the size of the data
+  off_t result = pcl_lseek (fd, data_size - 1, SEEK_SET);
+  if (result < 0)
+  {
+    pcl_close (fd);
+    return (false);
+  }
+  // Write a bogus entry so that the new file size comes in effect
+  result = static_cast<int> (::write (fd, "", 1));
+  if (result != 1)
+  {
+    pcl_close (fd);
+    return (false);
+  }
+
+  char *map = static_cast<char*> (mmap (0, data_size, PROT_WRITE, MAP_SHARED, fd, 0));
+  if (map == reinterpret_cast<char*> (-1))    // MAP_FAILED
+  {
+    pcl_close (fd);
+    return (false);
+  }
+
+  // Copy the data
+  memcpy (&map[0], data, data_size);
+
+  if (munmap (map, (data_size)) == -1)
+  {
+    pcl_close (fd);
+    return (false);
+  }
+  pcl_close (fd);
+#endif
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+size_t
+pcl::io::LZFImageWriter::getMaxCompressedSize (uint32_t input_size, uint32_t height) const
+{
+  // Bands of the other codecs never exceed their input, they are stored as is otherwise
+  size_t size = lzfMaxCompressedSize (input_size) + LZF_HEADER_SIZE;
+  if (band_rows_ > 0 || codec_->getId () != ImageCodec::LZF || !pyramid_.empty () || controller_ ||
+      quantization_step_ > 0 || has_reference_hash_)
+    size += LZF_EXT_HEADER_SIZE - LZF_HEADER_SIZE + std::max<size_t> (height, 1) * LZF_EXT_BAND_ENTRY_SIZE +
+            LZF_EXT_QUANT_ENTRY_SIZE + LZF_EXT_REF_ENTRY_SIZE;
+  // Levels that do not compress are stored as is
+  for (size_t l = 0; l < pyramid_.size (); ++l)
+    size += LZF_EXT_LEVEL_ENTRY_SIZE + pyramid_[l].data.size ();
+  return (size);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFImageWriter::compress (const char* input, 
+                                   uint32_t uncompressed_size, 
+                                   uint32_t width,
+                                   uint32_t height,
+                                   const std::string &image_type,
+                                   char *output)
+{
+  StageTimer timer (statistics_, LZFIOStatistics::WRITE_COMPRESS);
+  // The cheaper levels of the adaptive mode use another codec for this image only
+  const ImageCodec *codec = codec_;
+  if (level_ == LZFCompressionController::FAST)
+    codec = ImageCodec::get (ImageCodec::LZ4) ? ImageCodec::get (ImageCodec::LZ4) : ImageCodec::get (ImageCodec::LZF);
+  else if (level_ == LZFCompressionController::STORED)
+    codec = ImageCodec::get (ImageCodec::LZF);
+
+  uint32_t compressed_final_size = 0;
+  // Only the extended header can hold a codec other than LZF, pyramid levels, stored or quantized images
+  // and reference hashes
+  if ((band_rows_ > 0 || codec->getId () != ImageCodec::LZF || !pyramid_.empty () ||
+       level_ == LZFCompressionController::STORED || quantization_step_ > 0 || has_reference_hash_) && height > 0)
+    compressed_final_size = compressBands (input, uncompressed_size, width, height, image_type, *codec, output);
+  else
+  {
+    static const int header_size = LZF_HEADER_SIZE;
+    unsigned int compressed_size = lzfCompressData (input,
+                                                    uncompressed_size,
+                                                    &output[header_size],
+                                                    static_cast<uint32_t> (std::min<size_t> (lzfMaxCompressedSize (uncompressed_size), UINT_MAX)));
+
+    if (compressed_size)
+    {
+      // Copy the header first
+      writeHeader (output, "PCLZF", width, height, image_type, compressed_size, uncompressed_size);
+      compressed_final_size = uint32_t (compressed_size + header_size);
+    }
+  }
+
+  if (statistics_ && compressed_final_size > 0)
+    statistics_->addImage (true, uncompressed_size, compressed_final_size);
+  return (compressed_final_size);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::setCodec (ImageCodec::Id id)
+{
+  const ImageCodec *codec = ImageCodec::get (id);
+  if (codec == NULL)
+  {
+    PCL_WARN ("[pcl::io::LZFImageWriter::setCodec] Codec %d is not available in this build, keeping %s.\n", static_cast<int> (id), codec_->getName ());
+    return (false);
+  }
+  codec_ = codec;
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFImageWriter::compressBands (const char* input,
+                                        uint32_t uncompressed_size,
+                                        uint32_t width,
+                                        uint32_t height,
+                                        const std::string &image_type,
+                                        const ImageCodec &codec,
+                                        char *output)
+{
+  if (uncompressed_size == 0)
+    return (0);
+  // Without band_rows_ (non-LZF codec) the whole image is a single band, as is a stored image
+  bool stored = level_ == LZFCompressionController::STORED;
+  uint32_t band_size = stored ? uncompressed_size : (uncompressed_size / height) * band_rows_;
+  if (band_size == 0 || band_size > uncompressed_size)
+    band_size = uncompressed_size;
+  uint32_t nr_bands = (uncompressed_size + band_size - 1) / band_size;
+  if (nr_bands == 0)
+    return (0);
+
+  uint32_t header_size = LZF_EXT_HEADER_SIZE + nr_bands * LZF_EXT_BAND_ENTRY_SIZE;
+  char *band_table = &output[LZF_EXT_HEADER_SIZE];
+  if (quantization_step_ > 0)
+  {
+    memcpy (&output[header_size],     &quantization_step_,      sizeof (uint32_t));
+    memcpy (&output[header_size + 4], &quantization_max_depth_, sizeof (uint32_t));
+    header_size += LZF_EXT_QUANT_ENTRY_SIZE;
+  }
+  if (has_reference_hash_)
+  {
+    memcpy (&output[header_size], &reference_hash_, sizeof (uint64_t));
+    header_size += LZF_EXT_REF_ENTRY_SIZE;
+  }
+
+  // The coarse levels go first, so that reading them touches as little data as possible
+  char *level_table = &output[header_size];
+  header_size += static_cast<uint32_t> (pyramid_.size ()) * LZF_EXT_LEVEL_ENTRY_SIZE;
+  for (size_t l = 0; l < pyramid_.size (); ++l)
+  {
+    const Level &level = pyramid_[l];
+    uint32_t level_size = static_cast<uint32_t> (level.data.size ());
+    uint32_t size = level_size > 1 && !stored ? codec.compress (&level.data[0], level_size, &output[header_size], level_size - 1) : 0;
+    if (size == 0)
+    {
+      memcpy (&output[header_size], &level.data[0], level_size);
+      size = level_size;
+    }
+    char *entry = &level_table[l * LZF_EXT_LEVEL_ENTRY_SIZE];
+    memcpy (&entry[0],  &level.width,  sizeof (uint32_t));
+    memcpy (&entry[4],  &level.height, sizeof (uint32_t));
+    memcpy (&entry[8],  &level.scale,  sizeof (uint32_t));
+    memcpy (&entry[12], &size,         sizeof (uint32_t));
+    memcpy (&entry[16], &level_size,   sizeof (uint32_t));
+    header_size += size;
+  }
+  char *data = &output[header_size];
+
+  // Every band is compressed into its own band_size slot first. A band that
+  // does not shrink is stored as is, which is recognizable on read because a
+  // compressed band is always strictly smaller than the raw one.
+#ifdef _OPENMP
+#pragma omp parallel for num_threads (getNumberOfThreads (nr_threads_)) schedule (dynamic)
+#endif
+  for (int b = 0; b < static_cast<int> (nr_bands); ++b)
+  {
+    uint32_t offset = uint32_t (b) * band_size;
+    uint32_t length = std::min (band_size, uncompressed_size - offset);
+    unsigned int size = stored ? 0 : codec.compress (&input[offset], length, &data[offset], length - 1);
+    if (size == 0)
+    {
+      memcpy (&data[offset], &input[offset], length);
+      size = length;
+    }
+    memcpy (&band_table[b * LZF_EXT_BAND_ENTRY_SIZE], &size, sizeof (uint32_t));
+  }
+
+  // Close the gaps between the bands. Bands only ever move towards the front.
+  uint32_t compressed_size = 0;
+  for (uint32_t b = 0; b < nr_bands; ++b)
+  {
+    uint32_t size;
+    memcpy (&size, &band_table[b * LZF_EXT_BAND_ENTRY_SIZE], sizeof (uint32_t));
+    if (compressed_size != b * band_size)
+      memmove (&data[compressed_size], &data[b * band_size], size);
+    compressed_size += size;
+  }
+
+  writeHeader (output, "PCLZX", width, height, image_type, compressed_size, uncompressed_size);
+  if (has_reference_hash_)
+    output[37] = LZF_EXT_HEADER_VERSION;
+  else if (quantization_step_ > 0)
+    output[37] = LZF_EXT_HEADER_VERSION_QUANTIZED;
+  else if (!pyramid_.empty ())
+    output[37] = LZF_EXT_HEADER_VERSION_PYRAMID;
+  else if (codec.getId () != ImageCodec::LZF)
+    output[37] = LZF_EXT_HEADER_VERSION_CODEC;
+  else
+    output[37] = LZF_EXT_HEADER_VERSION_LZF_ONLY;
+  output[38] = static_cast<char> ((pyramid_.empty () ? 0 : LZF_EXT_FLAG_PYRAMID) | (stored ? LZF_EXT_FLAG_STORED : 0) |
+                                  (quantization_step_ > 0 ? LZF_EXT_FLAG_QUANTIZED : 0) |
+                                  (has_reference_hash_ ? LZF_EXT_FLAG_REFERENCE : 0));
+  output[39] = static_cast<char> (codec.getId ());
+  output[40] = static_cast<char> (pyramid_.size ());
+  memcpy (&output[41], &band_size, sizeof (uint32_t));
+  memcpy (&output[45], &nr_bands, sizeof (uint32_t));
+  return (compressed_size + header_size);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFImageWriter::encodeImage (const char* data,
+                                      uint32_t width, uint32_t height,
+                                      std::vector<char> &output)
+{
+  if (controller_ == NULL)
+  {
+    level_ = LZFCompressionController::FULL;
+    return (encode (data, width, height, output));
+  }
+
+  size_t image_size = getImageSize (width, height);
+  level_ = controller_->select (image_size);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  uint32_t blob_size = encode (data, width, height, output);
+  // Storing an image does not depend on how well it compresses. Each level
+  // is charged with its own attempt only.
+  if (blob_size == 0 && level_ != LZFCompressionController::STORED)
+  {
+    controller_->update (level_, image_size, 0,
+                         std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ());
+    level_ = LZFCompressionController::STORED;
+    start = std::chrono::steady_clock::now ();
+    blob_size = encode (data, width, height, output);
+  }
+  controller_->update (level_, image_size, blob_size,
+                       std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ());
+  return (blob_size);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::write (const char* data,
+                                uint32_t width, uint32_t height,
+                                const std::string &filename,
+                                uint64_t timestamp)
+{
+  uint64_t sequence = sequence_++;
+  if (!write (data, width, height, filename))
+    return (false);
+  if (frame_index_ && !frame_index_->append (filename, timestamp, sequence))
+    return (false);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::write (const char* data,
+                                uint32_t width, uint32_t height,
+                                LZFStreamWriter &stream,
+                                uint64_t timestamp)
+{
+  uint32_t blob_size = encodeImage (data, width, height, compressed_buffer_);
+  if (blob_size == 0)
+    return (false);
+
+  StageTimer timer (statistics_, LZFIOStatistics::WRITE_IO);
+  if (!stream.append (&compressed_buffer_[0], blob_size, timestamp))
+  {
+    discardEncoded ();
+    return (false);
+  }
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::write (const char* data,
+                                uint32_t width, uint32_t height,
+                                LZFSharedRingWriter &ring,
+                                uint64_t timestamp)
+{
+  uint32_t blob_size = encodeImage (data, width, height, compressed_buffer_);
+  if (blob_size == 0)
+    return (false);
+
+  StageTimer timer (statistics_, LZFIOStatistics::WRITE_IO);
+  if (!ring.append (&compressed_buffer_[0], blob_size, timestamp))
+  {
+    discardEncoded ();
+    return (false);
+  }
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::write (const char* data,
+                                uint32_t width, uint32_t height,
+                                LZFFlightRecorder &recorder,
+                                uint64_t timestamp)
+{
+  uint32_t blob_size = encodeImage (data, width, height, compressed_buffer_);
+  if (blob_size == 0)
+    return (false);
+
+  StageTimer timer (statistics_, LZFIOStatistics::WRITE_IO);
+  if (!recorder.append (&compressed_buffer_[0], blob_size, timestamp))
+  {
+    discardEncoded ();
+    return (false);
+  }
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFDepth16ImageWriter::encode (const char* data,
+                                        uint32_t width, uint32_t height,
+                                        std::vector<char> &output)
+{
+  // Prepare the compressed depth buffer
+  unsigned int depth_size = width * height * 2;
+  buildPyramid (data, width, height);
+  char *compressed_depth = growBuffer (output, getMaxCompressedSize (depth_size, height));
+
+  if (quantization_step_ == 0)
+    return (compress (data,
+                      depth_size,
+                      width, height,
+                      "depth16",
+                      compressed_depth));
+
+  char *planes = growBuffer (shuffle_buffer_, depth_size);
+  {
+    StageTimer timer (statistics_, LZFIOStatistics::WRITE_SHUFFLE);
+    quantizeDepth16 (data, size_t (width) * height, static_cast<uint16_t> (quantization_step_),
+                     static_cast<uint16_t> (quantization_max_depth_), planes);
+  }
+  return (compress (planes,
+                    depth_size,
+                    width, height,
+                    "depth16q",
+                    compressed_depth));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageWriter::write (const char* data,
+                                       uint32_t width, uint32_t height,
+                                       const std::string &filename)
+{
+  size_t compressed_size = encodeImage (data, width, height, compressed_buffer_);
+  if (compressed_size == 0)
+    return (false);
+
+  // Save the actual image
+  if (!saveImageBlob (&compressed_buffer_[0], compressed_size, filename))
+  {
+    discardEncoded ();
+    return (false);
+  }
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFDepth16ImageWriter::setPyramidLevels (unsigned int nr_levels, unsigned int scale)
+{
+  if (nr_levels > LZF_MAX_PYRAMID_LEVELS)
+  {
+    PCL_WARN ("[pcl::io::LZFDepth16ImageWriter::setPyramidLevels] At most %d levels are supported.\n", LZF_MAX_PYRAMID_LEVELS);
+    nr_levels = LZF_MAX_PYRAMID_LEVELS;
+  }
+  nr_levels_ = nr_levels;
+  level_scale_ = std::max (scale, 2u);
+  if (nr_levels_ == 0)
+    pyramid_.clear ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageWriter::setQuantization (double max_range, double max_error)
+{
+  // Half a bin of error, the epsilon keeps e.g. 0.7 / 0.001 from flooring to 699
+  return (setQuantizationStep (max_range / z_multiplication_factor_ + 1e-6,
+                               2.0 * max_error / z_multiplication_factor_ + 1e-6));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageWriter::setQuantizationBits (double max_range, unsigned int nr_bits)
+{
+  if (nr_bits < 2 || nr_bits > 16)
+  {
+    PCL_ERROR ("[pcl::io::LZFDepth16ImageWriter::setQuantizationBits] Quantized values need between 2 and 16 bits, not %u!\n", nr_bits);
+    return (false);
+  }
+  // 2^nr_bits - 2 bins for the range, plus 0 and the out of range code
+  double max_depth = std::floor (max_range / z_multiplication_factor_ + 1e-6);
+  return (setQuantizationStep (max_depth, std::floor (max_depth / double ((1u << nr_bits) - 2)) + 1.0));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageWriter::setQuantizationStep (double max_depth, double step)
+{
+  if (max_depth < 1.0)
+  {
+    quantization_step_ = 0;
+    quantization_max_depth_ = 0;
+    return (true);
+  }
+  max_depth = std::floor (max_depth);
+  step = std::max (std::floor (step), 1.0);
+  // Out of range values are read back as max_depth + 1, and get the code after the last bin
+  if (max_depth >= 65535.0 || step > max_depth || std::floor (max_depth / step) > 65533.0)
+  {
+    PCL_ERROR ("[pcl::io::LZFDepth16ImageWriter::setQuantization] A range of %g with bins of %g depth units does not fit 16-bit depth values!\n", max_depth, step);
+    return (false);
+  }
+  quantization_step_ = static_cast<uint32_t> (step);
+  quantization_max_depth_ = static_cast<uint32_t> (max_depth);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFDepth16ImageWriter::buildPyramid (const char *data, uint32_t width, uint32_t height)
+{
+  if (nr_levels_ == 0)
+    return;
+
+  StageTimer timer (statistics_, LZFIOStatistics::WRITE_SHUFFLE);
+  pyramid_.resize (nr_levels_);
+  const char *depth = data;
+  uint32_t scale = 1;
+  // Every level is pooled from the previous one, which gives the same minimum as pooling the full image
+  for (size_t l = 0; l < pyramid_.size (); ++l)
+  {
+    Level &level = pyramid_[l];
+    level.width = (width + level_scale_ - 1) / level_scale_;
+    level.height = (height + level_scale_ - 1) / level_scale_;
+    level.scale = scale *= level_scale_;
+    level.data.resize (size_t (level.width) * level.height * 2);
+    minPoolDepth16 (depth, width, height, level_scale_, &level.data[0]);
+    depth = &level.data[0];
+    width = level.width;
+    height = level.height;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFDepth16DeltaImageWriter::encode (const char* data,
+                                             uint32_t width, uint32_t height,
+                                             std::vector<char> &output)
+{
+  // The cheaper adaptive levels store the plain depth values, quantized
+  // images have a filter of their own
+  if (level_ != LZFCompressionController::FULL || quantization_step_ > 0)
+    return (LZFDepth16ImageWriter::encode (data, width, height, output));
+
+  // Transform the depth values into byte planes of row deltas for better compression
+  unsigned int depth_size = width * height * 2;
+  char *planes = growBuffer (shuffle_buffer_, depth_size);
+  {
+    StageTimer timer (statistics_, LZFIOStatistics::WRITE_SHUFFLE);
+    encodeDepth16Delta (data, width, height, planes);
+  }
+
+  buildPyramid (data, width, height);
+  char *compressed_depth = growBuffer (output, getMaxCompressedSize (depth_size, height));
+  return (compress (planes,
+                    depth_size,
+                    width, height,
+                    "depth16d",
+                    compressed_depth));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFDepth16TemporalImageWriter::encode (const char* data,
+                                                uint32_t width, uint32_t height,
+                                                std::vector<char> &output)
+{
+  // Plain depth images of the cheaper adaptive levels are no reference for
+  // readers, so the next fully compressed image is a keyframe
+  if (level_ != LZFCompressionController::FULL)
+  {
+    forceKeyframe ();
+    return (LZFDepth16DeltaImageWriter::encode (data, width, height, output));
+  }
+
+  unsigned int depth_size = width * height * 2;
+  if (width != reference_width_ || height != reference_height_)
+    forceKeyframe ();
+
+  // Readers reconstruct quantized images, which is what the deltas have to be taken against
+  if (quantization_step_ > 0)
+  {
+    char *planes = growBuffer (shuffle_buffer_, depth_size);
+    char *quantized = growBuffer (quantized_image_, depth_size);
+    StageTimer timer (statistics_, LZFIOStatistics::WRITE_SHUFFLE);
+    quantizeDepth16 (data, size_t (width) * height, static_cast<uint16_t> (quantization_step_),
+                     static_cast<uint16_t> (quantization_max_depth_), planes);
+    dequantizeDepth16 (planes, size_t (width) * height, static_cast<uint16_t> (quantization_step_),
+                       static_cast<uint16_t> (quantization_max_depth_), quantized);
+    data = quantized;
+  }
+
+  uint32_t blob_size;
+  if (frames_since_keyframe_ == 0 || frames_since_keyframe_ >= keyframe_interval_ || keyframes_left_ > 0)
+  {
+    blob_size = LZFDepth16DeltaImageWriter::encode (data, width, height, output);
+    keyframe_size_ = blob_size;
+    frames_since_keyframe_ = 0;
+    if (keyframes_left_ > 0)
+      --keyframes_left_;
+  }
+  else
+  {
+    // Store the difference to the previous image, which is mostly zeros for a slow moving camera
+    char *planes = growBuffer (shuffle_buffer_, depth_size);
+    {
+      StageTimer timer (statistics_, LZFIOStatistics::WRITE_SHUFFLE);
+      encodeDepth16Temporal (data, &reference_[0], size_t (width) * height, planes);
+    }
+
+    buildPyramid (data, width, height);
+    reference_hash_ = hashImage (&reference_[0], depth_size);
+    has_reference_hash_ = true;
+    char *compressed_depth = growBuffer (output, getMaxCompressedSize (depth_size, height));
+    blob_size = compress (planes,
+                          depth_size,
+                          width, height,
+                          "depth16t",
+                          compressed_depth);
+    has_reference_hash_ = false;
+    // Deltas larger than a keyframe do not pay off, give them a rest
+    if (blob_size > keyframe_size_)
+      keyframes_left_ = keyframe_interval_;
+  }
+
+  if (blob_size == 0)
+  {
+    forceKeyframe ();
+    return (0);
+  }
+  reference_.assign (data, data + depth_size);
+  reference_width_ = width;
+  reference_height_ = height;
+  ++frames_since_keyframe_;
+  return (blob_size);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::writeParameter (const double &parameter,
+                                         const std::string &tag,
+                                         const std::string &filename)
+{
+  LZFParameterSession session;
+  writeParameter (parameter, tag, session, filename);
+  return (session.sync ());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageWriter::writeParameter (const double &parameter,
+                                         const std::string &tag,
+                                         LZFParameterSession &session,
+                                         const std::string &filename)
+{
+  session.put (filename, tag, parameter);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageWriter::writeParameters (const pcl::io::CameraParameters &parameters,
+                                                 const std::string &filename)
+{
+  LZFParameterSession session;
+  writeParameters (parameters, session, filename);
+  return (session.sync ());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageWriter::writeParameters (const pcl::io::CameraParameters &parameters,
+                                                 LZFParameterSession &session,
+                                                 const std::string &filename)
+{
+  session.put (filename, "depth.focal_length_x", parameters.focal_length_x);
+  session.put (filename, "depth.focal_length_y", parameters.focal_length_y);
+  session.put (filename, "depth.principal_point_x", parameters.principal_point_x);
+  session.put (filename, "depth.principal_point_y", parameters.principal_point_y);
+  session.put (filename, "depth.z_multiplication_factor", z_multiplication_factor_);
+  // Not needed to read the images back, but tells how exact the depth is
+  if (quantization_step_ > 0)
+  {
+    session.put (filename, "depth.max_range", quantization_max_depth_ * z_multiplication_factor_);
+    session.put (filename, "depth.quantization_error", getQuantizationError ());
+  }
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFRGB24ImageWriter::encode (const char *data,
+                                      uint32_t width, uint32_t height,
+                                      std::vector<char> &output)
+{
+  // Transform RGBRGB into RRGGBB for better compression
+  uint32_t rgb_size = width * height * 3;
+  char *rrggbb = growBuffer (shuffle_buffer_, rgb_size);
+  {
+    StageTimer timer (statistics_, LZFIOStatistics::WRITE_SHUFFLE);
+    deinterleaveRGB24 (data, width * height, rrggbb);
+  }
+
+  char *compressed_rgb = growBuffer (output, getMaxCompressedSize (rgb_size, height));
+  return (compress (rrggbb,
+                    rgb_size,
+                    width, height,
+                    "rgb24",
+                    compressed_rgb));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFRGB24ImageWriter::write (const char *data, 
+                                     uint32_t width, uint32_t height,
+                                     const std::string &filename)
+{
+  size_t compressed_size = encodeImage (data, width, height, compressed_buffer_);
+  if (compressed_size == 0)
+    return (false);
+
+  // Save the actual image
+  return (saveImageBlob (&compressed_buffer_[0], compressed_size, filename));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFRGB24ImageWriter::writeParameters (const pcl::io::CameraParameters &parameters,
+                                              const std::string &filename)
+{
+  LZFParameterSession session;
+  writeParameters (parameters, session, filename);
+  return (session.sync ());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFRGB24ImageWriter::writeParameters (const pcl::io::CameraParameters &parameters,
+                                              LZFParameterSession &session,
+                                              const std::string &filename)
+{
+  session.put (filename, "rgb.focal_length_x", parameters.focal_length_x);
+  session.put (filename, "rgb.focal_length_y", parameters.focal_length_y);
+  session.put (filename, "rgb.principal_point_x", parameters.principal_point_x);
+  session.put (filename, "rgb.principal_point_y", parameters.principal_point_y);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFYUV422ImageWriter::encode (const char *data, 
+                                       uint32_t width, uint32_t height,
+                                       std::vector<char> &output)
+{
+  // Transform YUV422 into UUUYYYYYYVVV for better compression
+  uint32_t yuv_size = width * height * 2;
+  char *uuyyvv = growBuffer (shuffle_buffer_, yuv_size);
+  {
+    StageTimer timer (statistics_, LZFIOStatistics::WRITE_SHUFFLE);
+    deinterleaveYUV422 (data, width * height, uuyyvv);
+  }
+
+  char *compressed_yuv = growBuffer (output, getMaxCompressedSize (yuv_size, height));
+  return (compress (uuyyvv,
+                    yuv_size,
+                    width, height,
+                    "yuv422",
+                    compressed_yuv));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFYUV422ImageWriter::write (const char *data, 
+                                      uint32_t width, uint32_t height,
+                                      const std::string &filename)
+{
+  size_t compressed_size = encodeImage (data, width, height, compressed_buffer_);
+  if (compressed_size == 0)
+    return (false);
+
+  // Save the actual image
+  return (saveImageBlob (&compressed_buffer_[0], compressed_size, filename));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::uint32_t
+pcl::io::LZFBayer8ImageWriter::encode (const char *data, 
+                                       uint32_t width, uint32_t height,
+                                       std::vector<char> &output)
+{
+  unsigned int bayer_size = width * height;
+  char *compressed_bayer = growBuffer (output, getMaxCompressedSize (bayer_size, height));
+  return (compress (data,
+                    bayer_size,
+                    width, height,
+                    "bayer8",
+                    compressed_bayer));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFBayer8ImageWriter::write (const char *data, 
+                                      uint32_t width, uint32_t height,
+                                      const std::string &filename)
+{
+  size_t compressed_size = encodeImage (data, width, height, compressed_buffer_);
+  if (compressed_size == 0)
+    return (false);
+
+  // Save the actual image
+  return (saveImageBlob (&compressed_buffer_[0], compressed_size, filename));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+struct pcl::io::LZFParameterSession::Document
+{
+  boost::property_tree::ptree tree;
+  bool modified;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFParameterSession::LZFParameterSession ()
+  : documents_ ()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFParameterSession::~LZFParameterSession ()
+{
+  sync ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFParameterSession::put (const std::string &filename,
+                                   const std::string &tag,
+                                   double value)
+{
+  boost::shared_ptr<Document> &document = documents_[filename];
+  if (!document)
+  {
+    // Keep whatever else is stored in the file
+    document.reset (new Document);
+    document->modified = false;
+    try
+    {
+      boost::property_tree::xml_parser::read_xml (filename, document->tree, boost::property_tree::xml_parser::trim_whitespace);
+    }
+    catch (std::exception& e)
+    {}
+  }
+  document->tree.put (tag, value);
+  document->modified = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFParameterSession::sync ()
+{
+  bool res = true;
+  auto settings = boost::property_tree::xml_writer_make_settings<std::string> ('\t', 1);
+  for (std::map<std::string, boost::shared_ptr<Document> >::iterator it = documents_.begin (); it != documents_.end (); ++it)
+  {
+    if (!it->second->modified)
+      continue;
+    try
+    {
+      write_xml (it->first, it->second->tree, std::locale (), settings);
+      it->second->modified = false;
+    }
+    catch (std::exception& e)
+    {
+      PCL_ERROR ("[pcl::io::LZFParameterSession::sync] Error writing %s: %s\n", it->first.c_str (), e.what ());
+      res = false;
+    }
+    getParametersCache ().invalidate (it->first);
+  }
+  return (res);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+size_t
+pcl::io::LZFParameterSession::getNumberOfModifiedFiles () const
+{
+  size_t nr_files = 0;
+  for (std::map<std::string, boost::shared_ptr<Document> >::const_iterator it = documents_.begin (); it != documents_.end (); ++it)
+    if (it->second->modified)
+      ++nr_files;
+  return (nr_files);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFAsyncImageWriter::LZFAsyncImageWriter (LZFImageWriter &writer,
+                                                   size_t queue_size,
+                                                   QueuePolicy policy)
+  : writer_ (writer)
+  , policy_ (policy)
+  , queue_size_ (std::max<size_t> (queue_size, 1))
+  , frames_ (queue_size_ + 1)
+  , current_ ()
+  , write_index_ (0)
+  , read_index_ (0)
+  , done_index_ (0)
+  , dropped_frames_ (0)
+  , written_frames_ (0)
+  , failed_frames_ (0)
+  , max_queue_depth_ (0)
+  , stopping_ (false)
+  , queued_waiters_ (0)
+  , done_waiters_ (0)
+  , mutex_ ()
+  , frame_queued_ ()
+  , frame_done_ ()
+  , thread_ ()
+{
+  for (size_t i = 0; i < frames_.size (); ++i)
+  {
+    frames_[i].sequence.store (i);
+    frames_[i].width = frames_[i].height = 0;
+    frames_[i].stream = NULL;
+    frames_[i].timestamp = 0;
+    frames_[i].has_timestamp = false;
+  }
+  current_.width = current_.height = 0;
+  current_.stream = NULL;
+  current_.timestamp = 0;
+  current_.has_timestamp = false;
+  thread_ = std::thread (&LZFAsyncImageWriter::run, this);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFAsyncImageWriter::~LZFAsyncImageWriter ()
+{
+  stop ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFAsyncImageWriter::Frame*
+pcl::io::LZFAsyncImageWriter::acquireSlot ()
+{
+  // write_index_ is only ever modified by the producer, i.e. by this thread
+  uint64_t write_index = write_index_.load (std::memory_order_relaxed);
+  for (;;)
+  {
+    // Nothing takes images off the queue any more
+    if (stopping_.load ())
+    {
+      dropped_frames_.fetch_add (1);
+      return (NULL);
+    }
+
+    uint64_t read_index = read_index_.load (std::memory_order_acquire);
+    if (write_index - read_index < queue_size_)
+    {
+      Frame &frame = frames_[write_index % frames_.size ()];
+      if (frame.sequence.load (std::memory_order_acquire) == write_index)
+        return (&frame);
+      // The background thread is still moving an older image out of this slot
+      std::this_thread::yield ();
+      continue;
+    }
+
+    if (policy_ == DROP_NEWEST)
+    {
+      dropped_frames_.fetch_add (1);
+      return (NULL);
+    }
+
+    if (policy_ == DROP_OLDEST)
+    {
+      // Races with the background thread taking the same image off the queue.
+      // Whoever loses simply looks at the queue again.
+      if (read_index_.compare_exchange_weak (read_index, read_index + 1, std::memory_order_acq_rel))
+      {
+        frames_[read_index % frames_.size ()].sequence.store (read_index + frames_.size (), std::memory_order_release);
+        dropped_frames_.fetch_add (1);
+        done_index_.fetch_add (1);
+        notifyDone ();
+      }
+      continue;
+    }
+
+    // BLOCK. Registering as a waiter before looking at the queue again means
+    // that the background thread either sees the waiter or we see its progress.
+    std::unique_lock<std::mutex> lock (mutex_);
+    done_waiters_.fetch_add (1);
+    if (write_index - read_index_.load () >= queue_size_ && !stopping_.load ())
+      frame_done_.wait_for (lock, std::chrono::milliseconds (1));
+    done_waiters_.fetch_sub (1);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFAsyncImageWriter::publishSlot (Frame &frame, const char *data,
+                                           uint32_t width, uint32_t height)
+{
+  size_t size = writer_.getImageSize (width, height);
+  if (frame.data.size () < size)
+    frame.data.resize (size);
+  if (size > 0)
+    memcpy (&frame.data[0], data, size);
+  frame.width = width;
+  frame.height = height;
+
+  uint64_t write_index = write_index_.load (std::memory_order_relaxed) + 1;
+  frame.sequence.store (write_index, std::memory_order_release);
+  // Sequentially consistent, paired with the registration of a sleeping background thread in run ()
+  write_index_.store (write_index);
+
+  size_t depth = static_cast<size_t> (write_index - read_index_.load (std::memory_order_relaxed));
+  if (depth > max_queue_depth_.load (std::memory_order_relaxed))
+    max_queue_depth_.store (depth, std::memory_order_relaxed);
+
+  // Only a sleeping background thread costs the producer the lock
+  if (queued_waiters_.load () > 0)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    frame_queued_.notify_one ();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFAsyncImageWriter::notifyDone ()
+{
+  if (done_waiters_.load () > 0)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    frame_done_.notify_all ();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFAsyncImageWriter::write (const char* data,
+                                     uint32_t width, uint32_t height,
+                                     const std::string &filename)
+{
+  Frame *frame = acquireSlot ();
+  if (!frame)
+    return (false);
+
+  frame->filename = filename;
+  frame->stream = NULL;
+  frame->timestamp = 0;
+  frame->has_timestamp = false;
+  publishSlot (*frame, data, width, height);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFAsyncImageWriter::write (const char* data,
+                                     uint32_t width, uint32_t height,
+                                     const std::string &filename,
+                                     uint64_t timestamp)
+{
+  Frame *frame = acquireSlot ();
+  if (!frame)
+    return (false);
+
+  frame->filename = filename;
+  frame->stream = NULL;
+  frame->timestamp = timestamp;
+  frame->has_timestamp = true;
+  publishSlot (*frame, data, width, height);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFAsyncImageWriter::write (const char* data,
+                                     uint32_t width, uint32_t height,
+                                     LZFStreamWriter &stream,
+                                     uint64_t timestamp)
+{
+  Frame *frame = acquireSlot ();
+  if (!frame)
+    return (false);
+
+  frame->stream = &stream;
+  frame->timestamp = timestamp;
+  frame->has_timestamp = true;
+  publishSlot (*frame, data, width, height);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFAsyncImageWriter::flush ()
+{
+  while (thread_.joinable () &&
+         done_index_.load (std::memory_order_acquire) < write_index_.load (std::memory_order_acquire))
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    done_waiters_.fetch_add (1);
+    if (done_index_.load () < write_index_.load ())
+      frame_done_.wait_for (lock, std::chrono::milliseconds (1));
+    done_waiters_.fetch_sub (1);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFAsyncImageWriter::stop ()
+{
+  if (!thread_.joinable ())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    stopping_.store (true);
+    frame_queued_.notify_all ();
+    frame_done_.notify_all ();
+  }
+  thread_.join ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFAsyncImageWriter::run ()
+{
+  for (;;)
+  {
+    uint64_t read_index = read_index_.load (std::memory_order_acquire);
+    if (read_index == write_index_.load (std::memory_order_acquire))
+    {
+      // The queue is drained before stopping
+      if (stopping_.load ())
+        break;
+      // Registered before the queue is checked again: either the producer
+      // sees the waiter and wakes us up, or we see its new image
+      std::unique_lock<std::mutex> lock (mutex_);
+      queued_waiters_.fetch_add (1);
+      if (read_index == write_index_.load () && !stopping_.load ())
+        frame_queued_.wait_for (lock, std::chrono::milliseconds (10));
+      queued_waiters_.fetch_sub (1);
+      continue;
+    }
+
+    // The producer may have dropped this image in the meantime
+    if (!read_index_.compare_exchange_strong (read_index, read_index + 1))
+      continue;
+
+    // Take the image out of its slot and hand the slot back to the producer
+    Frame &frame = frames_[read_index % frames_.size ()];
+    current_.data.swap (frame.data);
+    current_.filename.swap (frame.filename);
+    current_.width = frame.width;
+    current_.height = frame.height;
+    current_.stream = frame.stream;
+    current_.timestamp = frame.timestamp;
+    current_.has_timestamp = frame.has_timestamp;
+    frame.sequence.store (read_index + frames_.size (), std::memory_order_release);
+
+    bool res;
+    if (current_.stream)
+      res = writer_.write (&current_.data[0], current_.width, current_.height, *current_.stream, current_.timestamp);
+    else if (current_.has_timestamp)
+      res = writer_.write (&current_.data[0], current_.width, current_.height, current_.filename, current_.timestamp);
+    else
+      res = writer_.write (&current_.data[0], current_.width, current_.height, current_.filename);
+    if (res)
+      written_frames_.fetch_add (1);
+    else
+    {
+      failed_frames_.fetch_add (1);
+      PCL_WARN ("[pcl::io::LZFAsyncImageWriter::run] Failed to write a %ux%u image!\n", current_.width, current_.height);
+    }
+
+    done_index_.fetch_add (1);
+    notifyDone ();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFFlightRecorder::LZFFlightRecorder (size_t capacity, uint64_t window)
+  : buffer_ (std::max<size_t> ((capacity + 7) & ~static_cast<size_t> (7), 4 * LZF_RECORDER_RECORD_HEADER_SIZE))
+  , window_ (window)
+  , head_ (0)
+  , tail_ (0)
+  , pin_ (NO_PIN)
+  , newest_timestamp_ (0)
+  , dropped_frames_ (0)
+  , flushed_frames_ (0)
+  , flushing_ (false)
+  , flush_result_ (true)
+  , thread_ ()
+  , trigger_mutex_ ()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFFlightRecorder::~LZFFlightRecorder ()
+{
+  waitForFlush ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+uint64_t
+pcl::io::LZFFlightRecorder::skipPadding (uint64_t position) const
+{
+  uint64_t capacity = buffer_.size ();
+  uint64_t offset = position % capacity;
+  uint64_t left = capacity - offset;
+  if (left < LZF_RECORDER_RECORD_HEADER_SIZE)
+    return (position + left);
+
+  uint32_t blob_size;
+  memcpy (&blob_size, &buffer_[offset + sizeof (uint64_t)], sizeof (uint32_t));
+  if (blob_size == LZF_RECORDER_WRAP)
+    return (position + left);
+  return (position);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+uint64_t
+pcl::io::LZFFlightRecorder::readRecord (uint64_t position, uint64_t &timestamp, uint32_t &blob_size) const
+{
+  size_t offset = static_cast<size_t> (position % buffer_.size ());
+  memcpy (&timestamp, &buffer_[offset], sizeof (uint64_t));
+  memcpy (&blob_size, &buffer_[offset + sizeof (uint64_t)], sizeof (uint32_t));
+  return (position + ((LZF_RECORDER_RECORD_HEADER_SIZE + blob_size + 7) & ~static_cast<uint64_t> (7)));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFFlightRecorder::append (const char *blob, uint32_t blob_size, uint64_t timestamp)
+{
+  uint64_t capacity = buffer_.size ();
+  uint64_t record_size = (LZF_RECORDER_RECORD_HEADER_SIZE + static_cast<uint64_t> (blob_size) + 7) & ~static_cast<uint64_t> (7);
+  if (record_size > capacity / 2)
+  {
+    dropped_frames_.fetch_add (1, std::memory_order_relaxed);
+    return (false);
+  }
+
+  // head_ and tail_ are only ever modified by the producer, i.e. by this thread
+  uint64_t head = head_.load (std::memory_order_relaxed);
+  uint64_t left = capacity - head % capacity;
+  uint64_t start = left < record_size ? head + left : head;
+  uint64_t end = start + record_size;
+
+  uint64_t old_tail = tail_.load (std::memory_order_relaxed);
+  uint64_t tail = old_tail;
+  while (end - tail > capacity)
+  {
+    uint64_t evicted_timestamp;
+    uint32_t evicted_size;
+    tail = readRecord (skipPadding (tail), evicted_timestamp, evicted_size);
+  }
+
+  if (tail != old_tail)
+  {
+    // Publish the eviction before looking at the pin; trigger () does the
+    // opposite, so at least one of the two sees the other's store
+    tail_.store (tail);
+    if (pin_.load () < tail)
+    {
+      // A running flush still has to write the records we would overwrite
+      tail_.store (old_tail);
+      dropped_frames_.fetch_add (1, std::memory_order_relaxed);
+      return (false);
+    }
+  }
+
+  if (start != head && left >= LZF_RECORDER_RECORD_HEADER_SIZE)
+  {
+    uint32_t wrap = LZF_RECORDER_WRAP;
+    memcpy (&buffer_[static_cast<size_t> (head % capacity) + sizeof (uint64_t)], &wrap, sizeof (uint32_t));
+  }
+  size_t offset = static_cast<size_t> (start % capacity);
+  memcpy (&buffer_[offset], &timestamp, sizeof (uint64_t));
+  memcpy (&buffer_[offset + sizeof (uint64_t)], &blob_size, sizeof (uint32_t));
+  memset (&buffer_[offset + sizeof (uint64_t) + sizeof (uint32_t)], 0, sizeof (uint32_t));
+  memcpy (&buffer_[offset + LZF_RECORDER_RECORD_HEADER_SIZE], blob, blob_size);
+
+  newest_timestamp_.store (timestamp, std::memory_order_relaxed);
+  head_.store (end, std::memory_order_release);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFFlightRecorder::trigger (const std::string &filename, unsigned int post_trigger_ms)
+{
+  std::lock_guard<std::mutex> lock (trigger_mutex_);
+  if (flushing_.load ())
+    return (false);
+  if (thread_.joinable ())
+    thread_.join ();
+
+  // Pin the oldest record, making sure the producer did not evict it meanwhile
+  uint64_t tail;
+  do
+  {
+    tail = tail_.load ();
+    pin_.store (tail);
+  }
+  while (tail_.load () != tail);
+
+  uint64_t first_timestamp = 0;
+  uint64_t newest_timestamp = newest_timestamp_.load (std::memory_order_relaxed);
+  if (window_ > 0 && newest_timestamp > window_)
+    first_timestamp = newest_timestamp - window_;
+
+  flushed_frames_.store (0);
+  flushing_.store (true);
+  thread_ = std::thread (&LZFFlightRecorder::run, this, filename, post_trigger_ms, first_timestamp);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFFlightRecorder::waitForFlush ()
+{
+  std::lock_guard<std::mutex> lock (trigger_mutex_);
+  if (thread_.joinable ())
+    thread_.join ();
+  return (flush_result_.load ());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFFlightRecorder::run (std::string filename, unsigned int post_trigger_ms, uint64_t first_timestamp)
+{
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now () +
+                                                   std::chrono::milliseconds (post_trigger_ms);
+  LZFStreamWriter stream;
+  bool res = stream.open (filename, buffer_.size ());
+  uint64_t position = pin_.load ();
+  uint64_t trigger_head = head_.load (std::memory_order_acquire);
+  bool decodable = false;
+  while (res)
+  {
+    if (position >= trigger_head && std::chrono::steady_clock::now () >= deadline)
+      break;
+    if (position == head_.load (std::memory_order_acquire))
+    {
+      std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      continue;
+    }
+
+    position = skipPadding (position);
+    uint64_t timestamp;
+    uint32_t blob_size;
+    uint64_t next = readRecord (position, timestamp, blob_size);
+    const char *blob = &buffer_[static_cast<size_t> (position % buffer_.size ()) + LZF_RECORDER_RECORD_HEADER_SIZE];
+    if (timestamp >= first_timestamp)
+    {
+      // Temporal images depend on an image that may not have been written
+      if (!isTemporalBlob (blob, blob_size))
+        decodable = true;
+      if (decodable)
+      {
+        res = stream.append (blob, blob_size, timestamp);
+        if (res)
+          flushed_frames_.fetch_add (1);
+      }
+    }
+
+    // Hand the record back to the producer
+    position = next;
+    pin_.store (position);
+  }
+
+  if (stream.isOpen () && !stream.close ())
+    res = false;
+  if (!res)
+    PCL_ERROR ("[pcl::io::LZFFlightRecorder::run] Failed to write the recorded images to %s\n", filename.c_str ());
+  pin_.store (NO_PIN);
+  flush_result_.store (res);
+  flushing_.store (false);
+}
+
+namespace
+{
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Access a 64-bit word of a shared memory ring (control block or slot header). */
+  inline std::atomic<uint64_t>&
+  ringWord64 (char *map, size_t offset)
+  {
+    return (*reinterpret_cast<std::atomic<uint64_t>*> (&map[offset]));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Access a 32-bit word of a shared memory ring. */
+  inline std::atomic<uint32_t>&
+  ringWord32 (char *map, size_t offset)
+  {
+    return (*reinterpret_cast<std::atomic<uint32_t>*> (&map[offset]));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Get the size of a ring slot, header included. Slots are cache line aligned. */
+  inline uint64_t
+  ringSlotStride (uint32_t slot_size)
+  {
+    return (LZF_RING_SLOT_HEADER_SIZE + ((uint64_t (slot_size) + 63) & ~static_cast<uint64_t> (63)));
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Get the header of the slot holding a given image. */
+  inline char*
+  ringSlot (char *map, uint32_t nr_slots, uint32_t slot_size, uint64_t sequence)
+  {
+    return (&map[LZF_RING_HEADER_SIZE + (sequence % nr_slots) * ringSlotStride (slot_size)]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  /** \brief Bump the wake up counter of a ring and wake its waiting readers, if any. */
+  void
+  wakeRingReaders (char *map)
+  {
+    ringWord32 (map, 24).fetch_add (1);
+#if defined(__linux__)
+    if (ringWord32 (map, 28).load () > 0)
+      syscall (SYS_futex, reinterpret_cast<uint32_t*> (&map[24]), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFSharedRingWriter::LZFSharedRingWriter ()
+  : map_ (NULL)
+  , map_size_ (0)
+  , name_ ()
+  , nr_slots_ (0)
+  , slot_size_ (0)
+  , sequence_ (0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFSharedRingWriter::~LZFSharedRingWriter ()
+{
+  if (isOpen ())
+    close ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingWriter::create (const std::string &name, uint32_t nr_slots, uint32_t slot_size)
+{
+  if (isOpen ())
+    close ();
+
+#ifdef _WIN32
+  (void) nr_slots;
+  (void) slot_size;
+  PCL_ERROR ("[pcl::io::LZFSharedRingWriter::create] Shared memory rings are not supported on this platform (%s)!\n", name.c_str ());
+  return (false);
+#else
+  if (nr_slots < 2 || slot_size == 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingWriter::create] A ring needs at least 2 slots of at least 1 byte (got %u of %u)!\n", nr_slots, slot_size);
+    return (false);
+  }
+  uint64_t size = LZF_RING_HEADER_SIZE + nr_slots * ringSlotStride (slot_size);
+
+  // Tell the readers of a previous ring of the same name that it is gone
+  int fd = shm_open (name.c_str (), O_RDWR, 0);
+  if (fd >= 0)
+  {
+    struct stat st;
+    if (fstat (fd, &st) == 0 && st.st_size >= LZF_RING_HEADER_SIZE)
+    {
+      char *map = static_cast<char*> (mmap (0, LZF_RING_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+      if (map != reinterpret_cast<char*> (-1))    // MAP_FAILED
+      {
+        if (memcmp (map, "PCLZM", 5) == 0)
+        {
+          ringWord32 (map, 32).store (1, std::memory_order_release);
+          wakeRingReaders (map);
+        }
+        munmap (map, LZF_RING_HEADER_SIZE);
+      }
+    }
+    pcl_close (fd);
+    shm_unlink (name.c_str ());
+  }
+
+  // Readers attached to the previous ring keep their own mapping of it
+  fd = shm_open (name.c_str (), O_RDWR | O_CREAT | O_EXCL, static_cast<mode_t> (0600));
+  if (fd < 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingWriter::create] Failure to create shared memory object %s: %s\n", name.c_str (), strerror (errno));
+    return (false);
+  }
+  if (pcl_ftruncate (fd, static_cast<off_t> (size)) != 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingWriter::create] Could not allocate %llu bytes for %s: %s\n",
+               static_cast<unsigned long long> (size), name.c_str (), strerror (errno));
+    pcl_close (fd);
+    shm_unlink (name.c_str ());
+    return (false);
+  }
+  char *map = static_cast<char*> (mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  pcl_close (fd);
+  if (map == reinterpret_cast<char*> (-1))    // MAP_FAILED
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingWriter::create] Error mapping shared memory object %s: %s\n", name.c_str (), strerror (errno));
+    shm_unlink (name.c_str ());
+    return (false);
+  }
+  if (!ringWord64 (map, 16).is_lock_free () || !ringWord32 (map, 24).is_lock_free ())
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingWriter::create] Shared memory rings need lock-free 64-bit atomics!\n");
+    munmap (map, size);
+    shm_unlink (name.c_str ());
+    return (false);
+  }
+
+  // The new object is zero filled: no image published, every slot empty.
+  // The signature goes last, so readers never attach to a half written ring.
+  memcpy (&map[8],  &nr_slots,  sizeof (uint32_t));
+  memcpy (&map[12], &slot_size, sizeof (uint32_t));
+  std::atomic_thread_fence (std::memory_order_release);
+  char signature[8] = {'P', 'C', 'L', 'Z', 'M', LZF_RING_VERSION, 0, 0};
+  memcpy (&map[0], signature, sizeof (signature));
+
+  map_ = map;
+  map_size_ = size;
+  name_ = name;
+  nr_slots_ = nr_slots;
+  slot_size_ = slot_size;
+  sequence_ = 0;
+  return (true);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingWriter::append (const char *blob, uint32_t blob_size, uint64_t timestamp)
+{
+  if (!isOpen ())
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingWriter::append] No ring open for writing!\n");
+    return (false);
+  }
+  if (blob_size > slot_size_)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingWriter::append] A %u byte image does not fit the %u byte slots of %s!\n", blob_size, slot_size_, name_.c_str ());
+    return (false);
+  }
+
+  // Odd while the slot is being written, so that readers notice torn images
+  char *slot = ringSlot (map_, nr_slots_, slot_size_, sequence_);
+  std::atomic<uint64_t> &slot_sequence = ringWord64 (slot, 0);
+  slot_sequence.store (2 * sequence_ + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence (std::memory_order_release);
+  memcpy (&slot[8],  &timestamp, sizeof (uint64_t));
+  memcpy (&slot[16], &blob_size, sizeof (uint32_t));
+  memcpy (&slot[LZF_RING_SLOT_HEADER_SIZE], blob, blob_size);
+  slot_sequence.store (2 * sequence_ + 2, std::memory_order_release);
+
+  ++sequence_;
+  ringWord64 (map_, 16).store (sequence_, std::memory_order_release);
+  wakeRingReaders (map_);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFSharedRingWriter::close ()
+{
+  if (!isOpen ())
+    return;
+
+#ifndef _WIN32
+  ringWord32 (map_, 32).store (1, std::memory_order_release);
+  wakeRingReaders (map_);
+  munmap (map_, map_size_);
+  shm_unlink (name_.c_str ());
+#endif
+  map_ = NULL;
+  map_size_ = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFSharedRingReader::LZFSharedRingReader ()
+  : map_ (NULL)
+  , map_size_ (0)
+  , nr_slots_ (0)
+  , slot_size_ (0)
+  , next_sequence_ (0)
+  , sequence_ (0)
+  , decoded_sequence_ (0)
+  , overruns_ (0)
+  , skip_to_latest_ (false)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFSharedRingReader::~LZFSharedRingReader ()
+{
+  if (isOpen ())
+    close ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingReader::open (const std::string &name)
+{
+  if (isOpen ())
+    close ();
+
+#ifdef _WIN32
+  PCL_ERROR ("[pcl::io::LZFSharedRingReader::open] Shared memory rings are not supported on this platform (%s)!\n", name.c_str ());
+  return (false);
+#else
+  int fd = shm_open (name.c_str (), O_RDWR, 0);
+  if (fd < 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingReader::open] Failure to open shared memory object %s: %s\n", name.c_str (), strerror (errno));
+    return (false);
+  }
+  struct stat st;
+  if (fstat (fd, &st) != 0 || st.st_size < LZF_RING_HEADER_SIZE)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingReader::open] %s is not a PCLZM ring!\n", name.c_str ());
+    pcl_close (fd);
+    return (false);
+  }
+  uint64_t size = static_cast<uint64_t> (st.st_size);
+  char *map = static_cast<char*> (mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  pcl_close (fd);
+  if (map == reinterpret_cast<char*> (-1))    // MAP_FAILED
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingReader::open] Error mapping shared memory object %s: %s\n", name.c_str (), strerror (errno));
+    return (false);
+  }
+
+  uint32_t nr_slots, slot_size;
+  memcpy (&nr_slots,  &map[8],  sizeof (uint32_t));
+  memcpy (&slot_size, &map[12], sizeof (uint32_t));
+  if (memcmp (map, "PCLZM", 5) != 0 || map[5] != LZF_RING_VERSION)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingReader::open] %s is not a version %d PCLZM ring (or is still being created)!\n", name.c_str (), LZF_RING_VERSION);
+    munmap (map, size);
+    return (false);
+  }
+  std::atomic_thread_fence (std::memory_order_acquire);
+  if (nr_slots < 2 || LZF_RING_HEADER_SIZE + nr_slots * ringSlotStride (slot_size) != size)
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingReader::open] Corrupted ring %s (%u slots of %u bytes in %llu bytes)!\n",
+               name.c_str (), nr_slots, slot_size, static_cast<unsigned long long> (size));
+    munmap (map, size);
+    return (false);
+  }
+
+  map_ = map;
+  map_size_ = size;
+  nr_slots_ = nr_slots;
+  slot_size_ = slot_size;
+  next_sequence_ = ringWord64 (map_, 16).load (std::memory_order_acquire);
+  sequence_ = 0;
+  decoded_sequence_ = 0;
+  overruns_ = 0;
+  return (true);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFSharedRingReader::close ()
+{
+  if (!isOpen ())
+    return;
+#ifndef _WIN32
+  munmap (map_, map_size_);
+#endif
+  map_ = NULL;
+  map_size_ = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingReader::isWriterClosed () const
+{
+  return (!isOpen () || ringWord32 (map_, 32).load (std::memory_order_acquire) != 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingReader::waitForFrame (uint64_t sequence, std::chrono::steady_clock::time_point deadline)
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now ();
+  if (now >= deadline)
+    return (false);
+#if defined(__linux__)
+  // Sample the wake up counter before the last check, so that no wake up is missed
+  uint32_t counter = ringWord32 (map_, 24).load ();
+  if (ringWord64 (map_, 16).load () > sequence || isWriterClosed ())
+    return (true);
+  uint64_t timeout_ns = std::chrono::duration_cast<std::chrono::nanoseconds> (deadline - now).count ();
+  struct timespec timeout;
+  timeout.tv_sec = static_cast<time_t> (timeout_ns / 1000000000ull);
+  timeout.tv_nsec = static_cast<long> (timeout_ns % 1000000000ull);
+  ringWord32 (map_, 28).fetch_add (1);
+  syscall (SYS_futex, reinterpret_cast<uint32_t*> (&map_[24]), FUTEX_WAIT, counter, &timeout, NULL, 0);
+  ringWord32 (map_, 28).fetch_sub (1);
+#else
+  (void) sequence;
+  std::this_thread::sleep_for (std::chrono::microseconds (100));
+#endif
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingReader::consume (const BlobCallback &callback, unsigned int timeout_ms)
+{
+  if (!isOpen ())
+  {
+    PCL_ERROR ("[pcl::io::LZFSharedRingReader::consume] No ring open for reading!\n");
+    return (false);
+  }
+
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now () +
+                                                   std::chrono::milliseconds (timeout_ms);
+  for (;;)
+  {
+    uint64_t published = ringWord64 (map_, 16).load (std::memory_order_acquire);
+    if (skip_to_latest_ && published > next_sequence_ + 1)
+      next_sequence_ = published - 1;
+    if (next_sequence_ >= published)
+    {
+      if (isWriterClosed () || !waitForFrame (next_sequence_, deadline))
+        return (false);
+      continue;
+    }
+
+    // The slot of the oldest image may be being overwritten already
+    if (published - next_sequence_ >= nr_slots_)
+    {
+      overruns_ += published - next_sequence_ - (nr_slots_ - 1);
+      next_sequence_ = published - (nr_slots_ - 1);
+    }
+
+    uint64_t sequence = next_sequence_++;
+    char *slot = ringSlot (map_, nr_slots_, slot_size_, sequence);
+    std::atomic<uint64_t> &slot_sequence = ringWord64 (slot, 0);
+    uint64_t expected = 2 * sequence + 2;
+    if (slot_sequence.load (std::memory_order_acquire) != expected)
+    {
+      ++overruns_;
+      continue;
+    }
+
+    uint64_t timestamp;
+    uint32_t blob_size;
+    memcpy (&timestamp, &slot[8],  sizeof (uint64_t));
+    memcpy (&blob_size, &slot[16], sizeof (uint32_t));
+    sequence_ = sequence;
+    bool res = blob_size <= slot_size_ && callback (&slot[LZF_RING_SLOT_HEADER_SIZE], blob_size, timestamp);
+
+    // Whatever the callback made of an image overwritten in the meantime is garbage
+    std::atomic_thread_fence (std::memory_order_acquire);
+    if (slot_sequence.load (std::memory_order_relaxed) != expected)
+    {
+      ++overruns_;
+      continue;
+    }
+    return (res);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingReader::read (LZFImageReader &reader, std::vector<char> &output,
+                                    uint64_t &timestamp, unsigned int timeout_ms)
+{
+  for (;;)
+  {
+    bool skipped = false;
+    bool res = consume ([&] (const char *blob, uint32_t blob_size, uint64_t frame_timestamp) -> bool
+    {
+      // A temporal image needs the image before it, decoded by the same reader
+      skipped = isTemporalBlob (blob, blob_size) && (decoded_sequence_ == 0 || decoded_sequence_ != sequence_);
+      if (skipped)
+        return (false);
+      timestamp = frame_timestamp;
+      return (reader.read (blob, blob_size, output));
+    }, timeout_ms);
+
+    if (res)
+      decoded_sequence_ = sequence_ + 1;
+    if (!skipped)
+      return (res);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSharedRingReader::readBlob (std::vector<char> &blob, uint64_t &timestamp, unsigned int timeout_ms)
+{
+  return (consume ([&] (const char *frame_blob, uint32_t blob_size, uint64_t frame_timestamp) -> bool
+  {
+    blob.assign (frame_blob, frame_blob + blob_size);
+    timestamp = frame_timestamp;
+    return (true);
+  }, timeout_ms));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFImageReader::LZFImageReader ()
+  : width_ ()
+  , height_ ()
+  , image_type_identifier_ ()
+  , parameters_ ()
+  , uncompressed_buffer_ ()
+  , nr_threads_ (0)
+  , band_size_ (0)
+  , band_table_ ()
+  , band_offsets_ ()
+  , filter_buffer_ ()
+  , statistics_ (NULL)
+  , codec_ (ImageCodec::get (ImageCodec::LZF))
+  , levels_ ()
+  , quantization_step_ (0)
+  , quantization_max_depth_ (0)
+  , reference_hash_ (0)
+  , has_reference_hash_ (false)
+  , reference_ ()
+  , reference_stream_ (NULL)
+  , reference_index_ (0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::loadImageBlob (const std::string &filename,
+                                        std::vector<char> &data,
+                                        uint32_t &uncompressed_size)
+{
+  if (filename == "" || !boost::filesystem::exists (filename))
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Could not find file '%s'.\n", filename.c_str ());
+    return (false);
+  }
+
+  StageTimer timer (statistics_, LZFIOStatistics::READ_IO);
+  uint64_t data_size = 0;
+  char *map = mapFile (filename, data_size);
+  if (map == NULL)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Error mapping PCLZF file %s: %s\n", filename.c_str (), strerror (errno));
+    return (false);
+  }
+
+  bool res = loadImageBlob (map, data_size, data, uncompressed_size);
+  unmapFile (map, data_size);
+  return (res);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::readHeader (const char *blob, size_t blob_size,
+                                     const char* &payload,
+                                     uint32_t &compressed_size,
+                                     uint32_t &uncompressed_size)
+{
+  size_t header_size = LZF_HEADER_SIZE;
+  // Check the header identifier here
+  bool extended = blob_size >= LZF_EXT_HEADER_SIZE && memcmp (&blob[0], "PCLZX", 5) == 0;
+  if (!extended && (blob_size < header_size || memcmp (&blob[0], "PCLZF", 5) != 0))
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Wrong signature header! Should be 'P'C'L'Z'F'.\n");
+    return (false);
+  }
+  memcpy (&width_,            &blob[5], sizeof (uint32_t));
+  memcpy (&height_,           &blob[9], sizeof (uint32_t));
+  char imgtype_string[16];
+  memcpy (&imgtype_string,    &blob[13], 16);       // BAYER8, RGB24_, YUV422_, ...
+  image_type_identifier_ = std::string (imgtype_string, 16).substr (0, 15);
+  image_type_identifier_.insert (image_type_identifier_.end (), 1, '\0');
+
+  memcpy (&compressed_size,   &blob[29], sizeof (uint32_t));
+  memcpy (&uncompressed_size, &blob[33], sizeof (uint32_t));
+
+  band_size_ = 0;
+  band_table_.clear ();
+  levels_.clear ();
+  quantization_step_ = 0;
+  quantization_max_depth_ = 0;
+  has_reference_hash_ = false;
+  codec_ = ImageCodec::get (ImageCodec::LZF);
+  if (extended)
+  {
+    if (blob[37] < LZF_EXT_HEADER_VERSION_LZF_ONLY || blob[37] > LZF_EXT_HEADER_VERSION)
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Unsupported PCLZX header version %d!\n", blob[37]);
+      return (false);
+    }
+    int codec_id = blob[37] < LZF_EXT_HEADER_VERSION_CODEC ? static_cast<int> (ImageCodec::LZF) : static_cast<unsigned char> (blob[39]);
+    codec_ = ImageCodec::get (static_cast<ImageCodec::Id> (codec_id));
+    if (codec_ == NULL)
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Image compressed with codec %d, which is not available in this build!\n", codec_id);
+      return (false);
+    }
+    uint32_t nr_bands;
+    memcpy (&band_size_, &blob[41], sizeof (uint32_t));
+    memcpy (&nr_bands,   &blob[45], sizeof (uint32_t));
+    header_size = LZF_EXT_HEADER_SIZE + size_t (nr_bands) * LZF_EXT_BAND_ENTRY_SIZE;
+    if (band_size_ == 0 || nr_bands != (uint64_t (uncompressed_size) + band_size_ - 1) / band_size_ || header_size > blob_size)
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Corrupted band table (%u bands of %u bytes for %u bytes of data)!\n", nr_bands, band_size_, uncompressed_size);
+      return (false);
+    }
+    band_table_.resize (nr_bands);
+    uint64_t total_size = 0;
+    for (uint32_t b = 0; b < nr_bands; ++b)
+    {
+      memcpy (&band_table_[b], &blob[LZF_EXT_HEADER_SIZE + b * LZF_EXT_BAND_ENTRY_SIZE], sizeof (uint32_t));
+      total_size += band_table_[b];
+    }
+    if (total_size != compressed_size)
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Band sizes (%llu bytes) do not add up to the compressed size (%u)!\n", static_cast<unsigned long long> (total_size), compressed_size);
+      return (false);
+    }
+
+    if (blob[37] >= LZF_EXT_HEADER_VERSION_QUANTIZED && (blob[38] & LZF_EXT_FLAG_QUANTIZED))
+    {
+      if (header_size + LZF_EXT_QUANT_ENTRY_SIZE > blob_size)
+      {
+        PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Truncated quantization entry!\n");
+        return (false);
+      }
+      memcpy (&quantization_step_,      &blob[header_size],     sizeof (uint32_t));
+      memcpy (&quantization_max_depth_, &blob[header_size + 4], sizeof (uint32_t));
+      header_size += LZF_EXT_QUANT_ENTRY_SIZE;
+      if (quantization_step_ == 0 || quantization_max_depth_ >= 65535 || quantization_max_depth_ / quantization_step_ > 65533)
+      {
+        PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Corrupted quantization entry (bins of %u up to %u)!\n", quantization_step_, quantization_max_depth_);
+        quantization_step_ = quantization_max_depth_ = 0;
+        return (false);
+      }
+    }
+
+    if (blob[37] >= LZF_EXT_HEADER_VERSION && (blob[38] & LZF_EXT_FLAG_REFERENCE))
+    {
+      if (header_size + LZF_EXT_REF_ENTRY_SIZE > blob_size)
+      {
+        PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Truncated reference entry!\n");
+        return (false);
+      }
+      memcpy (&reference_hash_, &blob[header_size], sizeof (uint64_t));
+      has_reference_hash_ = true;
+      header_size += LZF_EXT_REF_ENTRY_SIZE;
+    }
+
+    if (blob[37] >= LZF_EXT_HEADER_VERSION_PYRAMID && (blob[38] & LZF_EXT_FLAG_PYRAMID))
+    {
+      size_t nr_levels = static_cast<unsigned char> (blob[40]);
+      const char *level_table = &blob[header_size];
+      header_size += nr_levels * LZF_EXT_LEVEL_ENTRY_SIZE;
+      if (header_size > blob_size)
+      {
+        PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Truncated pyramid level table!\n");
+        return (false);
+      }
+      levels_.resize (nr_levels);
+      for (size_t l = 0; l < nr_levels; ++l)
+      {
+        Level &level = levels_[l];
+        const char *entry = &level_table[l * LZF_EXT_LEVEL_ENTRY_SIZE];
+        memcpy (&level.width,             &entry[0],  sizeof (uint32_t));
+        memcpy (&level.height,            &entry[4],  sizeof (uint32_t));
+        memcpy (&level.scale,             &entry[8],  sizeof (uint32_t));
+        memcpy (&level.compressed_size,   &entry[12], sizeof (uint32_t));
+        memcpy (&level.uncompressed_size, &entry[16], sizeof (uint32_t));
+        level.offset = static_cast<uint32_t> (header_size);
+        header_size += level.compressed_size;
+        if (header_size > blob_size || level.compressed_size > level.uncompressed_size)
+        {
+          PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Corrupted pyramid level %zu!\n", l + 1);
+          levels_.clear ();
+          return (false);
+        }
+      }
+    }
+  }
+
+  if (compressed_size + header_size != blob_size)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Number of bytes to decompress written in file (%u) differs from what it should be (%u)!\n", compressed_size, uint32_t (blob_size - header_size));
+    return (false);
+  }
+
+  payload = &blob[header_size];
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::loadImageBlob (const char *blob, size_t blob_size,
+                                        std::vector<char> &data,
+                                        uint32_t &uncompressed_size)
+{
+  const char *payload;
+  uint32_t compressed_size;
+  if (!readHeader (blob, blob_size, payload, compressed_size, uncompressed_size))
+    return (false);
+
+  data.resize (compressed_size);
+  memcpy (&data[0], payload, compressed_size);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::decompress (const char *input, uint32_t input_size,
+                                     char *output, uint32_t output_size)
+{
+  if (output == NULL || output_size == 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::decompress] Output array needs to be preallocated! The correct uncompressed array value should have been stored during the compression.\n");
+    return (false);
+  }
+  // Filtered images are decompressed into a scratch buffer and unfiltered into the output
+  bool temporal = hasImageType (image_type_identifier_, "depth16t");
+  bool quantized = hasImageType (image_type_identifier_, "depth16q");
+  if (temporal || quantized || hasImageType (image_type_identifier_, "depth16d"))
+  {
+    if (output_size != size_t (width_) * height_ * 2)
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::decompress] A %ux%u %s image does not fit %u bytes!\n", width_, height_, temporal ? "depth16t" : quantized ? "depth16q" : "depth16d", output_size);
+      return (false);
+    }
+    if (temporal && (reference_.size () != output_size ||
+                     (has_reference_hash_ && hashImage (&reference_[0], output_size) != reference_hash_)))
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::decompress] A depth16t image can only be read after the image before it!\n");
+      return (false);
+    }
+    if (quantized && quantization_step_ == 0)
+    {
+      PCL_ERROR ("[pcl::io::LZFImageReader::decompress] A depth16q image without bin size cannot be reconstructed!\n");
+      return (false);
+    }
+    char *planes = growBuffer (filter_buffer_, output_size);
+    if (!decompressData (input, input_size, planes, output_size))
+    {
+      reference_.clear ();
+      return (false);
+    }
+    StageTimer timer (statistics_, LZFIOStatistics::READ_UNSHUFFLE);
+    if (temporal)
+      decodeDepth16Temporal (planes, &reference_[0], size_t (width_) * height_, output);
+    else if (quantized)
+      dequantizeDepth16 (planes, size_t (width_) * height_, static_cast<uint16_t> (quantization_step_),
+                         static_cast<uint16_t> (quantization_max_depth_), output);
+    else
+      decodeDepth16Delta (planes, width_, height_, output);
+    // Keyframes and temporal images are the reference of the next temporal image
+    reference_.assign (output, output + output_size);
+    reference_stream_ = NULL;
+    return (true);
+  }
+  return (decompressData (input, input_size, output, output_size));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::decompressData (const char *input, uint32_t input_size,
+                                         char *output, uint32_t output_size)
+{
+  StageTimer timer (statistics_, LZFIOStatistics::READ_DECOMPRESS);
+  if (!band_table_.empty ())
+  {
+    if (!decompressBands (input, input_size, output, output_size))
+      return (false);
+  }
+  else
+  {
+    unsigned int tmp_size = lzfDecompressData (input, input_size, output, output_size);
+
+    if (tmp_size != output_size)
+    {
+      PCL_WARN ("[pcl::io::LZFImageReader::decompress] Size of decompressed lzf data (%u) does not match the uncompressed size value (%u). Errno: %d\n", tmp_size, output_size, errno);
+      return (false);
+    }
+  }
+  if (statistics_)
+    statistics_->addImage (false, output_size, input_size);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::computeBandOffsets (uint32_t input_size, uint32_t output_size)
+{
+  int nr_bands = static_cast<int> (band_table_.size ());
+  if (uint64_t (band_size_) * (nr_bands - 1) >= output_size || uint64_t (band_size_) * nr_bands < output_size)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::decompress] %d bands of %u bytes cannot hold %u bytes of data!\n", nr_bands, band_size_, output_size);
+    return (false);
+  }
+
+  // Turn the band sizes into offsets
+  band_offsets_.resize (nr_bands);
+  uint64_t offset = 0;
+  for (int b = 0; b < nr_bands; ++b)
+  {
+    band_offsets_[b] = static_cast<uint32_t> (offset);
+    offset += band_table_[b];
+  }
+  if (offset != input_size)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::decompress] Band sizes (%llu bytes) do not match the input size (%u)!\n", static_cast<unsigned long long> (offset), input_size);
+    return (false);
+  }
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::decompressBands (const char *input, uint32_t input_size,
+                                          char *output, uint32_t output_size)
+{
+  if (!computeBandOffsets (input_size, output_size))
+    return (false);
+
+  int nr_bands = static_cast<int> (band_table_.size ());
+  int failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads (getNumberOfThreads (nr_threads_)) schedule (dynamic) reduction (+:failed)
+#endif
+  for (int b = 0; b < nr_bands; ++b)
+  {
+    uint32_t out_offset = uint32_t (b) * band_size_;
+    uint32_t length = std::min (band_size_, output_size - out_offset);
+    // Bands that did not compress are stored as is
+    if (band_table_[b] == length)
+      memcpy (&output[out_offset], &input[band_offsets_[b]], length);
+    else if (band_table_[b] > length ||
+             codec_->decompress (&input[band_offsets_[b]], band_table_[b], &output[out_offset], length) != length)
+      ++failed;
+  }
+
+  if (failed > 0)
+  {
+    PCL_WARN ("[pcl::io::LZFImageReader::decompress] Failed to decompress %d out of %d bands. Errno: %d\n", failed, nr_bands, errno);
+    return (false);
+  }
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::decompress (const std::vector<char> &input,
+                                     std::vector<char> &output)
+{
+  if (output.empty ())
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::decompress] Output array needs to be preallocated! The correct uncompressed array value should have been stored during the compression.\n");
+    return (false);
+  }
+  return (decompress (&input[0], uint32_t (input.size ()), &output[0], uint32_t (output.size ())));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::read (const char *blob, size_t blob_size,
+                               char *output, uint32_t output_size)
+{
+  const char *payload;
+  uint32_t compressed_size, uncompressed_size;
+  if (!readHeader (blob, blob_size, payload, compressed_size, uncompressed_size))
+    return (false);
+
+  if (uncompressed_size != output_size)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::read] Output buffer has %u bytes, but the image needs %u!\n", output_size, uncompressed_size);
+    return (false);
+  }
+  return (decompress (payload, compressed_size, output, output_size));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::read (const char *blob, size_t blob_size,
+                               std::vector<char> &output)
+{
+  const char *payload;
+  uint32_t compressed_size, uncompressed_size;
+  if (!readHeader (blob, blob_size, payload, compressed_size, uncompressed_size))
+    return (false);
+
+  if (uncompressed_size == 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::read] Empty image!\n");
+    return (false);
+  }
+  output.resize (uncompressed_size);
+  return (decompress (payload, compressed_size, &output[0], uncompressed_size));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::read (const std::string &filename,
+                               std::vector<char> &output)
+{
+  if (filename == "" || !boost::filesystem::exists (filename))
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::read] Could not find file '%s'.\n", filename.c_str ());
+    return (false);
+  }
+
+  uint64_t data_size = 0;
+  char *map;
+  {
+    StageTimer timer (statistics_, LZFIOStatistics::READ_IO);
+    map = mapFile (filename, data_size);
+  }
+  if (map == NULL)
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::read] Error mapping PCLZF file %s: %s\n", filename.c_str (), strerror (errno));
+    return (false);
+  }
+
+  bool res = read (map, data_size, output);
+  unmapFile (map, data_size);
+  return (res);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::read (const LZFStreamReader &stream, size_t index,
+                               std::vector<char> &output)
+{
+  const char *blob;
+  uint32_t blob_size;
+  if (!stream.getFrame (index, blob, blob_size))
+    return (false);
+
+  // A temporal image needs the image before it: decode from the last keyframe, unless it was just read
+  if (isTemporalBlob (blob, blob_size) && (reference_stream_ != &stream || reference_index_ + 1 != index))
+  {
+    size_t keyframe = index;
+    const char *ref_blob = blob;
+    uint32_t ref_blob_size = blob_size;
+    while (keyframe > 0 && isTemporalBlob (ref_blob, ref_blob_size))
+      if (!stream.getFrame (--keyframe, ref_blob, ref_blob_size))
+        return (false);
+    for (size_t i = keyframe; i < index; ++i)
+    {
+      if (!stream.getFrame (i, ref_blob, ref_blob_size) || !read (ref_blob, ref_blob_size, output))
+      {
+        PCL_ERROR ("[pcl::io::LZFImageReader::read] Unable to read reference frame %zu of frame %zu.\n", i, index);
+        return (false);
+      }
+    }
+  }
+
+  if (!read (blob, blob_size, output))
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::read] Unable to read image data from frame %zu.\n", index);
+    return (false);
+  }
+  reference_stream_ = &stream;
+  reference_index_ = index;
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFImageReader::readLevel (const char *blob, size_t blob_size, unsigned int level,
+                                    std::vector<char> &output, uint32_t &width, uint32_t &height)
+{
+  if (level == 0)
+  {
+    if (!read (blob, blob_size, output))
+      return (false);
+    width = width_;
+    height = height_;
+    return (true);
+  }
+
+  const char *payload;
+  uint32_t compressed_size, uncompressed_size;
+  if (!readHeader (blob, blob_size, payload, compressed_size, uncompressed_size))
+    return (false);
+  if (level > levels_.size ())
+  {
+    PCL_ERROR ("[pcl::io::LZFImageReader::readLevel] Level %u requested, but the image has %zu pyramid levels!\n", level, levels_.size ());
+    return (false);
+  }
+
+  StageTimer timer (statistics_, LZFIOStatistics::READ_DECOMPRESS);
+  const Level &l = levels_[level - 1];
+  output.resize (l.uncompressed_size);
+  if (l.uncompressed_size == 0)
+    return (false);
+  // Levels that did not compress are stored as is
+  if (l.compressed_size == l.uncompressed_size)
+    memcpy (&output[0], &blob[l.offset], l.uncompressed_size);
+  else if (codec_->decompress (&blob[l.offset], l.compressed_size, &output[0], l.uncompressed_size) != l.uncompressed_size)
+  {
+    PCL_WARN ("[pcl::io::LZFImageReader::readLevel] Failed to decompress pyramid level %u. Errno: %d\n", level, errno);
+    return (false);
+  }
+  width = l.width;
+  height = l.height;
+  return (true);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFImageWriter::saveImageBlob (const char* data, 
-                                        size_t data_size, 
-                                        const std::string &filename)
+pcl::io::LZFImageReader::readParameters (const std::string &filename)
 {
-#ifdef _WIN32
-  HANDLE h_native_file = CreateFile (filename.c_str (), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-  if (h_native_file == INVALID_HANDLE_VALUE)
+  ParametersCache::ParameterMapConstPtr values = getParametersCache ().get (filename);
+  if (!values)
     return (false);
-  HANDLE fm = CreateFileMapping (h_native_file, NULL, PAGE_READWRITE, 0, data_size, NULL);
-  char *map = static_cast<char*> (MapViewOfFile (fm, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, data_size));
-  CloseHandle (fm);
-  memcpy (&map[0], data, data_size);
-  UnmapViewOfFile (map);
-  CloseHandle (h_native_file);
+  return (readParameters (*values));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFImageReader::clearParametersCache ()
+{
+  getParametersCache ().clear ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFRGB24ImageReader::readParameters (std::istream& is)
+{
+  ParameterMap values;
+  if (!parseParameters (is, values))
+    return (false);
+  return (readParameters (values));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFRGB24ImageReader::readParameters (const ParameterMap &values)
+{
+  CameraParameters parameters;
+  if (!getParameter (values, "rgb.focal_length_x", parameters.focal_length_x) ||
+      !getParameter (values, "rgb.focal_length_y", parameters.focal_length_y) ||
+      !getParameter (values, "rgb.principal_point_x", parameters.principal_point_x) ||
+      !getParameter (values, "rgb.principal_point_y", parameters.principal_point_y))
+    return (false);
+
+  parameters_ = parameters;
+  PCL_DEBUG ("[pcl::io::LZFRGB24ImageReader::readParameters] Read camera parameters (fx,fy,cx,cy): %g,%g,%g,%g.\n", 
+      parameters_.focal_length_x, parameters_.focal_length_y, 
+      parameters_.principal_point_x, parameters_.principal_point_y);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFRGB24ImageReader::readInterleaved (const char *blob, size_t blob_size,
+                                               std::vector<char> &output)
+{
+  if (!read (blob, blob_size, uncompressed_buffer_))
+    return (false);
+
+  StageTimer timer (statistics_, LZFIOStatistics::READ_UNSHUFFLE);
+  size_t nr_pixels = size_t (getWidth ()) * getHeight ();
+  if (getImageType ().compare (0, 5, "rgb24") == 0 && uncompressed_buffer_.size () == nr_pixels * 3)
+  {
+    output.resize (nr_pixels * 3);
+    interleaveRGB24 (&uncompressed_buffer_[0], nr_pixels, &output[0]);
+  }
+  else if (getImageType ().compare (0, 6, "yuv422") == 0 && uncompressed_buffer_.size () == nr_pixels * 2)
+  {
+    output.resize (nr_pixels * 2);
+    interleaveYUV422 (&uncompressed_buffer_[0], nr_pixels, &output[0]);
+  }
+  else
+    output.assign (uncompressed_buffer_.begin (), uncompressed_buffer_.end ());
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageReader::read (const char *blob, size_t blob_size,
+                                      pcl::PointCloud<pcl::PointXYZ> &cloud,
+                                      float min_depth, float max_depth,
+                                      unsigned int stride)
+{
+  const char *payload;
+  uint32_t compressed_size, uncompressed_size;
+  if (!readHeader (blob, blob_size, payload, compressed_size, uncompressed_size))
+    return (false);
+  uint32_t row_size = width_ * 2;
+  if (uncompressed_size != uint64_t (row_size) * height_)
+  {
+    PCL_DEBUG ("[pcl::io::LZFDepth16ImageReader::read] Uncompressed data has wrong size (%u), while in fact it should be %u bytes. Identifier says: %s\n", uncompressed_size, row_size * height_, getImageType ().c_str ());
+    return (false);
+  }
+
+  stride = std::max (stride, 1u);
+  cloud.width    = (width_ + stride - 1) / stride;
+  cloud.height   = (height_ + stride - 1) / stride;
+  cloud.resize (size_t (cloud.width) * cloud.height);
+  cloud.sensor_origin_.setZero ();
+  cloud.sensor_orientation_.w () = 1.0f;
+  cloud.sensor_orientation_.x () = 0.0f;
+  cloud.sensor_orientation_.y () = 0.0f;
+  cloud.sensor_orientation_.z () = 0.0f;
+
+  x_factors_.resize (cloud.width);
+  for (uint32_t i = 0; i < cloud.width; ++i)
+    x_factors_[i] = static_cast<float> ((double (i * stride) - parameters_.principal_point_x) / parameters_.focal_length_x);
+  const float z_factor = static_cast<float> (z_multiplication_factor_);
+  const double constant_y = 1.0 / parameters_.focal_length_y;
+  static const ProjectKernel project = getProjectKernel ();
+
+  // Project the kept rows among [first_row, first_row + nr_rows), read from depth
+  int nr_invalid = 0;
+  auto projectRows = [&] (const char *depth, uint32_t first_row, uint32_t nr_rows) -> size_t
+  {
+    size_t invalid = 0;
+    for (uint32_t v = (first_row + stride - 1) / stride * stride; v < first_row + nr_rows; v += stride)
+    {
+      float y_factor = static_cast<float> ((v - parameters_.principal_point_y) * constant_y);
+      invalid += project (&depth[size_t (v - first_row) * row_size], cloud.width, stride,
+                          &x_factors_[0], y_factor, z_factor, min_depth, max_depth,
+                          &cloud.points[size_t (v / stride) * cloud.width]);
+    }
+    return (invalid);
+  };
+
+  // Row aligned bands of a plain depth image are decompressed and projected
+  // one at a time, while they are still in cache
+  if (!band_table_.empty () && band_size_ % row_size == 0 && hasImageType (image_type_identifier_, "depth16"))
+  {
+    StageTimer timer (statistics_, LZFIOStatistics::READ_DECOMPRESS);
+    if (!computeBandOffsets (compressed_size, uncompressed_size))
+      return (false);
+
+    int nr_bands = static_cast<int> (band_table_.size ());
+    int nr_threads = std::min (getNumberOfThreads (nr_threads_), nr_bands);
+    char *scratch = growBuffer (uncompressed_buffer_, size_t (band_size_) * nr_threads);
+    int failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads (nr_threads) schedule (dynamic) reduction (+:failed, nr_invalid)
+#endif
+    for (int b = 0; b < nr_bands; ++b)
+    {
+#ifdef _OPENMP
+      char *band = &scratch[size_t (band_size_) * omp_get_thread_num ()];
 #else
-  int fd = pcl_open (filename.c_str (), O_RDWR | O_CREAT | O_TRUNC, static_cast<mode_t> (0600));
-  if (fd < 0)
+      char *band = scratch;
+#endif
+      uint32_t offset = uint32_t (b) * band_size_;
+      uint32_t length = std::min (band_size_, uncompressed_size - offset);
+      const char *depth = band;
+      // Bands that did not compress are projected straight from the input
+      if (band_table_[b] == length)
+        depth = &payload[band_offsets_[b]];
+      else if (band_table_[b] > length ||
+               codec_->decompress (&payload[band_offsets_[b]], band_table_[b], band, length) != length)
+      {
+        ++failed;
+        continue;
+      }
+      nr_invalid += static_cast<int> (projectRows (depth, offset / row_size, length / row_size));
+    }
+
+    if (failed > 0)
+    {
+      PCL_WARN ("[pcl::io::LZFDepth16ImageReader::read] Failed to decompress %d out of %d bands. Errno: %d\n", failed, nr_bands, errno);
+      return (false);
+    }
+    if (statistics_)
+      statistics_->addImage (false, uncompressed_size, compressed_size);
+  }
+  else
+  {
+    char *depth = growBuffer (uncompressed_buffer_, uncompressed_size);
+    if (!decompress (payload, compressed_size, depth, uncompressed_size))
+    {
+      PCL_ERROR ("[pcl::io::LZFDepth16ImageReader::read] Unable to decompress depth image data!\n");
+      return (false);
+    }
+
+    StageTimer timer (statistics_, LZFIOStatistics::READ_UNSHUFFLE);
+    int nr_rows = static_cast<int> (cloud.height);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads (getNumberOfThreads (nr_threads_)) schedule (static) reduction (+:nr_invalid)
+#endif
+    for (int row = 0; row < nr_rows; ++row)
+      nr_invalid += static_cast<int> (projectRows (&depth[size_t (row) * stride * row_size], row * stride, 1));
+  }
+
+  cloud.is_dense = (nr_invalid == 0);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageReader::read (const std::string &filename,
+                                      pcl::PointCloud<pcl::PointXYZ> &cloud,
+                                      float min_depth, float max_depth,
+                                      unsigned int stride)
+{
+  if (filename == "" || !boost::filesystem::exists (filename))
+  {
+    PCL_ERROR ("[pcl::io::LZFDepth16ImageReader::read] Could not find file '%s'.\n", filename.c_str ());
     return (false);
-  // Stretch the file size to the size of the data
-  off_t result = pcl_lseek (fd, data_size - 1, SEEK_SET);
-  if (result < 0)
+  }
+
+  uint64_t data_size = 0;
+  char *map;
   {
-    pcl_close (fd);
+    StageTimer timer (statistics_, LZFIOStatistics::READ_IO);
+    map = mapFile (filename, data_size);
+  }
+  if (map == NULL)
+  {
+    PCL_ERROR ("[pcl::io::LZFDepth16ImageReader::read] Error mapping PCLZF file %s: %s\n", filename.c_str (), strerror (errno));
     return (false);
   }
-  // Write a bogus entry so that the new file size comes in effect
-  result = static_cast<int> (::write (fd, "", 1));
-  if (result != 1)
+
+  bool res = read (map, data_size, cloud, min_depth, max_depth, stride);
+  unmapFile (map, data_size);
+  return (res);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageReader::readLevel (const char *blob, size_t blob_size, unsigned int level,
+                                           pcl::PointCloud<pcl::PointXYZ> &cloud,
+                                           float min_depth, float max_depth)
+{
+  if (level == 0)
+    return (read (blob, blob_size, cloud, min_depth, max_depth));
+
+  uint32_t width, height;
+  if (!readLevel (blob, blob_size, level, uncompressed_buffer_, width, height))
+    return (false);
+  if (uncompressed_buffer_.size () != size_t (width) * height * 2)
   {
-    pcl_close (fd);
+    PCL_DEBUG ("[pcl::io::LZFDepth16ImageReader::readLevel] Level %u has wrong size (%zu), while in fact it should be %u bytes.\n", level, uncompressed_buffer_.size (), width * height * 2);
     return (false);
   }
 
-  char *map = static_cast<char*> (mmap (0, data_size, PROT_WRITE, MAP_SHARED, fd, 0));
-  if (map == reinterpret_cast<char*> (-1))    // MAP_FAILED
+  StageTimer timer (statistics_, LZFIOStatistics::READ_UNSHUFFLE);
+  cloud.width    = width;
+  cloud.height   = height;
+  cloud.resize (size_t (width) * height);
+  cloud.sensor_origin_.setZero ();
+  cloud.sensor_orientation_.w () = 1.0f;
+  cloud.sensor_orientation_.x () = 0.0f;
+  cloud.sensor_orientation_.y () = 0.0f;
+  cloud.sensor_orientation_.z () = 0.0f;
+
+  // Project through the center of the block of full resolution pixels
+  double scale = levels_[level - 1].scale, center = (scale - 1.0) * 0.5;
+  x_factors_.resize (width);
+  for (uint32_t u = 0; u < width; ++u)
+    x_factors_[u] = static_cast<float> ((u * scale + center - parameters_.principal_point_x) / parameters_.focal_length_x);
+  static const ProjectKernel project = getProjectKernel ();
+  size_t nr_invalid = 0;
+  for (uint32_t v = 0; v < height; ++v)
   {
-    pcl_close (fd);
+    float y_factor = static_cast<float> ((v * scale + center - parameters_.principal_point_y) / parameters_.focal_length_y);
+    nr_invalid += project (&uncompressed_buffer_[size_t (v) * width * 2], width, 1,
+                           &x_factors_[0], y_factor, static_cast<float> (z_multiplication_factor_),
+                           min_depth, max_depth, &cloud.points[size_t (v) * width]);
+  }
+  cloud.is_dense = (nr_invalid == 0);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageReader::readParameters (std::istream& is)
+{
+  ParameterMap values;
+  if (!parseParameters (is, values))
+    return (false);
+  return (readParameters (values));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFDepth16ImageReader::readParameters (const ParameterMap &values)
+{
+  CameraParameters parameters;
+  double z_multiplication_factor;
+  if (!getParameter (values, "depth.focal_length_x", parameters.focal_length_x) ||
+      !getParameter (values, "depth.focal_length_y", parameters.focal_length_y) ||
+      !getParameter (values, "depth.principal_point_x", parameters.principal_point_x) ||
+      !getParameter (values, "depth.principal_point_y", parameters.principal_point_y) ||
+      !getParameter (values, "depth.z_multiplication_factor", z_multiplication_factor))
+    return (false);
+
+  parameters_ = parameters;
+  z_multiplication_factor_ = z_multiplication_factor;
+  PCL_DEBUG ("[pcl::io::LZFDepth16ImageReader::readParameters] Read camera parameters (fx,fy,cx,cy): %g,%g,%g,%g.\n", 
+      parameters_.focal_length_x, parameters_.focal_length_y, 
+      parameters_.principal_point_x, parameters_.principal_point_y);
+  PCL_DEBUG ("[pcl::io::LZFDepth16ImageReader::readParameters] Multiplication factor: %g.\n", z_multiplication_factor_);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFStreamWriter::LZFStreamWriter ()
+  : fd_ (-1)
+  , filename_ ()
+  , offset_ (0)
+  , allocated_ (0)
+  , preallocation_size_ (0)
+  , index_ ()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFStreamWriter::~LZFStreamWriter ()
+{
+  if (isOpen ())
+    close ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFStreamWriter::open (const std::string &filename,
+                                uint64_t preallocation_size)
+{
+  if (isOpen ())
+    close ();
+
+#ifdef _WIN32
+  fd_ = pcl_open (filename.c_str (), _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  fd_ = pcl_open (filename.c_str (), O_RDWR | O_CREAT | O_TRUNC, static_cast<mode_t> (0600));
+#endif
+  if (fd_ < 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamWriter::open] Failure to open file %s\n", filename.c_str ());
+    fd_ = -1;
     return (false);
   }
+  filename_ = filename;
+  offset_ = 0;
+  allocated_ = 0;
+  preallocation_size_ = preallocation_size > 0 ? preallocation_size : 1;
+  index_.clear ();
 
-  // Copy the data
-  memcpy (&map[0], data, data_size);
+  char header[LZF_STREAM_HEADER_SIZE] = {'P', 'C', 'L', 'Z', 'S', LZF_STREAM_VERSION, 0, 0};
+  if (!reserve (LZF_STREAM_HEADER_SIZE) || !writeAll (fd_, header, LZF_STREAM_HEADER_SIZE))
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamWriter::open] Error writing the stream header to %s\n", filename.c_str ());
+    pcl_close (fd_);
+    fd_ = -1;
+    return (false);
+  }
+  offset_ = LZF_STREAM_HEADER_SIZE;
+  return (true);
+}
 
-  if (munmap (map, (data_size)) == -1)
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFStreamWriter::reserve (uint64_t size)
+{
+  if (size <= allocated_)
+    return (true);
+
+  uint64_t new_size = allocated_ + preallocation_size_;
+  while (new_size < size)
+    new_size += preallocation_size_;
+
+#ifndef _WIN32
+  int res = posix_fallocate (fd_, static_cast<off_t> (allocated_), static_cast<off_t> (new_size - allocated_));
+  if (res != 0)
   {
-    pcl_close (fd);
+    PCL_ERROR ("[pcl::io::LZFStreamWriter::reserve] Could not preallocate %llu bytes for %s: %s\n", 
+               static_cast<unsigned long long> (new_size), filename_.c_str (), strerror (res));
+    return (false);
+  }
+#endif
+  allocated_ = new_size;
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFStreamWriter::append (const char *blob, uint32_t blob_size, uint64_t timestamp)
+{
+  if (!isOpen ())
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamWriter::append] Stream is not open!\n");
+    return (false);
+  }
+
+  uint64_t record_size = LZF_STREAM_RECORD_HEADER_SIZE + blob_size;
+  if (!reserve (offset_ + record_size))
+    return (false);
+
+  char record_header[LZF_STREAM_RECORD_HEADER_SIZE];
+  memcpy (&record_header[0], &timestamp, sizeof (uint64_t));
+  memcpy (&record_header[8], &blob_size, sizeof (uint32_t));
+
+#ifdef _WIN32
+  bool res = writeAll (fd_, record_header, LZF_STREAM_RECORD_HEADER_SIZE) &&
+             writeAll (fd_, blob, blob_size);
+#else
+  // Record header and blob go out in a single system call
+  struct iovec iov[2];
+  iov[0].iov_base = record_header;
+  iov[0].iov_len  = LZF_STREAM_RECORD_HEADER_SIZE;
+  iov[1].iov_base = const_cast<char*> (blob);
+  iov[1].iov_len  = blob_size;
+  ssize_t written = writev (fd_, iov, 2);
+  while (written < 0 && errno == EINTR)
+    written = writev (fd_, iov, 2);
+  bool res = written >= 0;
+  if (res && static_cast<uint64_t> (written) < record_size)
+  {
+    // Finish a short write
+    if (written < LZF_STREAM_RECORD_HEADER_SIZE)
+      res = writeAll (fd_, &record_header[written], LZF_STREAM_RECORD_HEADER_SIZE - written) &&
+            writeAll (fd_, blob, blob_size);
+    else
+      res = writeAll (fd_, &blob[written - LZF_STREAM_RECORD_HEADER_SIZE], static_cast<size_t> (record_size - written));
+  }
+#endif
+  if (!res)
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamWriter::append] Error writing frame %zu to %s: %s\n", 
+               index_.size (), filename_.c_str (), strerror (errno));
+    return (false);
+  }
+
+  LZFStreamIndexEntry entry;
+  entry.offset = offset_;
+  entry.timestamp = timestamp;
+  entry.size = blob_size;
+  index_.push_back (entry);
+  offset_ += record_size;
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFStreamWriter::close ()
+{
+  if (!isOpen ())
+    return (false);
+
+  // Serialize the frame index and the footer
+  std::vector<char> index (index_.size () * LZF_STREAM_INDEX_ENTRY_SIZE + LZF_STREAM_FOOTER_SIZE);
+  char *ptr = &index[0];
+  for (size_t i = 0; i < index_.size (); ++i, ptr += LZF_STREAM_INDEX_ENTRY_SIZE)
+  {
+    memcpy (&ptr[0],  &index_[i].offset, sizeof (uint64_t));
+    memcpy (&ptr[8],  &index_[i].timestamp, sizeof (uint64_t));
+    memcpy (&ptr[16], &index_[i].size, sizeof (uint32_t));
+  }
+  uint32_t nr_frames = static_cast<uint32_t> (index_.size ());
+  memcpy (&ptr[0],  &offset_, sizeof (uint64_t));
+  memcpy (&ptr[8],  &nr_frames, sizeof (uint32_t));
+  memcpy (&ptr[12], "PZIX", 4);
+
+  bool res = writeAll (fd_, &index[0], index.size ());
+  if (!res)
+    PCL_ERROR ("[pcl::io::LZFStreamWriter::close] Error writing the frame index to %s\n", filename_.c_str ());
+
+  // Give back the preallocated space we did not use
+  if (pcl_ftruncate (fd_, static_cast<off_t> (offset_ + index.size ())) != 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamWriter::close] Error truncating %s\n", filename_.c_str ());
+    res = false;
+  }
+  pcl_close (fd_);
+  fd_ = -1;
+  index_.clear ();
+  return (res);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFStreamReader::LZFStreamReader ()
+  : map_ (NULL)
+  , map_size_ (0)
+  , index_ ()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFStreamReader::~LZFStreamReader ()
+{
+  close ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFStreamReader::open (const std::string &filename)
+{
+  close ();
+  map_ = mapFile (filename, map_size_);
+  if (map_ == NULL)
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamReader::open] Error mapping stream file %s\n", filename.c_str ());
+    return (false);
+  }
+
+  if (map_size_ < LZF_STREAM_HEADER_SIZE || memcmp (map_, "PCLZS", 5) != 0)
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamReader::open] Wrong signature header in %s! Should be 'P'C'L'Z'S'.\n", filename.c_str ());
+    close ();
+    return (false);
+  }
+  if (map_[5] != LZF_STREAM_VERSION)
+  {
+    PCL_ERROR ("[pcl::io::LZFStreamReader::open] Unsupported stream version %d in %s.\n", map_[5], filename.c_str ());
+    close ();
+    return (false);
+  }
+
+  if (!readIndex ())
+  {
+    PCL_WARN ("[pcl::io::LZFStreamReader::open] No valid frame index found in %s, scanning the frames instead.\n", filename.c_str ());
+    scanFrames ();
+  }
+  buildTimeOrder (index_, time_order_);
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFStreamReader::close ()
+{
+  if (map_ != NULL)
+    unmapFile (map_, map_size_);
+  map_ = NULL;
+  map_size_ = 0;
+  index_.clear ();
+  time_order_.clear ();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFStreamReader::readIndex ()
+{
+  index_.clear ();
+  if (map_size_ < LZF_STREAM_HEADER_SIZE + LZF_STREAM_FOOTER_SIZE)
+    return (false);
+
+  const char *footer = &map_[map_size_ - LZF_STREAM_FOOTER_SIZE];
+  if (memcmp (&footer[12], "PZIX", 4) != 0)
+    return (false);
+
+  uint64_t index_offset;
+  uint32_t nr_frames;
+  memcpy (&index_offset, &footer[0], sizeof (uint64_t));
+  memcpy (&nr_frames,    &footer[8], sizeof (uint32_t));
+  // Bounded by subtraction only: the sums of a corrupted footer could wrap around
+  if (index_offset < LZF_STREAM_HEADER_SIZE || index_offset > map_size_ - LZF_STREAM_FOOTER_SIZE ||
+      nr_frames != (map_size_ - LZF_STREAM_FOOTER_SIZE - index_offset) / LZF_STREAM_INDEX_ENTRY_SIZE ||
+      (map_size_ - LZF_STREAM_FOOTER_SIZE - index_offset) % LZF_STREAM_INDEX_ENTRY_SIZE != 0)
     return (false);
+
+  index_.resize (nr_frames);
+  const char *ptr = &map_[index_offset];
+  for (uint32_t i = 0; i < nr_frames; ++i, ptr += LZF_STREAM_INDEX_ENTRY_SIZE)
+  {
+    memcpy (&index_[i].offset,    &ptr[0],  sizeof (uint64_t));
+    memcpy (&index_[i].timestamp, &ptr[8],  sizeof (uint64_t));
+    memcpy (&index_[i].size,      &ptr[16], sizeof (uint32_t));
+    if (index_[i].offset < LZF_STREAM_HEADER_SIZE || index_[i].offset > index_offset ||
+        index_offset - index_[i].offset < LZF_STREAM_RECORD_HEADER_SIZE ||
+        index_[i].size > index_offset - index_[i].offset - LZF_STREAM_RECORD_HEADER_SIZE)
+    {
+      index_.clear ();
+      return (false);
+    }
   }
-  pcl_close (fd);
-#endif
   return (true);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-pcl::uint32_t
-pcl::io::LZFImageWriter::compress (const char* input, 
-                                   uint32_t uncompressed_size, 
-                                   uint32_t width,
-                                   uint32_t height,
-                                   const std::string &image_type,
-                                   char *output)
+bool
+pcl::io::LZFStreamReader::scanFrames ()
 {
-  static const int header_size = LZF_HEADER_SIZE;
-  float finput_size = static_cast<float> (uncompressed_size);
-  unsigned int compressed_size = pcl::lzfCompress (input,
-                                                   uncompressed_size,
-                                                   &output[header_size],
-                                                   uint32_t (finput_size * 1.5f));
-
-  uint32_t compressed_final_size = 0;
-  if (compressed_size)
+  index_.clear ();
+  uint64_t offset = LZF_STREAM_HEADER_SIZE;
+  while (offset + LZF_STREAM_RECORD_HEADER_SIZE <= map_size_)
   {
-    // Copy the header first
-    const char header[] = "PCLZF";
-    memcpy (&output[0],  &header[0], 5);
-    memcpy (&output[5],  &width, sizeof (uint32_t));
-    memcpy (&output[9],  &height, sizeof (uint32_t));
-    std::string itype = image_type;
-    // Cut or pad the string
-    if (itype.size () > 16)
-    {
-      PCL_WARN ("[pcl::io::LZFImageWriter::compress] Image type should be a string of maximum 16 characters! Cutting %s to %s.\n", image_type.c_str (), image_type.substr (0, 15).c_str ());
-      itype = itype.substr (0, 15);
-    }
-    if (itype.size () < 16)
-      itype.insert (itype.end (), 16 - itype.size (), ' ');
-
-    memcpy (&output[13], &itype[0], 16);
-    memcpy (&output[29], &compressed_size, sizeof (uint32_t));
-    memcpy (&output[33], &uncompressed_size, sizeof (uint32_t));
-    compressed_final_size = uint32_t (compressed_size + header_size);
+    LZFStreamIndexEntry entry;
+    entry.offset = offset;
+    memcpy (&entry.timestamp, &map_[offset],     sizeof (uint64_t));
+    memcpy (&entry.size,      &map_[offset + 8], sizeof (uint32_t));
+    // The preallocated but unused tail of the file is zero-filled
+    if (entry.size < LZF_HEADER_SIZE ||
+        offset + LZF_STREAM_RECORD_HEADER_SIZE + entry.size > map_size_ ||
+        memcmp (&map_[offset + LZF_STREAM_RECORD_HEADER_SIZE], "PCLZ", 4) != 0)
+      break;
+    index_.push_back (entry);
+    offset += LZF_STREAM_RECORD_HEADER_SIZE + entry.size;
   }
-
-  return (compressed_final_size);
+  return (!index_.empty ());
 }
 
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFDepth16ImageWriter::write (const char* data,
-                                       uint32_t width, uint32_t height,
-                                       const std::string &filename)
+pcl::io::LZFStreamReader::getFrame (size_t index, const char* &blob, uint32_t &blob_size) const
 {
-  // Prepare the compressed depth buffer
-  unsigned int depth_size = width * height * 2;
-  char* compressed_depth = static_cast<char*> (malloc (size_t (float (depth_size) * 1.5f + float (LZF_HEADER_SIZE))));
-
-  size_t compressed_size = compress (data,
-                                     depth_size,
-                                     width, height,
-                                     "depth16",
-                                     compressed_depth);
-  if (compressed_size == 0)
+  if (index >= index_.size ())
   {
-    free (compressed_depth);
+    PCL_ERROR ("[pcl::io::LZFStreamReader::getFrame] Frame %zu out of range (%zu frames in stream).\n", index, index_.size ());
     return (false);
   }
-
-  // Save the actual image
-  saveImageBlob (compressed_depth, compressed_size, filename);
-  free (compressed_depth);
+  blob = &map_[index_[index].offset + LZF_STREAM_RECORD_HEADER_SIZE];
+  blob_size = index_[index].size;
   return (true);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFStreamReader::willNeed (size_t first, size_t count) const
+{
+  if (first >= index_.size () || count == 0)
+    return;
+  size_t last = std::min (first + count, index_.size ()) - 1;
+  uint64_t begin = index_[first].offset;
+  uint64_t end = index_[last].offset + LZF_STREAM_RECORD_HEADER_SIZE + index_[last].size;
+  adviseWillNeed (&map_[begin], end - begin);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFImageWriter::writeParameter (const double &parameter,
-                                         const std::string &tag,
-                                         const std::string &filename)
+pcl::io::LZFStreamReader::findFrame (uint64_t timestamp, size_t &index) const
 {
-  boost::property_tree::ptree pt;
-  try
-  {
-    boost::property_tree::xml_parser::read_xml (filename, pt, boost::property_tree::xml_parser::trim_whitespace);
-  }
-  catch (std::exception& e)
-  {}
+  return (::findFrame (index_, time_order_, timestamp, index));
+}
 
-  auto settings = boost::property_tree::xml_writer_make_settings<std::string> ('\t', 1);
-  pt.put (tag, parameter);
-  write_xml (filename, pt, std::locale (), settings);
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFStreamReader::findNearestFrame (uint64_t timestamp, size_t &index) const
+{
+  return (::findNearestFrame (index_, time_order_, timestamp, index));
+}
 
-  return (true);
+//////////////////////////////////////////////////////////////////////////////
+size_t
+pcl::io::LZFStreamReader::findFrames (uint64_t begin, uint64_t end, std::vector<size_t> &indices) const
+{
+  return (::findFrames (index_, time_order_, begin, end, indices));
 }
 
 //////////////////////////////////////////////////////////////////////////////
-bool
-pcl::io::LZFDepth16ImageWriter::writeParameters (const pcl::io::CameraParameters &parameters,
-                                                 const std::string &filename)
+pcl::io::LZFFrameIndex::LZFFrameIndex ()
+  : fd_ (-1)
+  , directory_ ()
+  , entries_ ()
+  , time_order_ ()
 {
-  boost::property_tree::ptree pt;
-  try
-  {
-    boost::property_tree::xml_parser::read_xml (filename, pt, boost::property_tree::xml_parser::trim_whitespace);
-  }
-  catch (std::exception& e)
-  {}
-  auto settings = boost::property_tree::xml_writer_make_settings<std::string> ('\t', 1);
-  pt.put ("depth.focal_length_x", parameters.focal_length_x);
-  pt.put ("depth.focal_length_y", parameters.focal_length_y);
-  pt.put ("depth.principal_point_x", parameters.principal_point_x);
-  pt.put ("depth.principal_point_y", parameters.principal_point_y);
-  pt.put ("depth.z_multiplication_factor", z_multiplication_factor_);
-  write_xml (filename, pt, std::locale (), settings);
+}
 
-  return (true);
+//////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFFrameIndex::~LZFFrameIndex ()
+{
+  close ();
 }
 
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFRGB24ImageWriter::write (const char *data, 
-                                     uint32_t width, uint32_t height,
-                                     const std::string &filename)
+pcl::io::LZFFrameIndex::create (const std::string &filename)
 {
-  // Transform RGBRGB into RRGGBB for better compression
-  std::vector<char> rrggbb (width * height * 3);
-  int ptr1 = 0,
-      ptr2 = width * height,
-      ptr3 = 2 * width * height;
-  for (uint32_t i = 0; i < width * height; ++i, ++ptr1, ++ptr2, ++ptr3)
+  close ();
+  entries_.clear ();
+  time_order_.clear ();
+  directory_ = boost::filesystem::path (filename).parent_path ().string ();
+
+#ifdef _WIN32
+  fd_ = pcl_open (filename.c_str (), _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  fd_ = pcl_open (filename.c_str (), O_RDWR | O_CREAT | O_TRUNC, static_cast<mode_t> (0600));
+#endif
+  if (fd_ < 0)
   {
-    rrggbb[ptr1] = data[i * 3 + 0];
-    rrggbb[ptr2] = data[i * 3 + 1];
-    rrggbb[ptr3] = data[i * 3 + 2];
+    PCL_ERROR ("[pcl::io::LZFFrameIndex::create] Failure to open file %s\n", filename.c_str ());
+    fd_ = -1;
+    return (false);
   }
 
-  char* compressed_rgb = static_cast<char*> (malloc (size_t (float (rrggbb.size ()) * 1.5f + float (LZF_HEADER_SIZE))));
-  size_t compressed_size = compress (reinterpret_cast<const char*> (&rrggbb[0]), 
-                                     uint32_t (rrggbb.size ()),
-                                     width, height,
-                                     "rgb24",
-                                     compressed_rgb);
-
-  if (compressed_size == 0)
+  char header[LZF_FRAME_INDEX_HEADER_SIZE] = {'P', 'C', 'L', 'Z', 'I', LZF_FRAME_INDEX_VERSION, 0, 0};
+  if (!writeAll (fd_, header, LZF_FRAME_INDEX_HEADER_SIZE))
   {
-    free (compressed_rgb);
+    PCL_ERROR ("[pcl::io::LZFFrameIndex::create] Error writing the index header to %s\n", filename.c_str ());
+    close ();
     return (false);
   }
-
-  // Save the actual image
-  saveImageBlob (compressed_rgb, compressed_size, filename);
-  free (compressed_rgb);
   return (true);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFRGB24ImageWriter::writeParameters (const pcl::io::CameraParameters &parameters,
-                                              const std::string &filename)
+pcl::io::LZFFrameIndex::load (const std::string &filename)
 {
-  boost::property_tree::ptree pt;
-  try
+  close ();
+  entries_.clear ();
+  time_order_.clear ();
+  directory_ = boost::filesystem::path (filename).parent_path ().string ();
+
+  uint64_t map_size = 0;
+  char *map = mapFile (filename, map_size);
+  if (map == NULL)
   {
-    boost::property_tree::xml_parser::read_xml (filename, pt, boost::property_tree::xml_parser::trim_whitespace);
+    PCL_ERROR ("[pcl::io::LZFFrameIndex::load] Error mapping index file %s\n", filename.c_str ());
+    return (false);
+  }
+  if (map_size < LZF_FRAME_INDEX_HEADER_SIZE || memcmp (map, "PCLZI", 5) != 0 || map[5] != LZF_FRAME_INDEX_VERSION)
+  {
+    PCL_ERROR ("[pcl::io::LZFFrameIndex::load] %s is not a version %d PCLZI index!\n", filename.c_str (), LZF_FRAME_INDEX_VERSION);
+    unmapFile (map, map_size);
+    return (false);
   }
-  catch (std::exception& e)
-  {}
 
-  auto settings = boost::property_tree::xml_writer_make_settings<std::string> ('\t', 1);
-  pt.put ("rgb.focal_length_x", parameters.focal_length_x);
-  pt.put ("rgb.focal_length_y", parameters.focal_length_y);
-  pt.put ("rgb.principal_point_x", parameters.principal_point_x);
-  pt.put ("rgb.principal_point_y", parameters.principal_point_y);
-  write_xml (filename, pt, std::locale (), settings);
+  uint64_t offset = LZF_FRAME_INDEX_HEADER_SIZE;
+  while (offset + LZF_FRAME_INDEX_RECORD_SIZE <= map_size)
+  {
+    LZFFrameIndexEntry entry;
+    uint16_t name_size;
+    memcpy (&entry.timestamp, &map[offset],      sizeof (uint64_t));
+    memcpy (&entry.sequence,  &map[offset + 8],  sizeof (uint64_t));
+    memcpy (&name_size,       &map[offset + 16], sizeof (uint16_t));
+    if (offset + LZF_FRAME_INDEX_RECORD_SIZE + name_size > map_size)
+      break;
+    entry.filename.assign (&map[offset + LZF_FRAME_INDEX_RECORD_SIZE], name_size);
+    entries_.push_back (entry);
+    offset += LZF_FRAME_INDEX_RECORD_SIZE + name_size;
+  }
+  // A record cut short by a crash of the writer is ignored
+  if (offset != map_size)
+    PCL_WARN ("[pcl::io::LZFFrameIndex::load] Ignoring a truncated record at the end of %s.\n", filename.c_str ());
+  unmapFile (map, map_size);
 
+  buildTimeOrder (entries_, time_order_);
   return (true);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-bool
-pcl::io::LZFYUV422ImageWriter::write (const char *data, 
-                                      uint32_t width, uint32_t height,
-                                      const std::string &filename)
+void
+pcl::io::LZFFrameIndex::close ()
 {
-  // Transform YUV422 into UUUYYYYYYVVV for better compression
-  std::vector<char> uuyyvv (width * height * 2);
-  int wh2 = width * height / 2,
-      ptr1 = 0,                        // u
-      ptr2 = wh2,                      // y
-      ptr3 = wh2 + width * height;     // v
-  for (int i = 0; i < wh2; ++i, ++ptr1, ptr2 += 2, ++ptr3)
-  {
-    uuyyvv[ptr1] = data[i * 4 + 0];       // u
-    uuyyvv[ptr2 + 0] = data[i * 4 + 1];   // y
-    uuyyvv[ptr2 + 1] = data[i * 4 + 3];   // y
-    uuyyvv[ptr3] = data[i * 4 + 2];       // v
-  }
-
-  char* compressed_yuv = static_cast<char*> (malloc (size_t (float (uuyyvv.size ()) * 1.5f + float (LZF_HEADER_SIZE))));
-  size_t compressed_size = compress (reinterpret_cast<const char*> (&uuyyvv[0]), 
-                                     uint32_t (uuyyvv.size ()),
-                                     width, height,
-                                     "yuv422",
-                                     compressed_yuv);
+  if (fd_ != -1)
+    pcl_close (fd_);
+  fd_ = -1;
+}
 
-  if (compressed_size == 0)
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFFrameIndex::append (const std::string &filename, uint64_t timestamp, uint64_t sequence)
+{
+  LZFFrameIndexEntry entry;
+  entry.timestamp = timestamp;
+  entry.sequence = sequence;
+  entry.filename = boost::filesystem::path (filename).filename ().string ();
+  if (entry.filename.size () > std::numeric_limits<uint16_t>::max ())
   {
-    free (compressed_yuv);
+    PCL_ERROR ("[pcl::io::LZFFrameIndex::append] File name %s is too long!\n", filename.c_str ());
     return (false);
   }
 
-  // Save the actual image
-  saveImageBlob (compressed_yuv, compressed_size, filename);
-  free (compressed_yuv);
+  if (fd_ != -1)
+  {
+    // One write per record, so a crash can only ever cut the last record short
+    std::vector<char> record (LZF_FRAME_INDEX_RECORD_SIZE + entry.filename.size ());
+    uint16_t name_size = static_cast<uint16_t> (entry.filename.size ());
+    memcpy (&record[0],  &entry.timestamp, sizeof (uint64_t));
+    memcpy (&record[8],  &entry.sequence,  sizeof (uint64_t));
+    memcpy (&record[16], &name_size,       sizeof (uint16_t));
+    memcpy (&record[LZF_FRAME_INDEX_RECORD_SIZE], entry.filename.data (), name_size);
+    if (!writeAll (fd_, &record[0], record.size ()))
+    {
+      PCL_ERROR ("[pcl::io::LZFFrameIndex::append] Error writing the record of %s: %s\n", filename.c_str (), strerror (errno));
+      return (false);
+    }
+  }
+
+  // Keep the time order up to date. Out of order frames are rare, so the
+  // insertion cost only matters for the unusual case.
+  if (time_order_.empty () && !entries_.empty () && timestamp < entries_.back ().timestamp)
+  {
+    time_order_.resize (entries_.size ());
+    for (size_t i = 0; i < time_order_.size (); ++i)
+      time_order_[i] = i;
+  }
+  entries_.push_back (entry);
+  if (!time_order_.empty ())
+  {
+    std::vector<size_t>::iterator it = std::upper_bound (time_order_.begin (), time_order_.end (), timestamp,
+        [this] (uint64_t t, size_t i) { return (t < entries_[i].timestamp); });
+    time_order_.insert (it, entries_.size () - 1);
+  }
   return (true);
 }
 
 //////////////////////////////////////////////////////////////////////////////
-bool
-pcl::io::LZFBayer8ImageWriter::write (const char *data, 
-                                      uint32_t width, uint32_t height,
-                                      const std::string &filename)
+std::string
+pcl::io::LZFFrameIndex::getFilename (size_t index) const
 {
-  unsigned int bayer_size = width * height;
-  char* compressed_bayer = static_cast<char*> (malloc (size_t (float (bayer_size) * 1.5f + float (LZF_HEADER_SIZE))));
-  size_t compressed_size = compress (data,
-                                     bayer_size,
-                                     width, height,
-                                     "bayer8",
-                                     compressed_bayer);
+  return ((boost::filesystem::path (directory_) / entries_[index].filename).string ());
+}
 
-  if (compressed_size == 0)
-  {
-    free (compressed_bayer);
-    return (false);
-  }
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFFrameIndex::findFrame (uint64_t timestamp, size_t &index) const
+{
+  return (::findFrame (entries_, time_order_, timestamp, index));
+}
 
-  // Save the actual image
-  saveImageBlob (compressed_bayer, compressed_size, filename);
-  free (compressed_bayer);
-  return (true);
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFFrameIndex::findNearestFrame (uint64_t timestamp, size_t &index) const
+{
+  return (::findNearestFrame (entries_, time_order_, timestamp, index));
 }
 
 //////////////////////////////////////////////////////////////////////////////
+size_t
+pcl::io::LZFFrameIndex::findFrames (uint64_t begin, uint64_t end, std::vector<size_t> &indices) const
+{
+  return (::findFrames (entries_, time_order_, begin, end, indices));
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
+pcl::io::LZFSequenceReader::LZFSequenceReader (size_t prefetch_frames, unsigned int nr_threads)
+  : prefetch_frames_ (std::max<size_t> (prefetch_frames, 1))
+  , nr_threads_ (nr_threads > 0 ? nr_threads : std::max (std::thread::hardware_concurrency (), 1u))
+  , filenames_ ()
+  , stream_ ()
+  , nr_frames_ (0)
+  , temporal_ (false)
+  , nr_workers_ (0)
+  , slots_ (prefetch_frames_)
+  , next_decode_ (0)
+  , next_consume_ (0)
+  , stopping_ (false)
+  , mutex_ ()
+  , slot_free_ ()
+  , slot_ready_ ()
+  , threads_ ()
+{
+}
+
 //////////////////////////////////////////////////////////////////////////////
-pcl::io::LZFImageReader::LZFImageReader ()
-  : width_ ()
-  , height_ ()
-  , image_type_identifier_ ()
-  , parameters_ ()
+pcl::io::LZFSequenceReader::~LZFSequenceReader ()
 {
+  close ();
 }
 
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFImageReader::loadImageBlob (const std::string &filename,
-                                        std::vector<char> &data,
-                                        uint32_t &uncompressed_size)
+pcl::io::LZFSequenceReader::openDirectory (const std::string &directory,
+                                           const std::string &extension)
 {
-  if (filename == "" || !boost::filesystem::exists (filename))
-  {
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Could not find file '%s'.\n", filename.c_str ());
-    return (false);
-  }
-  // Open for reading
-  int fd = pcl_open (filename.c_str (), O_RDONLY);
-  if (fd == -1)
+  close ();
+  if (!boost::filesystem::is_directory (directory))
   {
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Failure to open file %s\n", filename.c_str () );
+    PCL_ERROR ("[pcl::io::LZFSequenceReader::openDirectory] Could not find directory '%s'.\n", directory.c_str ());
     return (false);
   }
 
-  // Seek to the end of file to get the filesize
-  off_t data_size = pcl_lseek (fd, 0, SEEK_END);
-  if (data_size < 0)
+  boost::filesystem::directory_iterator end;
+  for (boost::filesystem::directory_iterator it (directory); it != end; ++it)
+    if (it->path ().extension () == extension && boost::filesystem::is_regular_file (it->status ()))
+      filenames_.push_back (it->path ().string ());
+  std::sort (filenames_.begin (), filenames_.end ());
+  if (filenames_.empty ())
   {
-    pcl_close (fd);
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] lseek errno: %d strerror: %s\n", errno, strerror (errno));
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Error during lseek ()!\n");
+    PCL_ERROR ("[pcl::io::LZFSequenceReader::openDirectory] No %s files in '%s'.\n", extension.c_str (), directory.c_str ());
     return (false);
   }
-  pcl_lseek (fd, 0, SEEK_SET);
 
-#ifdef _WIN32
-  // As we don't know the real size of data (compressed or not), 
-  // we set dwMaximumSizeHigh = dwMaximumSizeLow = 0 so as to map the whole file
-  HANDLE fm = CreateFileMapping ((HANDLE) _get_osfhandle (fd), NULL, PAGE_READONLY, 0, 0, NULL);
-  // As we don't know the real size of data (compressed or not), 
-  // we set dwNumberOfBytesToMap = 0 so as to map the whole file
-  char *map = static_cast<char*>(MapViewOfFile (fm, FILE_MAP_READ, 0, 0, 0));
-  if (map == NULL)
-  {
-    CloseHandle (fm);
-    pcl_close (fd);
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Error mapping view of file, %s\n", filename.c_str ());
-    return (false);
-  }
-#else
-  char *map = static_cast<char*> (mmap (0, data_size, PROT_READ, MAP_SHARED, fd, 0));
-  if (map == reinterpret_cast<char*> (-1))    // MAP_FAILED
-  {
-    pcl_close (fd);
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Error preparing mmap for PCLZF file.\n");
+  nr_frames_ = filenames_.size ();
+  start ();
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSequenceReader::openStream (const std::string &filename)
+{
+  close ();
+  if (!stream_.open (filename))
     return (false);
-  }
-#endif
 
-  // Check the header identifier here
-  char header_string[5];
-  memcpy (&header_string,    &map[0], 5);        // PCLZF
-  if (std::string (header_string).substr (0, 5) != "PCLZF")
+  nr_frames_ = stream_.getNumberOfFrames ();
+  start ();
+  return (true);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFSequenceReader::close ()
+{
   {
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Wrong signature header! Should be 'P'C'L'Z'F'.\n");
-#ifdef _WIN32
-  UnmapViewOfFile (map);
-  CloseHandle (fm);
-#else
-    munmap (map, data_size);
-#endif
-    return (false);
+    std::lock_guard<std::mutex> lock (mutex_);
+    stopping_ = true;
   }
-  memcpy (&width_,            &map[5], sizeof (uint32_t));
-  memcpy (&height_,           &map[9], sizeof (uint32_t));
-  char imgtype_string[16];
-  memcpy (&imgtype_string,    &map[13], 16);       // BAYER8, RGB24_, YUV422_, ...
-  image_type_identifier_ = std::string (imgtype_string).substr (0, 15);
-  image_type_identifier_.insert (image_type_identifier_.end (), 1, '\0');
+  slot_free_.notify_all ();
+  for (size_t i = 0; i < threads_.size (); ++i)
+    threads_[i].join ();
+  threads_.clear ();
 
-  static const int header_size = LZF_HEADER_SIZE;
-  uint32_t compressed_size;
-  memcpy (&compressed_size,   &map[29], sizeof (uint32_t));
+  filenames_.clear ();
+  stream_.close ();
+  nr_frames_ = 0;
+  next_decode_ = next_consume_ = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFSequenceReader::start ()
+{
+  next_decode_ = next_consume_ = 0;
+  stopping_ = false;
+  for (size_t i = 0; i < slots_.size (); ++i)
+    slots_[i].ready = false;
+
+  // The workers keep the kernel one window ahead of the frames they decompress
+  for (size_t i = 0; i < std::min (2 * prefetch_frames_, nr_frames_); ++i)
+    willNeed (i);
+
+  size_t nr_threads = std::min<size_t> (nr_threads_, std::min (prefetch_frames_, nr_frames_));
+  // Whether the sequence holds temporal images is only known once a worker meets one
+  temporal_ = false;
+  nr_workers_ = nr_threads;
+  for (size_t i = 0; i < nr_threads; ++i)
+    threads_.push_back (std::thread (&LZFSequenceReader::run, this));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void
+pcl::io::LZFSequenceReader::run ()
+{
+  LZFRGB24ImageReader reader;
+  // The frames are already decompressed in parallel
+  reader.setNumberOfThreads (1);
+  // The frame last decoded by this worker, none yet
+  size_t previous = nr_frames_;
 
-  if (compressed_size + header_size != data_size)
+  std::unique_lock<std::mutex> lock (mutex_);
+  for (;;)
   {
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Number of bytes to decompress written in file (%u) differs from what it should be (%u)!\n", compressed_size, data_size - header_size);
-#ifdef _WIN32
-  UnmapViewOfFile (map);
-  CloseHandle (fm);
-#else
-    munmap (map, data_size);
-#endif
-    return (false);
-  }
+    while (!stopping_ && next_decode_ < nr_frames_ && next_decode_ >= next_consume_ + prefetch_frames_)
+      slot_free_.wait (lock);
+    if (stopping_ || next_decode_ >= nr_frames_)
+      return;
+    // Temporal images depend on the frame before them: once one showed up,
+    // all workers but one retire, and the last one decodes the rest in order
+    if (temporal_ && nr_workers_ > 1)
+    {
+      --nr_workers_;
+      return;
+    }
 
-  memcpy (&uncompressed_size, &map[33], sizeof (uint32_t));
+    // The slot of a claimed frame belongs to this thread until it is marked ready
+    size_t index = next_decode_++;
+    Slot &slot = slots_[index % prefetch_frames_];
+    lock.unlock ();
 
-  data.resize (compressed_size);
-  memcpy (&data[0], &map[header_size], compressed_size);
- 
-#ifdef _WIN32
-  UnmapViewOfFile (map);
-  CloseHandle (fm);
-#else
-  if (munmap (map, data_size) == -1)
-    PCL_ERROR ("[pcl::io::LZFImageReader::loadImage] Munmap failure\n");
-#endif
-  pcl_close (fd);
+    willNeed (index + prefetch_frames_);
+    bool temporal = decode (index, previous, reader, slot.frame);
+    previous = index;
 
-  data_size = off_t (compressed_size);      // We only care about this from here on
-  return (true);
+    lock.lock ();
+    temporal_ = temporal_ || temporal;
+    slot.ready = true;
+    slot_ready_.notify_all ();
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFImageReader::decompress (const std::vector<char> &input,
-                                     std::vector<char> &output)
+pcl::io::LZFSequenceReader::decode (size_t index, size_t previous, LZFRGB24ImageReader &reader, Frame &frame)
 {
-  if (output.empty ())
+  frame.index = index;
+  frame.valid = false;
+  frame.width = frame.height = 0;
+  frame.image_type.clear ();
+
+  bool temporal = false;
+  if (filenames_.empty ())
   {
-    PCL_ERROR ("[pcl::io::LZFImageReader::decompress] Output array needs to be preallocated! The correct uncompressed array value should have been stored during the compression.\n");
-    return (false);
+    const char *blob;
+    uint32_t blob_size;
+    frame.timestamp = stream_.getTimestamp (index);
+    frame.filename.clear ();
+    if (!stream_.getFrame (index, blob, blob_size))
+      frame.valid = false;
+    // The stream read keeps track of the reference of the temporal images,
+    // and decodes from the last keyframe if this reader did not just read it
+    else if (blob_size >= LZF_HEADER_SIZE && memcmp (&blob[13], "depth16", 7) == 0)
+    {
+      temporal = isTemporalBlob (blob, blob_size);
+      frame.valid = reader.read (stream_, index, frame.data);
+    }
+    else
+      frame.valid = reader.readInterleaved (blob, blob_size, frame.data);
+  }
+  else
+  {
+    frame.timestamp = 0;
+    frame.filename = filenames_[index];
+    uint64_t map_size = 0;
+    char *map = mapFile (frame.filename, map_size);
+    if (map == NULL)
+      PCL_ERROR ("[pcl::io::LZFSequenceReader::decode] Error mapping PCLZF file %s: %s\n", frame.filename.c_str (), strerror (errno));
+    else
+    {
+      temporal = isTemporalBlob (map, map_size);
+      // The frames since the last keyframe are only read again if another worker decoded the one before
+      if (!temporal || previous + 1 == index || decodeReferences (index, reader, frame.data))
+        frame.valid = reader.readInterleaved (map, map_size, frame.data);
+      unmapFile (map, map_size);
+    }
   }
-  unsigned int tmp_size = pcl::lzfDecompress (static_cast<const char*>(&input[0]), 
-                                              uint32_t (input.size ()), 
-                                              static_cast<char*>(&output[0]), 
-                                              uint32_t (output.size ()));
 
-  if (tmp_size != output.size ())
+  if (frame.valid)
   {
-    PCL_WARN ("[pcl::io::LZFImageReader::decompress] Size of decompressed lzf data (%u) does not match the uncompressed size value (%u). Errno: %d\n", tmp_size, output.size (), errno);
-    return (false);
+    frame.width = reader.getWidth ();
+    frame.height = reader.getHeight ();
+    frame.image_type = reader.getImageType ();
+    frame.image_type.erase (std::min (frame.image_type.find (' '), frame.image_type.find ('\0')));
   }
-  return (true);
+  return (temporal);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFImageReader::readParameters (const std::string &filename)
+pcl::io::LZFSequenceReader::decodeReferences (size_t index, LZFRGB24ImageReader &reader, std::vector<char> &scratch) const
 {
-  std::filebuf fb;
-  std::filebuf *f = fb.open (filename.c_str (), std::ios::in);
-  if (f == NULL)
+  if (index == 0)
     return (false);
-  std::istream is (&fb);
-  bool res = readParameters (is);
-  fb.close ();
-  return (res);
+  size_t keyframe = index - 1;
+  while (keyframe > 0 && isTemporalFrame (keyframe))
+    --keyframe;
+
+  for (size_t i = keyframe; i < index; ++i)
+  {
+    uint64_t map_size = 0;
+    char *map = mapFile (filenames_[i], map_size);
+    bool res = (map != NULL) && reader.readInterleaved (map, map_size, scratch);
+    if (map != NULL)
+      unmapFile (map, map_size);
+    if (!res)
+    {
+      PCL_ERROR ("[pcl::io::LZFSequenceReader::decodeReferences] Unable to read %s, the reference of %s.\n", filenames_[i].c_str (), filenames_[index].c_str ());
+      return (false);
+    }
+  }
+  return (true);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 bool
-pcl::io::LZFRGB24ImageReader::readParameters (std::istream& is)
+pcl::io::LZFSequenceReader::isTemporalFrame (size_t index) const
 {
-  boost::property_tree::ptree pt;
-  read_xml (is, pt, boost::property_tree::xml_parser::trim_whitespace);
-
-  boost::optional<boost::property_tree::ptree&> tree = pt.get_child_optional ("rgb");
-  if (!tree)
+  if (index >= nr_frames_)
     return (false);
+  if (filenames_.empty ())
+  {
+    const char *blob;
+    uint32_t blob_size;
+    return (stream_.getFrame (index, blob, blob_size) && isTemporalBlob (blob, blob_size));
+  }
 
-  parameters_.focal_length_x = tree.get ().get<double>("focal_length_x");
-  parameters_.focal_length_y = tree.get ().get<double>("focal_length_y");
-  parameters_.principal_point_x = tree.get ().get<double>("principal_point_x");
-  parameters_.principal_point_y = tree.get ().get<double>("principal_point_y");
-  PCL_DEBUG ("[pcl::io::LZFRGB24ImageReader::readParameters] Read camera parameters (fx,fy,cx,cy): %g,%g,%g,%g.\n", 
-      parameters_.focal_length_x, parameters_.focal_length_y, 
-      parameters_.principal_point_x, parameters_.principal_point_y);
-  return (true);
+  char header[LZF_HEADER_SIZE];
+  std::ifstream file (filenames_[index].c_str (), std::ios::binary);
+  return (file.read (header, LZF_HEADER_SIZE) && isTemporalBlob (header, LZF_HEADER_SIZE));
 }
 
 //////////////////////////////////////////////////////////////////////////////
-bool
-pcl::io::LZFDepth16ImageReader::readParameters (std::istream& is)
+void
+pcl::io::LZFSequenceReader::willNeed (size_t index) const
 {
-  boost::property_tree::ptree pt;
-  read_xml (is, pt, boost::property_tree::xml_parser::trim_whitespace);
+  if (index >= nr_frames_)
+    return;
+  if (filenames_.empty ())
+    stream_.willNeed (index, 1);
+  else
+    adviseWillNeed (filenames_[index]);
+}
 
-  boost::optional<boost::property_tree::ptree&> tree = pt.get_child_optional ("depth");
-  if (!tree)
+//////////////////////////////////////////////////////////////////////////////
+bool
+pcl::io::LZFSequenceReader::next (Frame &frame)
+{
+  std::unique_lock<std::mutex> lock (mutex_);
+  if (next_consume_ >= nr_frames_)
     return (false);
 
-  parameters_.focal_length_x = tree.get ().get<double>("focal_length_x");
-  parameters_.focal_length_y = tree.get ().get<double>("focal_length_y");
-  parameters_.principal_point_x = tree.get ().get<double>("principal_point_x");
-  parameters_.principal_point_y = tree.get ().get<double>("principal_point_y");
-  z_multiplication_factor_ = tree.get ().get<double>("z_multiplication_factor");
-  PCL_DEBUG ("[pcl::io::LZFDepth16ImageReader::readParameters] Read camera parameters (fx,fy,cx,cy): %g,%g,%g,%g.\n", 
-      parameters_.focal_length_x, parameters_.focal_length_y, 
-      parameters_.principal_point_x, parameters_.principal_point_y);
-  PCL_DEBUG ("[pcl::io::LZFDepth16ImageReader::readParameters] Multiplication factor: %g.\n", z_multiplication_factor_);
+  Slot &slot = slots_[next_consume_ % prefetch_frames_];
+  while (!slot.ready)
+    slot_ready_.wait (lock);
+
+  // Hand the caller's old buffers to the slot, to be reused for a later frame
+  std::swap (frame, slot.frame);
+  slot.ready = false;
+  ++next_consume_;
+  lock.unlock ();
+  slot_free_.notify_all ();
   return (true);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+size_t
+pcl::io::LZFSequenceReader::forEach (const FrameCallback &callback)
+{
+  Frame frame;
+  size_t nr_frames = 0;
+  while (next (frame))
+  {
+    ++nr_frames;
+    if (!callback (frame))
+      break;
+  }
+  return (nr_frames);
+}
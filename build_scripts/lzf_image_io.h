@@ -0,0 +1,3282 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2012-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PCL_LZF_IMAGE_IO_H_
+#define PCL_LZF_IMAGE_IO_H_
+
+#include <pcl/pcl_macros.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/console/print.h>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace pcl
+{
+  namespace io
+  {
+    /** \brief Basic camera parameters placeholder. */
+    struct CameraParameters
+    {
+      /** fx */
+      double focal_length_x;
+      /** fy */
+      double focal_length_y;
+      /** cx */
+      double principal_point_x;
+      /** cy */
+      double principal_point_y;
+    };
+
+    /** \brief Reorder an interleaved [RGBRGB...RGB] image into [RR...RGG...GBB...B].
+      *
+      * This is the transformation applied by LZFRGB24ImageWriter before
+      * compression. SSSE3/AVX2 or NEON kernels are used when the CPU supports
+      * them, with a scalar fallback producing identical output.
+      * \param[in] rgb the interleaved image (3 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[out] rrggbb the planar image (3 * nr_pixels bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    deinterleaveRGB24 (const char *rgb, size_t nr_pixels, char *rrggbb);
+
+    /** \brief Reorder a planar [RR...RGG...GBB...B] image back into [RGBRGB...RGB].
+      * \param[in] rrggbb the planar image (3 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[out] rgb the interleaved image (3 * nr_pixels bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    interleaveRGB24 (const char *rrggbb, size_t nr_pixels, char *rgb);
+
+    /** \brief Reorder an interleaved [UYVY...UYVY] image into [UU...UYY...YVV...V].
+      *
+      * This is the transformation applied by LZFYUV422ImageWriter before
+      * compression. SSSE3/AVX2 or NEON kernels are used when the CPU supports
+      * them, with a scalar fallback producing identical output.
+      * \param[in] uyvy the interleaved image (2 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[out] uuyyvv the planar image (2 * nr_pixels bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    deinterleaveYUV422 (const char *uyvy, size_t nr_pixels, char *uuyyvv);
+
+    /** \brief Reorder a planar [UU...UYY...YVV...V] image back into [UYVY...UYVY].
+      * \param[in] uuyyvv the planar image (2 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[out] uyvy the interleaved image (2 * nr_pixels bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    interleaveYUV422 (const char *uuyyvv, size_t nr_pixels, char *uyvy);
+
+    /** \brief Apply the reversible "depth16d" pre-filter to a 16-bit depth image.
+      *
+      * Every pixel is replaced by its difference to the pixel on its left (the
+      * first pixel of a row by its difference to the first pixel of the row
+      * above), and the low and high bytes of the differences are stored in two
+      * separate planes. Smooth surfaces turn into long runs of small values,
+      * which LZF compresses much better than interleaved raw depth.
+      * \param[in] depth the depth image (2 * width * height bytes)
+      * \param[in] width the width of the image
+      * \param[in] height the height of the image
+      * \param[out] planes the filtered image (2 * width * height bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    encodeDepth16Delta (const char *depth, uint32_t width, uint32_t height, char *planes);
+
+    /** \brief Undo the "depth16d" pre-filter applied by \ref encodeDepth16Delta.
+      * \param[in] planes the filtered image (2 * width * height bytes)
+      * \param[in] width the width of the image
+      * \param[in] height the height of the image
+      * \param[out] depth the depth image (2 * width * height bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    decodeDepth16Delta (const char *planes, uint32_t width, uint32_t height, char *depth);
+
+    /** \brief Apply the reversible "depth16t" pre-filter to a 16-bit depth image.
+      *
+      * Every pixel is replaced by its difference to the same pixel of a
+      * reference image (usually the previous frame of a sequence), zigzag
+      * mapped so that small negative differences stay small, and the low and
+      * high bytes of the differences are stored in two separate planes.
+      * Static parts of the scene turn into runs of zeros.
+      * \param[in] depth the depth image (2 * nr_pixels bytes)
+      * \param[in] reference the reference depth image (2 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[out] planes the filtered image (2 * nr_pixels bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    encodeDepth16Temporal (const char *depth, const char *reference, size_t nr_pixels, char *planes);
+
+    /** \brief Undo the "depth16t" pre-filter applied by \ref encodeDepth16Temporal.
+      * \param[in] planes the filtered image (2 * nr_pixels bytes)
+      * \param[in] reference the reference depth image used by the encoder (2 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[out] depth the depth image (2 * nr_pixels bytes). May alias \a reference.
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    decodeDepth16Temporal (const char *planes, const char *reference, size_t nr_pixels, char *depth);
+
+    /** \brief Apply the lossy "depth16q" filter to a 16-bit depth image.
+      *
+      * Depth values in [1, max_depth] are mapped to bins of \a step values,
+      * code 1 being the first bin. 0 (invalid) stays 0 and every value beyond
+      * max_depth gets the code of the bin following the last one, so that it
+      * still reads as out of range. The low and high bytes of the codes are
+      * stored in two separate planes: coarse bins turn surfaces into long
+      * runs of equal codes, and the high plane is mostly constant.
+      * \param[in] depth the depth image (2 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[in] step the size of a bin, in depth units
+      * \param[in] max_depth the largest depth value kept
+      * \param[out] planes the filtered image (2 * nr_pixels bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    quantizeDepth16 (const char *depth, size_t nr_pixels, uint16_t step, uint16_t max_depth, char *planes);
+
+    /** \brief Undo the "depth16q" filter applied by \ref quantizeDepth16, up to step / 2 depth units.
+      *
+      * Every code is mapped back to the center of its bin (at most max_depth),
+      * and the code of out of range values to max_depth + 1.
+      * \param[in] planes the filtered image (2 * nr_pixels bytes)
+      * \param[in] nr_pixels the number of pixels in the image
+      * \param[in] step the size of a bin, in depth units
+      * \param[in] max_depth the largest depth value kept
+      * \param[out] depth the depth image (2 * nr_pixels bytes)
+      * \ingroup io
+      */
+    PCL_EXPORTS void
+    dequantizeDepth16 (const char *planes, size_t nr_pixels, uint16_t step, uint16_t max_depth, char *depth);
+
+    /** \brief Location of a single frame inside a PCLZS stream file. */
+    struct LZFStreamIndexEntry
+    {
+      /** Offset of the frame record from the beginning of the file */
+      uint64_t offset;
+      /** Capture timestamp, as given to LZFStreamWriter::append */
+      uint64_t timestamp;
+      /** Size of the PCLZF blob (header included) */
+      uint32_t size;
+    };
+
+    /** \brief A single image file recorded in a LZFFrameIndex. */
+    struct LZFFrameIndexEntry
+    {
+      /** Capture timestamp, as given to the writer */
+      uint64_t timestamp;
+      /** Number of the frame among all the frames given to the writer */
+      uint64_t sequence;
+      /** File name of the image, relative to the directory of the index */
+      std::string filename;
+    };
+
+    /** \brief Append-only container holding a sequence of PCLZF images in a single file.
+      *
+      * Writing one file per frame costs an open/truncate/mmap/close cycle and a
+      * new inode per image, which at sensor rates is dominated by filesystem
+      * metadata updates. A PCLZS stream file instead holds all the frames of a
+      * sensor stream:
+      *
+      *  * an 8 byte file header: "PCLZS", a version byte and 2 reserved bytes
+      *  * one record per frame: a 64-bit timestamp, the 32-bit blob size and the
+      *    unmodified PCLZF blob (header + compressed payload)
+      *  * a trailing frame index (offset, timestamp, size for every frame)
+      *  * a 16 byte footer: index offset, number of frames and "PZIX"
+      *
+      * The file is preallocated in large chunks and trimmed to its real size
+      * on \ref close. The frame records are self-delimiting, so a stream whose
+      * writer never got to write the index can still be read back by scanning.
+      *
+      * \note Not thread safe: all calls must come from the same thread.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFStreamWriter
+    {
+      public:
+        /** Empty constructor */
+        LZFStreamWriter ();
+
+        /** Destructor. Closes the stream if still open. */
+        virtual ~LZFStreamWriter ();
+
+        /** \brief Create a new stream file, truncating any existing one.
+          * \param[in] filename the file name to write
+          * \param[in] preallocation_size the number of bytes reserved on disk
+          * at once, each time the stream outgrows its current allocation
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        open (const std::string &filename,
+              uint64_t preallocation_size = 64 * 1024 * 1024);
+
+        /** \brief Append a PCLZF blob to the stream.
+          * \param[in] blob the PCLZF image (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[in] timestamp the capture timestamp of the frame (e.g., in ns)
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        append (const char *blob, uint32_t blob_size, uint64_t timestamp);
+
+        /** \brief Write the frame index, trim the preallocated space and close the file.
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        close ();
+
+        /** \brief Check whether the stream is open for writing. */
+        inline bool
+        isOpen () const
+        {
+          return (fd_ != -1);
+        }
+
+        /** \brief Get the number of frames appended so far. */
+        inline size_t
+        getNumberOfFrames () const
+        {
+          return (index_.size ());
+        }
+
+      protected:
+        /** \brief Make sure that at least \a size bytes are allocated on disk. */
+        bool
+        reserve (uint64_t size);
+
+        /** \brief The file descriptor of the open stream, -1 if closed. */
+        int fd_;
+
+        /** \brief The file name of the open stream. */
+        std::string filename_;
+
+        /** \brief Current end of the frame data. */
+        uint64_t offset_;
+
+        /** \brief Number of bytes allocated on disk. */
+        uint64_t allocated_;
+
+        /** \brief Allocation granularity. */
+        uint64_t preallocation_size_;
+
+        /** \brief In-memory copy of the frame index, written out on close. */
+        std::vector<LZFStreamIndexEntry> index_;
+
+      private:
+        LZFStreamWriter (const LZFStreamWriter&) = delete;
+        LZFStreamWriter& operator = (const LZFStreamWriter&) = delete;
+    };
+
+    /** \brief Random access reader for PCLZS stream files written by LZFStreamWriter.
+      *
+      * The whole file is memory mapped on \ref open, and the frame index is read
+      * from the footer (or rebuilt by scanning the frame records, if the writer
+      * did not close the stream cleanly). Frames are handed out as pointers into
+      * the mapping, which stay valid until the stream is closed.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFStreamReader
+    {
+      public:
+        /** Empty constructor */
+        LZFStreamReader ();
+
+        /** Destructor. Unmaps the stream if still open. */
+        virtual ~LZFStreamReader ();
+
+        /** \brief Map a stream file and load its frame index.
+          * \param[in] filename the file name to read
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        open (const std::string &filename);
+
+        /** \brief Unmap the stream file. */
+        void
+        close ();
+
+        /** \brief Get the number of frames in the stream. */
+        inline size_t
+        getNumberOfFrames () const
+        {
+          return (index_.size ());
+        }
+
+        /** \brief Get the timestamp of a given frame. */
+        inline uint64_t
+        getTimestamp (size_t index) const
+        {
+          return (index_[index].timestamp);
+        }
+
+        /** \brief Get the frame index of the stream. */
+        inline const std::vector<LZFStreamIndexEntry>&
+        getIndex () const
+        {
+          return (index_);
+        }
+
+        /** \brief Get the PCLZF blob of a given frame, without copying it.
+          * \param[in] index the frame number
+          * \param[out] blob pointer to the PCLZF blob inside the mapping
+          * \param[out] blob_size the size of the blob in bytes
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        getFrame (size_t index, const char* &blob, uint32_t &blob_size) const;
+
+        /** \brief Tell the kernel that a range of frames will be read soon, so
+          * that it can start reading them from disk in the background.
+          * \param[in] first the first frame of the range
+          * \param[in] count the number of frames in the range
+          */
+        void
+        willNeed (size_t first, size_t count) const;
+
+        /** \brief Find the frame showing the scene at a given time, i.e. the
+          * last frame captured at or before \a timestamp. O(log n).
+          * \param[in] timestamp the capture time to look up
+          * \param[out] index the frame number
+          * \return false if every frame was captured after \a timestamp
+          */
+        bool
+        findFrame (uint64_t timestamp, size_t &index) const;
+
+        /** \brief Find the frame captured closest to a given time, e.g. to pair
+          * depth and color frames of two streams. O(log n).
+          * \param[in] timestamp the capture time to look up
+          * \param[out] index the frame number
+          * \return false if there are no frames
+          */
+        bool
+        findNearestFrame (uint64_t timestamp, size_t &index) const;
+
+        /** \brief Find all the frames captured in [begin, end). O(log n + m).
+          * \param[in] begin the start of the time range
+          * \param[in] end the end of the time range (excluded)
+          * \param[out] indices the frame numbers, in capture time order
+          * \return the number of frames found
+          */
+        size_t
+        findFrames (uint64_t begin, uint64_t end, std::vector<size_t> &indices) const;
+
+      protected:
+        /** \brief Read the frame index from the stream footer. */
+        bool
+        readIndex ();
+
+        /** \brief Rebuild the frame index by walking the frame records. */
+        bool
+        scanFrames ();
+
+        /** \brief The stream file mapping. */
+        char *map_;
+
+        /** \brief The size of the mapping. */
+        uint64_t map_size_;
+
+        /** \brief The frame index. */
+        std::vector<LZFStreamIndexEntry> index_;
+
+        /** \brief Frame numbers sorted by timestamp, empty if the frames
+          * already are in capture time order (the common case).
+          */
+        std::vector<size_t> time_order_;
+
+      private:
+        LZFStreamReader (const LZFStreamReader&) = delete;
+        LZFStreamReader& operator = (const LZFStreamReader&) = delete;
+    };
+
+    /** \brief Timestamp index of a sequence of PCLZF files, kept as a sidecar file.
+      *
+      * PCLZF headers carry no capture time, so a writer that is given a frame
+      * index (LZFImageWriter::setFrameIndex) records the timestamp and
+      * sequence number of every image it writes. The PCLZI sidecar holds an
+      * 8 byte header ("PCLZI", a version byte and 2 reserved bytes) followed
+      * by one record per image: 64-bit timestamp, 64-bit sequence number,
+      * 16-bit file name length and the file name. Records are appended as the
+      * images are written, so an index survives a crash up to the last image.
+      *
+      * Only file names are stored; the images are expected to live in the
+      * directory of the index. PCLZS streams embed the same information in
+      * their own frame index, see LZFStreamReader.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFFrameIndex
+    {
+      public:
+        /** Empty constructor */
+        LZFFrameIndex ();
+
+        /** Destructor. Closes the index file if still open. */
+        virtual ~LZFFrameIndex ();
+
+        /** \brief Create a new, empty index file, truncating any existing one.
+          * \param[in] filename the file name of the index
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        create (const std::string &filename);
+
+        /** \brief Load an existing index file.
+          * \param[in] filename the file name of the index
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        load (const std::string &filename);
+
+        /** \brief Close the index file. The loaded entries are kept. */
+        void
+        close ();
+
+        /** \brief Record an image, in memory and in the index file if created.
+          * \param[in] filename the file name of the image
+          * \param[in] timestamp the capture timestamp of the image
+          * \param[in] sequence the sequence number of the image
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        append (const std::string &filename, uint64_t timestamp, uint64_t sequence);
+
+        /** \brief Get the number of images in the index. */
+        inline size_t
+        getNumberOfFrames () const
+        {
+          return (entries_.size ());
+        }
+
+        /** \brief Get the record of an image. */
+        inline const LZFFrameIndexEntry&
+        getEntry (size_t index) const
+        {
+          return (entries_[index]);
+        }
+
+        /** \brief Get the path of an image, i.e. its file name in the directory of the index. */
+        std::string
+        getFilename (size_t index) const;
+
+        /** \brief Find the frame showing the scene at a given time, i.e. the
+          * last frame captured at or before \a timestamp. O(log n).
+          * \param[in] timestamp the capture time to look up
+          * \param[out] index the frame number
+          * \return false if every frame was captured after \a timestamp
+          */
+        bool
+        findFrame (uint64_t timestamp, size_t &index) const;
+
+        /** \brief Find the frame captured closest to a given time, e.g. to pair
+          * depth and color frames of two streams. O(log n).
+          * \param[in] timestamp the capture time to look up
+          * \param[out] index the frame number
+          * \return false if there are no frames
+          */
+        bool
+        findNearestFrame (uint64_t timestamp, size_t &index) const;
+
+        /** \brief Find all the frames captured in [begin, end). O(log n + m).
+          * \param[in] begin the start of the time range
+          * \param[in] end the end of the time range (excluded)
+          * \param[out] indices the frame numbers, in capture time order
+          * \return the number of frames found
+          */
+        size_t
+        findFrames (uint64_t begin, uint64_t end, std::vector<size_t> &indices) const;
+
+      protected:
+        /** \brief The file descriptor of a created index, -1 otherwise. */
+        int fd_;
+
+        /** \brief The directory of the index file. */
+        std::string directory_;
+
+        /** \brief The recorded images, in the order they were written. */
+        std::vector<LZFFrameIndexEntry> entries_;
+
+        /** \brief Image numbers sorted by timestamp, empty if the images
+          * already are in capture time order.
+          */
+        std::vector<size_t> time_order_;
+
+      private:
+        LZFFrameIndex (const LZFFrameIndex&) = delete;
+        LZFFrameIndex& operator = (const LZFFrameIndex&) = delete;
+    };
+
+    /** \brief Compression backend of PCL-LZF images.
+      *
+      * LZF is always available and is what the original 37 byte PCLZF header
+      * implies. LZ4 and zstd are available when PCL is built with HAVE_LZ4 /
+      * HAVE_ZSTD (and linked against liblz4 / libzstd); they are recorded in
+      * the codec byte of the extended "PCLZX" header.
+      * \ingroup io
+      */
+    class PCL_EXPORTS ImageCodec
+    {
+      public:
+        /** \brief Codec ids, as stored in the PCLZX header. Never renumber. */
+        enum Id
+        {
+          LZF = 0,
+          LZ4 = 1,
+          ZSTD = 2
+        };
+
+        /** Empty destructor */
+        virtual ~ImageCodec () {}
+
+        /** \brief Get the id of the codec. */
+        virtual Id
+        getId () const = 0;
+
+        /** \brief Get the name of the codec ("lzf", "lz4" or "zstd"). */
+        virtual const char*
+        getName () const = 0;
+
+        /** \brief Compress a buffer.
+          * \param[in] input the array to compress
+          * \param[in] input_size the size of the array to compress
+          * \param[out] output the compressed output array
+          * \param[in] output_size the size of the output array
+          * \return the number of bytes in the output array, 0 if the data did not fit
+          */
+        virtual uint32_t
+        compress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const = 0;
+
+        /** \brief Decompress a buffer.
+          * \param[in] input the array to decompress
+          * \param[in] input_size the size of the array to decompress
+          * \param[out] output the decompressed output array
+          * \param[in] output_size the size of the output array
+          * \return the number of bytes in the output array, 0 on error
+          */
+        virtual uint32_t
+        decompress (const char *input, uint32_t input_size, char *output, uint32_t output_size) const = 0;
+
+        /** \brief Get a codec by id, NULL if it is not available in this build. */
+        static const ImageCodec*
+        get (Id id);
+
+        /** \brief Get a codec by name, NULL if it is unknown or not available in this build. */
+        static const ImageCodec*
+        get (const std::string &name);
+    };
+
+    /** \brief Opt-in latency, throughput and hardware counter statistics for LZF image I/O.
+      *
+      * Attach an instance to writers and readers with setStatistics (). Every
+      * stage of a write (shuffle, compress, file I/O) and of a read (file I/O,
+      * decompress, unshuffle) is then timed into a log2 latency histogram, and
+      * the bytes going in and out of the compressor are counted. Nothing is
+      * recorded, and nothing is paid besides a pointer check, when no instance
+      * is attached.
+      *
+      * All counters are atomic, so one instance can be shared between the
+      * writers and readers of several threads. With \ref setPerfCountersEnabled
+      * the CPU cycles and cache misses of every stage are counted as well,
+      * using perf_event (Linux only; silently zero when unavailable).
+      *
+      * Reads from memory mapped files fault the pages in lazily, so most of the
+      * disk time of a read shows up in the decompress stage.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFIOStatistics
+    {
+      public:
+        /** \brief The instrumented stages. */
+        enum Stage
+        {
+          WRITE_SHUFFLE,      /**< planar reordering or pre-filtering before compression */
+          WRITE_COMPRESS,     /**< LZF compression, header included */
+          WRITE_IO,           /**< writing the compressed image to a file or stream */
+          READ_IO,            /**< mapping and loading the compressed image */
+          READ_DECOMPRESS,    /**< LZF decompression */
+          READ_UNSHUFFLE,     /**< undoing the reordering or pre-filtering */
+          NR_STAGES
+        };
+
+        /** \brief Number of histogram buckets. Bucket i counts the samples in [2^i, 2^(i+1)) ns. */
+        static const int NR_BUCKETS = 40;
+
+        /** \brief A snapshot of the statistics of one stage. */
+        struct StageStatistics
+        {
+          uint64_t count;
+          uint64_t total_ns;
+          uint64_t min_ns;
+          uint64_t max_ns;
+          uint64_t cycles;
+          uint64_t cache_misses;
+          uint64_t histogram[NR_BUCKETS];
+        };
+
+        /** Empty constructor */
+        LZFIOStatistics ();
+
+        /** \brief Count CPU cycles and cache misses of every stage (Linux perf_event). */
+        inline void
+        setPerfCountersEnabled (bool enabled)
+        {
+          perf_counters_.store (enabled);
+        }
+
+        /** \brief Check whether perf_event counters are enabled. */
+        inline bool
+        getPerfCountersEnabled () const
+        {
+          return (perf_counters_.load (std::memory_order_relaxed));
+        }
+
+        /** \brief Record one sample of a stage.
+          * \param[in] stage the stage
+          * \param[in] ns the duration of the stage in nanoseconds
+          * \param[in] cycles the CPU cycles spent in the stage
+          * \param[in] cache_misses the cache misses caused by the stage
+          */
+        void
+        record (Stage stage, uint64_t ns, uint64_t cycles = 0, uint64_t cache_misses = 0);
+
+        /** \brief Count the bytes of one compressed or decompressed image.
+          * \param[in] write true for a write, false for a read
+          * \param[in] raw_bytes the size of the uncompressed image
+          * \param[in] compressed_bytes the size of the compressed image
+          */
+        void
+        addImage (bool write, uint64_t raw_bytes, uint64_t compressed_bytes);
+
+        /** \brief Get a snapshot of the statistics of a stage. */
+        StageStatistics
+        getStageStatistics (Stage stage) const;
+
+        /** \brief Estimate a latency percentile of a stage from its histogram.
+          * \param[in] stage the stage
+          * \param[in] percentile the percentile, in [0, 100]
+          * \return the upper bound of the histogram bucket holding the percentile, in ns
+          */
+        uint64_t
+        getPercentile (Stage stage, double percentile) const;
+
+        /** \brief Get the number of images written (true) or read (false). */
+        inline uint64_t
+        getNumberOfImages (bool write) const
+        {
+          return (images_[write ? 0 : 1].load ());
+        }
+
+        /** \brief Get the number of uncompressed bytes written (true) or read (false). */
+        inline uint64_t
+        getRawBytes (bool write) const
+        {
+          return (raw_bytes_[write ? 0 : 1].load ());
+        }
+
+        /** \brief Get the number of compressed bytes written (true) or read (false). */
+        inline uint64_t
+        getCompressedBytes (bool write) const
+        {
+          return (compressed_bytes_[write ? 0 : 1].load ());
+        }
+
+        /** \brief Clear all statistics. */
+        void
+        reset ();
+
+        /** \brief Get the name of a stage, as used in the JSON output (e.g. "write_compress"). */
+        static const char*
+        getStageName (Stage stage);
+
+        /** \brief Write the statistics as "key": value lines, in the format of the
+          * stats files collected by test_benches/scripts/clct_data.py. Every line,
+          * including the last one, ends with a comma, so more fields can follow.
+          * The latency histograms are flat too: one "<prefix>_<stage>_hist_<lower
+          * bound>_ns" field per non-empty bucket.
+          * \param[out] os the stream to write to
+          * \param[in] prefix prepended to every key
+          */
+        void
+        writeJSON (std::ostream &os, const std::string &prefix = "lzf") const;
+
+        /** \brief Append the output of \ref writeJSON to a stats file.
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        appendToStatsFile (const std::string &filename, const std::string &prefix = "lzf") const;
+
+      protected:
+        struct AtomicStage
+        {
+          std::atomic<uint64_t> count;
+          std::atomic<uint64_t> total_ns;
+          std::atomic<uint64_t> min_ns;
+          std::atomic<uint64_t> max_ns;
+          std::atomic<uint64_t> cycles;
+          std::atomic<uint64_t> cache_misses;
+          std::atomic<uint64_t> histogram[NR_BUCKETS];
+        };
+
+        AtomicStage stages_[NR_STAGES];
+
+        /** \brief Image and byte counters, [0] for writes and [1] for reads. */
+        std::atomic<uint64_t> images_[2];
+        std::atomic<uint64_t> raw_bytes_[2];
+        std::atomic<uint64_t> compressed_bytes_[2];
+
+        std::atomic<bool> perf_counters_;
+
+      private:
+        LZFIOStatistics (const LZFIOStatistics&) = delete;
+        LZFIOStatistics& operator = (const LZFIOStatistics&) = delete;
+    };
+
+    /** \brief Picks how hard a writer compresses every image, given a latency budget.
+      *
+      * Attach an instance to a writer with LZFImageWriter::setCompressionController ().
+      * Every image is then encoded at one of three levels:
+      *
+      *  * FULL: the writer's pre-filter and codec, as without a controller
+      *  * FAST: no optional pre-filter (depth deltas are dropped, the planar
+      *    reordering of rgb24/yuv422 is part of the format and kept) and the
+      *    fastest codec of the build (LZ4, else LZF)
+      *  * STORED: no compression at all. The image is written with the extended
+      *    header, its stored flag set and a single band holding the raw data,
+      *    which every reader of the extended header understands.
+      *
+      * The controller keeps a moving average of the encode time per byte and
+      * of the compression ratio of every level, and picks the best compressing
+      * level expected to fit the budget. Levels whose ratio falls below the
+      * minimum (noise, already compressed data) are skipped. Estimates of the
+      * levels above the current one go stale, so every \a probe_interval images
+      * the next better level is tried once, e.g. to notice that the CPU got
+      * faster again. A compression failure is retried as a stored image rather
+      * than failing the write.
+      *
+      * \note Not thread safe: use one controller per writer.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFCompressionController
+    {
+      public:
+        /** \brief Compression levels, from the smallest to the fastest output. */
+        enum Level
+        {
+          FULL,       /**< pre-filter and the writer's codec */
+          FAST,       /**< no optional pre-filter, fastest codec */
+          STORED,     /**< no compression */
+          NR_LEVELS
+        };
+
+        /** \brief Constructor.
+          * \param[in] latency_budget_ms the time an image may take to encode, in milliseconds
+          * \param[in] min_compression_ratio the ratio below which compressing is not worth it
+          */
+        LZFCompressionController (double latency_budget_ms = 5.0,
+                                  double min_compression_ratio = 1.1);
+
+        /** \brief Set the time an image may take to encode, in milliseconds. */
+        inline void
+        setLatencyBudget (double latency_budget_ms)
+        {
+          latency_budget_ms_ = latency_budget_ms;
+        }
+
+        /** \brief Get the time an image may take to encode, in milliseconds. */
+        inline double
+        getLatencyBudget () const
+        {
+          return (latency_budget_ms_);
+        }
+
+        /** \brief Set the compression ratio below which compressing is not worth it. */
+        inline void
+        setMinCompressionRatio (double min_compression_ratio)
+        {
+          min_compression_ratio_ = min_compression_ratio;
+        }
+
+        /** \brief Get the compression ratio below which compressing is not worth it. */
+        inline double
+        getMinCompressionRatio () const
+        {
+          return (min_compression_ratio_);
+        }
+
+        /** \brief Set how often (in images) a better level than the current one is tried. */
+        inline void
+        setProbeInterval (unsigned int probe_interval)
+        {
+          probe_interval_ = std::max (probe_interval, 1u);
+        }
+
+        /** \brief Get how often (in images) a better level than the current one is tried. */
+        inline unsigned int
+        getProbeInterval () const
+        {
+          return (probe_interval_);
+        }
+
+        /** \brief Pick the level of the next image.
+          * \param[in] image_size the size of the uncompressed image in bytes
+          */
+        Level
+        select (size_t image_size);
+
+        /** \brief Account for an encoded image.
+          * \param[in] level the level the image was encoded at
+          * \param[in] image_size the size of the uncompressed image in bytes
+          * \param[in] blob_size the size of the PCLZF blob, 0 if the encoding failed,
+          * which counts as an image that did not compress
+          * \param[in] elapsed_ms the time the encoding took, in milliseconds
+          */
+        void
+        update (Level level, size_t image_size, size_t blob_size, double elapsed_ms);
+
+        /** \brief Forget all the estimates and counts. */
+        void
+        reset ();
+
+        /** \brief Get the level of the last image. */
+        inline Level
+        getLevel () const
+        {
+          return (level_);
+        }
+
+        /** \brief Get the number of images encoded at a given level. */
+        inline uint64_t
+        getNumberOfFrames (Level level) const
+        {
+          return (nr_frames_[level]);
+        }
+
+        /** \brief Get the estimated encode time of a given level, in ms per MB (0 if unknown). */
+        inline double
+        getEstimatedCost (Level level) const
+        {
+          return (ms_per_mb_[level]);
+        }
+
+        /** \brief Get the estimated compression ratio of a given level (0 if unknown). */
+        inline double
+        getEstimatedRatio (Level level) const
+        {
+          return (ratio_[level]);
+        }
+
+      protected:
+        double latency_budget_ms_;
+        double min_compression_ratio_;
+        unsigned int probe_interval_;
+
+        /** \brief Moving averages of the encode time per MB and of the
+          * compression ratio of every level, 0 until a level is used.
+          */
+        double ms_per_mb_[NR_LEVELS];
+        double ratio_[NR_LEVELS];
+
+        uint64_t nr_frames_[NR_LEVELS];
+        unsigned int frames_since_probe_;
+        Level level_;
+    };
+
+    /** \brief PCL-LZF image format reader.
+      * The PCL-LZF image format is nothing else but a LZF-modified compression over
+      * an existing file type (e.g., PNG). However, in certain situations, like RGB data for
+      * example, an [RGBRGB...RGB] array will be first reordered into [RR...RGG...GBB...B]
+      * in order to ensure better compression.
+      *
+      * The current list of compressors/decompressors include:
+      *  * LZF compressed 24-bit [RR...RGG...GBB...B] data
+      *  * LZF compressed 8-bit Bayer data
+      *  * LZF compressed 16-bit YUV422 data
+      *  * LZF compressed 16-bit depth data
+      *
+      * Please note that files found using the above mentioned extensions will be treated
+      * as such. Inherit from this class and overwrite the I/O methods if you plan to change
+      * this behavior.
+      *
+      * The main advantage of using the PCL-LZF image I/O routines is a very good file size
+      * versus I/O speed ratio. Tests performed using LZF, Snappy, ZIP, GZ2, BZIP2, as well
+      * as PNG, JPEG, and TIFF compression have shown that the internal PCL LZF methods
+      * provide the best score for the types of applications PCL is suited for.
+      *
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFImageReader
+    {
+      public:
+        /** Empty constructor */
+        LZFImageReader ();
+        /** Empty destructor */
+        virtual ~LZFImageReader () {}
+
+        /** \brief Numeric values of a parameters file, indexed by their XML path
+          * (e.g. "depth.focal_length_x").
+          */
+        typedef std::map<std::string, double> ParameterMap;
+
+        /** \brief Read camera parameters from a given file and store them internally.
+          *
+          * Parsed files are kept in a process wide cache and only parsed again
+          * once their modification time or size change, so reading the same
+          * parameters file for every frame of a sequence is cheap.
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        readParameters (const std::string &filename);
+
+        /** \brief Drop all parameters files from the cache used by \ref readParameters. */
+        static void
+        clearParametersCache ();
+
+        /** \brief Read the parameters from a struct instead
+          * \param[in] parameters Camera parameters to use */
+        inline void
+        setParameters (const CameraParameters &parameters)
+        {
+          parameters_ = parameters;
+        }
+
+        /** \brief Get the camera parameters currently being used
+          * returns a CameraParameters struct */
+        inline CameraParameters
+        getParameters () const
+        {
+          return parameters_;
+        }
+
+        /** \brief Get the image width as read from disk. */
+        inline uint32_t
+        getWidth () const
+        {
+          return (width_);
+        }
+
+        /** \brief Get the image height as read from disk. */
+        inline uint32_t
+        getHeight () const
+        {
+          return (height_);
+        }
+
+        /** \brief Get the type of the image read from disk. */
+        inline std::string
+        getImageType () const
+        {
+          return (image_type_identifier_);
+        }
+
+        /** \brief Get the codec of the image read from disk. */
+        inline const ImageCodec*
+        getCodec () const
+        {
+          return (codec_);
+        }
+
+        /** \brief Set the number of threads used to decompress banded images.
+          * \param[in] nr_threads the number of threads. 0 indicates OpenMP is free to choose.
+          */
+        inline void
+        setNumberOfThreads (unsigned int nr_threads)
+        {
+          nr_threads_ = nr_threads;
+        }
+
+        /** \brief Record the timings of every read into a statistics object.
+          * \param[in] statistics the statistics to update, NULL (default) to disable
+          * the instrumentation. The object has to outlive the reader.
+          */
+        inline void
+        setStatistics (LZFIOStatistics *statistics)
+        {
+          statistics_ = statistics;
+        }
+
+        /** \brief Decompress a PCLZF image held in memory straight into a caller provided buffer.
+          *
+          * The header is parsed in place and the payload is decompressed
+          * directly from \a blob, which can point into a file mapping owned by
+          * the caller (e.g., a frame handed out by LZFStreamReader::getFrame).
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[out] output the buffer receiving the uncompressed data
+          * \param[in] output_size the size of \a output, which must match the
+          * uncompressed size stored in the header
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        read (const char *blob, size_t blob_size,
+              char *output, uint32_t output_size);
+
+        /** \brief Decompress a PCLZF image held in memory, resizing the output as needed.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[out] output the uncompressed image data
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        read (const char *blob, size_t blob_size,
+              std::vector<char> &output);
+
+        /** \brief Decompress a PCLZF file straight from its memory mapping.
+          *
+          * Unlike \ref loadImageBlob followed by \ref decompress, the compressed
+          * payload is never copied out of the mapping.
+          * \param[in] filename the file name to read the data from
+          * \param[out] output the uncompressed image data
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        read (const std::string &filename,
+              std::vector<char> &output);
+
+        /** \brief Decompress a frame stored in a PCLZS stream.
+          *
+          * Frames of a temporal ("depth16t") depth stream depend on the frame
+          * before them. When the previous frame was not the last one read by
+          * this reader, the frames since the last keyframe are decoded first,
+          * so any frame can be accessed at the cost of at most a keyframe
+          * interval of decompressions.
+          * \param[in] stream the stream to read the frame from
+          * \param[in] index the frame number
+          * \param[out] output the uncompressed image data, in the same layout
+          * that \ref decompress produces for a single PCLZF file
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        read (const LZFStreamReader &stream, size_t index,
+              std::vector<char> &output);
+
+        /** \brief Decompress a single level of an image written with pyramid levels.
+          *
+          * Only the requested level is decompressed, which for the coarse levels
+          * is a small fraction of the work of reading the full image.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[in] level the level to read, 0 being the full resolution image
+          * \param[out] output the uncompressed level data
+          * \param[out] width the width of the level
+          * \param[out] height the height of the level
+          * \return false if the image has no such level or on error
+          */
+        bool
+        readLevel (const char *blob, size_t blob_size, unsigned int level,
+                   std::vector<char> &output, uint32_t &width, uint32_t &height);
+
+        /** \brief Get the number of pyramid levels (full resolution excluded) of the last image read. */
+        inline unsigned int
+        getNumberOfLevels () const
+        {
+          return (static_cast<unsigned int> (levels_.size ()));
+        }
+
+      protected:
+        /** \brief Location of a pyramid level in the last image read. */
+        struct Level
+        {
+          uint32_t width;
+          uint32_t height;
+          /** Decimation factor with respect to the full resolution image */
+          uint32_t scale;
+          /** Offset of the compressed level from the beginning of the blob */
+          uint32_t offset;
+          uint32_t compressed_size;
+          uint32_t uncompressed_size;
+        };
+
+        /** \brief Read camera parameters from a given stream and store them internally.
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        readParameters (std::istream&) { return (false); }
+
+        /** \brief Read camera parameters from the parsed values of a parameters file.
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        readParameters (const ParameterMap&) { return (false); }
+
+        /** \brief Load a compressed image array from disk
+          * \param[in] filename the file name to load the data from
+          * \param[out] data the size of the data
+          * \param uncompressed_size
+          * \return an array filled with the data loaded from disk, NULL if error
+          */
+        bool
+        loadImageBlob (const std::string &filename,
+                       std::vector<char> &data,
+                       uint32_t &uncompressed_size);
+
+        /** \brief Load a compressed image array from a PCLZF blob held in memory.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[out] data the compressed data
+          * \param[out] uncompressed_size the size of the data once decompressed
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        loadImageBlob (const char *blob, size_t blob_size,
+                       std::vector<char> &data,
+                       uint32_t &uncompressed_size);
+
+        /** \brief Parse the header of a PCLZF blob in place.
+          *
+          * Sets the image width, height and type.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[out] payload pointer to the compressed data inside \a blob
+          * \param[out] compressed_size the size of the compressed data
+          * \param[out] uncompressed_size the size of the data once decompressed
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        readHeader (const char *blob, size_t blob_size,
+                    const char* &payload,
+                    uint32_t &compressed_size,
+                    uint32_t &uncompressed_size);
+
+        /** \brief Realtime LZF decompression between raw buffers.
+          *
+          * Images written with a pre-filter (e.g. "depth16d") are unfiltered,
+          * so the output always holds the original image ("depth16q" images:
+          * the quantized one). "depth16t" images are unfiltered against the
+          * last depth16d/depth16q/depth16t image decoded by this reader, i.e.
+          * the frames of a temporal stream have to be read in order (or through \ref read (const LZFStreamReader&, size_t, std::vector<char>&)).
+          * Temporal images carrying the hash of their reference are rejected
+          * if it does not match that last image.
+          * \param[in] input the array to decompress
+          * \param[in] input_size the size of the array to decompress
+          * \param[out] output the decompressed array
+          * \param[in] output_size the expected size of the decompressed data
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        decompress (const char *input, uint32_t input_size,
+                    char *output, uint32_t output_size);
+
+        /** \brief Decompress the image data as stored, i.e. without undoing any pre-filter.
+          * \param[in] input the array to decompress
+          * \param[in] input_size the size of the array to decompress
+          * \param[out] output the decompressed array
+          * \param[in] output_size the expected size of the decompressed data
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        decompressData (const char *input, uint32_t input_size,
+                        char *output, uint32_t output_size);
+
+        /** \brief Decompress the bands of an image stored with the extended PCLZX header.
+          * \param[in] input the array to decompress
+          * \param[in] input_size the size of the array to decompress
+          * \param[out] output the decompressed array
+          * \param[in] output_size the expected size of the decompressed data
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        decompressBands (const char *input, uint32_t input_size,
+                         char *output, uint32_t output_size);
+
+        /** \brief Check the band table against the data sizes and compute the band offsets. */
+        bool
+        computeBandOffsets (uint32_t input_size, uint32_t output_size);
+
+        /** \brief Realtime LZF decompression.
+          *
+          * Decompresses data. The decompressed data is written to the output
+          * array. Returns true if the decompression was successful.
+          *
+          * \param[in] input the array to decompress
+          * \param[out] output the decompressed array
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        decompress (const std::vector<char> &input,
+                    std::vector<char> &output);
+
+        /** \brief The image width, as read from the file. */
+        uint32_t width_;
+
+        /** \brief The image height, as read from the file. */
+        uint32_t height_;
+
+        /** \brief The image type string, as read from the file. */
+        std::string image_type_identifier_;
+
+        /** \brief Internal set of camera parameters. */
+        CameraParameters parameters_;
+
+        /** \brief Scratch buffer for images decompressed on their way into a point cloud. */
+        std::vector<char> uncompressed_buffer_;
+
+        /** \brief Number of threads used for banded decompression, 0 to let OpenMP decide. */
+        unsigned int nr_threads_;
+
+        /** \brief Uncompressed bytes per band of the last image read, 0 if not banded. */
+        uint32_t band_size_;
+
+        /** \brief Compressed size of every band of the last image read. */
+        std::vector<uint32_t> band_table_;
+
+        /** \brief Offset of every band in the compressed data of the last image read. */
+        std::vector<uint32_t> band_offsets_;
+
+        /** \brief Scratch buffer for images that have to be unfiltered after decompression. */
+        std::vector<char> filter_buffer_;
+
+        /** \brief Optional instrumentation, NULL if disabled. */
+        LZFIOStatistics *statistics_;
+
+        /** \brief Codec of the last image read. */
+        const ImageCodec *codec_;
+
+        /** \brief Pyramid levels of the last image read. */
+        std::vector<Level> levels_;
+
+        /** \brief Bin size and largest depth value of the last image read, if quantized, 0 otherwise. */
+        uint32_t quantization_step_;
+        uint32_t quantization_max_depth_;
+
+        /** \brief Hash of the image a depth16t image was taken against, as read from its header. */
+        uint64_t reference_hash_;
+        bool has_reference_hash_;
+
+        /** \brief Last depth16d/depth16q/depth16t image decoded, the reference of the next depth16t image. */
+        std::vector<char> reference_;
+
+        /** \brief Stream and frame number \ref reference_ was read from, NULL if unknown. */
+        const LZFStreamReader *reference_stream_;
+        size_t reference_index_;
+    };
+
+    /** \brief PCL-LZF 16-bit depth image format reader.
+      *
+      * The size of the uncompressed data has to be width * height * 2 bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFDepth16ImageReader : public LZFImageReader
+    {
+      public:
+        using LZFImageReader::readParameters;
+        using LZFImageReader::read;
+        using LZFImageReader::readLevel;
+
+        /** Empty constructor */
+        LZFDepth16ImageReader ()
+          : z_multiplication_factor_ (0.001)      // Set default multiplication factor
+          , x_factors_ ()
+        {}
+
+        /** Empty destructor */
+        virtual ~LZFDepth16ImageReader () {}
+
+        /** \brief Read the data stored in a PCLZF depth file and convert it to a pcl::PointCloud type.
+          * \param[in] filename the file name to read the data from
+          * \param[out] cloud the resultant output point cloud
+          */
+        template <typename PointT> bool
+        read (const std::string &filename, pcl::PointCloud<PointT> &cloud);
+
+        /** \brief Read the data stored in a PCLZF depth file and convert it to a pcl::PointCloud type.
+          * \param[in] filename the file name to read the data from
+          * \param[in] num_threads The number of threads to use. 0 indicates OpenMP is free to choose.
+          * \param[out] cloud the resultant output point cloud
+          */
+        template <typename PointT> bool
+        readOMP (const std::string &filename, pcl::PointCloud<PointT> &cloud,
+                 unsigned int num_threads=0);
+
+        /** \brief Convert a PCLZF depth image held in memory to a pcl::PointCloud type.
+          *
+          * The payload is decompressed directly from \a blob, without first
+          * copying it out, e.g., of a file mapping or a PCLZS stream.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[out] cloud the resultant output point cloud
+          */
+        template <typename PointT> bool
+        read (const char *blob, size_t blob_size, pcl::PointCloud<PointT> &cloud);
+
+        /** \brief Decompress a PCLZF depth image straight into an organized XYZ point cloud.
+          *
+          * Decompression and projection are fused: banded images are projected
+          * band by band while the band is still in cache, in parallel, and no
+          * full size depth buffer is needed. Points outside [min_depth,
+          * max_depth], as well as invalid (0) depth values, are set to NaN.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[out] cloud the resultant organized point cloud
+          * \param[in] min_depth the minimum depth (z) of a valid point
+          * \param[in] max_depth the maximum depth (z) of a valid point
+          * \param[in] stride only every stride-th column of every stride-th row
+          * is projected, i.e. the cloud is (width / stride) x (height / stride)
+          * (rounded up)
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        read (const char *blob, size_t blob_size,
+              pcl::PointCloud<pcl::PointXYZ> &cloud,
+              float min_depth, float max_depth,
+              unsigned int stride = 1);
+
+        /** \brief Decompress a PCLZF depth file straight into an organized XYZ point cloud.
+          * \param[in] filename the file name to read the data from
+          * \param[out] cloud the resultant organized point cloud
+          * \param[in] min_depth the minimum depth (z) of a valid point
+          * \param[in] max_depth the maximum depth (z) of a valid point
+          * \param[in] stride the decimation factor in both directions
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        read (const std::string &filename,
+              pcl::PointCloud<pcl::PointXYZ> &cloud,
+              float min_depth, float max_depth,
+              unsigned int stride = 1);
+
+        /** \brief Project a single pyramid level of a PCLZF depth image into an organized XYZ point cloud.
+          *
+          * Every point of a coarse level stands for a block of pixels and is
+          * projected through the center of the block, with the minimum (i.e.,
+          * closest) valid depth of the block.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[in] level the level to read, 0 being the full resolution image
+          * \param[out] cloud the resultant organized point cloud
+          * \param[in] min_depth the minimum depth (z) of a valid point
+          * \param[in] max_depth the maximum depth (z) of a valid point
+          * \return false if the image has no such level or on error
+          */
+        bool
+        readLevel (const char *blob, size_t blob_size, unsigned int level,
+                   pcl::PointCloud<pcl::PointXYZ> &cloud,
+                   float min_depth, float max_depth);
+
+        /** \brief Read camera parameters from a given stream and store them internally.
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        readParameters (std::istream& is);
+
+        /** \brief Read camera parameters from the parsed values of a parameters file.
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        readParameters (const ParameterMap &values);
+
+        /** \brief Get the largest depth error (in meters) of the last image read, 0 if it was not quantized. */
+        inline double
+        getQuantizationError () const
+        {
+          return ((quantization_step_ / 2) * z_multiplication_factor_);
+        }
+
+        /** \brief Get the largest depth (in meters) kept by the last image read, 0 if it was not quantized.
+          *
+          * Depth values beyond this range were written as this range plus one unit.
+          */
+        inline double
+        getQuantizationRange () const
+        {
+          return (quantization_max_depth_ * z_multiplication_factor_);
+        }
+
+      protected:
+        /** \brief Z-value depth multiplication factor
+          * (i.e., if raw data is in [mm] and we want [m], we need to multiply with 0.001)
+          */
+        double z_multiplication_factor_;
+
+        /** \brief (u - principal_point_x) / focal_length_x of every projected column. */
+        std::vector<float> x_factors_;
+    };
+
+    /** \brief PCL-LZF 24-bit RGB image format reader.
+      *
+      * The size of the uncompressed data has to be width * height * 3 bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFRGB24ImageReader : public LZFImageReader
+    {
+      public:
+        using LZFImageReader::readParameters;
+        using LZFImageReader::read;
+
+        /** Empty constructor */
+        LZFRGB24ImageReader () {}
+        /** Empty destructor */
+        virtual ~LZFRGB24ImageReader () {}
+
+        /** \brief Read the data stored in a PCLZF RGB file and convert it to a pcl::PointCloud type.
+          * \param[in] filename the file name to read the data from
+          * \param[out] cloud the resultant output point cloud
+          */
+        template<typename PointT> bool
+        read (const std::string &filename, pcl::PointCloud<PointT> &cloud);
+
+        /** \brief Read the data stored in a PCLZF RGB file and convert it to a pcl::PointCloud type.
+          * Note that, unless massively multithreaded, this will likely not result in a significant speedup and may even slow down reading.
+          * \param[in] filename the file name to read the data from
+          * \param[in] num_threads The number of threads to use
+          * \param[out] cloud the resultant output point cloud
+          */
+        template <typename PointT> bool
+        readOMP (const std::string &filename, pcl::PointCloud<PointT> &cloud,
+                 unsigned int num_threads=0);
+
+        /** \brief Decompress a PCLZF color image held in memory back into its interleaved layout.
+          *
+          * rgb24 images are returned as [RGBRGB...RGB] and yuv422 images as
+          * [UYVY...UYVY], i.e., exactly what was given to the writer. Other
+          * image types are returned as stored.
+          * \param[in] blob the PCLZF blob (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[out] output the interleaved image
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        readInterleaved (const char *blob, size_t blob_size,
+                         std::vector<char> &output);
+
+        /** \brief Read camera parameters from a given stream and store them internally.
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        readParameters (std::istream& is);
+
+        /** \brief Read camera parameters from the parsed values of a parameters file.
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        readParameters (const ParameterMap &values);
+
+      protected:
+    };
+
+    /** \brief PCL-LZF 8-bit Bayer image format reader.
+      *
+      * The size of the uncompressed data has to be width * height * 2 bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFYUV422ImageReader : public LZFRGB24ImageReader
+    {
+      public:
+        using LZFRGB24ImageReader::readParameters;
+        using LZFRGB24ImageReader::read;
+
+        /** Empty constructor */
+        LZFYUV422ImageReader () {}
+        /** Empty destructor */
+        virtual ~LZFYUV422ImageReader () {}
+
+        /** \brief Read the data stored in a PCLZF YUV422 16bit file and convert it to a pcl::PointCloud type.
+          * \param[in] filename the file name to read the data from
+          * \param[out] cloud the resultant output point cloud
+          */
+        template<typename PointT> bool
+        read (const std::string &filename, pcl::PointCloud<PointT> &cloud);
+
+        /** \brief Read the data stored in a PCLZF YUV422 file and convert it to a pcl::PointCloud type.
+          * Note that, unless massively multithreaded, this will likely not result in a significant speedup
+          * \param[in] filename the file name to read the data from
+          * \param[in] num_threads The number of threads to use
+          * \param[out] cloud the resultant output point cloud
+          */
+        template <typename PointT> bool
+        readOMP (const std::string &filename, pcl::PointCloud<PointT> &cloud,
+                 unsigned int num_threads=0);
+    };
+
+    /** \brief PCL-LZF 8-bit Bayer image format reader.
+      *
+      * The size of the uncompressed data has to be width * height bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFBayer8ImageReader : public LZFRGB24ImageReader
+    {
+      public:
+        using LZFRGB24ImageReader::readParameters;
+        using LZFRGB24ImageReader::read;
+
+        /** Empty constructor */
+        LZFBayer8ImageReader () {}
+        /** Empty destructor */
+        virtual ~LZFBayer8ImageReader () {}
+
+        /** \brief Read the data stored in a PCLZF Bayer 8bit file and convert it to a pcl::PointCloud type.
+          * \param[in] filename the file name to read the data from
+          * \param[out] cloud the resultant output point cloud
+          */
+        template<typename PointT> bool
+        read (const std::string &filename, pcl::PointCloud<PointT> &cloud);
+
+        /** \brief Read the data stored in a PCLZF Bayer 8bit file and convert it to a pcl::PointCloud type.
+          * Note that, unless massively multithreaded, this will likely not result in a significant speedup and may even slow down reading.
+          * \param[in] filename the file name to read the data from
+          * \param[in] num_threads The number of threads to use
+          * \param[out] cloud the resultant output point cloud
+          */
+        template <typename PointT> bool
+        readOMP (const std::string &filename, pcl::PointCloud<PointT> &cloud,
+                 unsigned int num_threads=0);
+    };
+
+    /** \brief In-memory batch of camera/image parameters destined for XML files.
+      *
+      * LZFImageWriter::writeParameter and writeParameters parse and rewrite the
+      * whole XML file on every call. Passing a session instead records the
+      * values in memory; each touched file is parsed once, on first use, and
+      * written once per \ref sync (or when the session is destroyed).
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFParameterSession
+    {
+      public:
+        /** Empty constructor */
+        LZFParameterSession ();
+
+        /** \brief Destructor. Writes all modified files. */
+        ~LZFParameterSession ();
+
+        /** \brief Set a parameter value.
+          * \param[in] filename the XML file the parameter belongs to
+          * \param[in] tag the XML path of the parameter (e.g. "depth.focal_length_x")
+          * \param[in] value the value of the parameter
+          */
+        void
+        put (const std::string &filename, const std::string &tag, double value);
+
+        /** \brief Write all files modified since the last sync to disk.
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        sync ();
+
+        /** \brief Get the number of files with values not written to disk yet. */
+        size_t
+        getNumberOfModifiedFiles () const;
+
+      protected:
+        /** \brief The in-memory contents of one XML file. */
+        struct Document;
+
+        /** \brief Documents, indexed by file name. */
+        std::map<std::string, boost::shared_ptr<Document> > documents_;
+
+      private:
+        LZFParameterSession (const LZFParameterSession&) = delete;
+        LZFParameterSession& operator = (const LZFParameterSession&) = delete;
+    };
+
+    class LZFFlightRecorder;
+    class LZFSharedRingWriter;
+
+    /** \brief PCL-LZF image format writer.
+      * The PCL-LZF image format is nothing else but a LZF-modified compression over
+      * an existing file type (e.g., PNG). However, in certain situations, like RGB data for
+      * example, an [RGBRGB...RGB] array will be first reordered into [RR...RGG...GBB...B]
+      * in order to ensure better compression.
+      *
+      * The current list of compressors/decompressors include:
+      *  * LZF compressed 24-bit [RR...RGG...GBB...B] data
+      *  * LZF compressed 8-bit Bayer data
+      *  * LZF compressed 16-bit YUV422 data
+      *  * LZF compressed 16-bit depth data
+      *
+      * Please note that files found using the above mentioned extensions will be treated
+      * as such. Inherit from this class and overwrite the I/O methods if you plan to change
+      * this behavior.
+      *
+      * The main advantage of using the PCL-LZF image I/O routines is a very good file size
+      * versus I/O speed ratio. Tests performed using LZF, Snappy, ZIP, GZ2, BZIP2, as well
+      * as PNG, JPEG, and TIFF compression have shown that the internal PCL LZF methods
+      * provide the best score for the types of applications PCL is suited for.
+      *
+      * Writers keep the scratch buffers used for reordering and compressing an
+      * image between calls, so writing a stream of images of the same size does
+      * not allocate any memory after the first one. As a consequence, a writer
+      * instance must not be shared between threads.
+      *
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFImageWriter
+    {
+      public:
+        /** Empty constructor */
+        LZFImageWriter ()
+          : compressed_buffer_ ()
+          , shuffle_buffer_ ()
+          , pyramid_ ()
+          , quantization_step_ (0)
+          , quantization_max_depth_ (0)
+          , reference_hash_ (0)
+          , has_reference_hash_ (false)
+          , band_rows_ (0)
+          , nr_threads_ (0)
+          , statistics_ (NULL)
+          , codec_ (ImageCodec::get (ImageCodec::LZF))
+          , frame_index_ (NULL)
+          , sequence_ (0)
+          , controller_ (NULL)
+          , level_ (LZFCompressionController::FULL)
+        {}
+        /** Empty destructor */
+        virtual ~LZFImageWriter () {}
+
+        /** \brief Save an image into PCL-LZF format. Virtual.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               const std::string &filename) = 0;
+
+        /** \brief Save an image into PCL-LZF format and record its capture time.
+          *
+          * If a frame index is set, the image is recorded in it together with
+          * its timestamp and sequence number. The sequence number counts every
+          * image given to this method, so gaps in an index mark failed writes.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write
+          * \param[in] timestamp the capture timestamp of the image (e.g., in ns)
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               const std::string &filename,
+               uint64_t timestamp);
+
+        /** \brief Write camera parameters to disk. Virtual.
+          * \param[in] parameters the camera parameters
+          * \param[in] filename the file name to write
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        writeParameters (const CameraParameters &parameters,
+                         const std::string &filename) = 0;
+
+        /** \brief Record camera parameters in a parameter session. Virtual.
+          * \param[in] parameters the camera parameters
+          * \param[in] session the session collecting the parameters
+          * \param[in] filename the file name the parameters are written to on sync
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        writeParameters (const CameraParameters &parameters,
+                         LZFParameterSession &session,
+                         const std::string &filename) = 0;
+
+        /** \brief Save an image and its camera parameters into PCL-LZF format.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] parameters the camera parameters
+          * \param[in] filename_data the file name to write the data to
+          * \param[in] filename_xml the file name to write the parameters to
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               const CameraParameters &parameters,
+               const std::string &filename_data,
+               const std::string &filename_xml)
+        {
+          bool res1 = write (data, width, height, filename_data);
+          bool res2 = writeParameters (parameters, filename_xml);
+          return (res1 && res2);
+        }
+
+        /** \brief Append an image to a PCLZS stream instead of writing it to its own file.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] stream the open stream to append the image to
+          * \param[in] timestamp the capture timestamp of the image
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               LZFStreamWriter &stream,
+               uint64_t timestamp);
+
+        /** \brief Compress an image into the ring of a flight recorder.
+          *
+          * Nothing touches the disk; the image only reaches a file if the
+          * recorder is triggered while it is still in the ring. Once the
+          * writer's buffers have grown to the image size, this does not
+          * allocate memory or take locks.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] recorder the recorder to add the image to
+          * \param[in] timestamp the capture timestamp of the image (e.g., in ns)
+          * \return true if operation successful, false if the image was dropped
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               LZFFlightRecorder &recorder,
+               uint64_t timestamp);
+
+        /** \brief Publish an image to the readers of a shared memory ring.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] ring the open ring to publish the image to
+          * \param[in] timestamp the capture timestamp of the image
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               LZFSharedRingWriter &ring,
+               uint64_t timestamp);
+
+        /** \brief Write a single image/camera parameter to file, given an XML tag
+          * \param[in] parameter the value of the parameter to write
+          * \param[in] tag the value of the XML tag
+          * \param[in] filename the file name to write
+          * \return true if operation successful, false otherwise
+          * Example:
+          * \code
+          * pcl::io::LZFDepthImageWriter w;
+          * w.writeParameter (0.001, "depth.multiplication_factor", "parameters.xml");
+          * \endcode
+          */
+        bool
+        writeParameter (const double &parameter, const std::string &tag,
+                        const std::string &filename);
+
+        /** \brief Record a single image/camera parameter in a parameter session.
+          * \param[in] parameter the value of the parameter to write
+          * \param[in] tag the value of the XML tag
+          * \param[in] session the session collecting the parameters
+          * \param[in] filename the file name the parameter is written to on sync
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        writeParameter (const double &parameter, const std::string &tag,
+                        LZFParameterSession &session,
+                        const std::string &filename);
+
+        /** \brief Split images into independently compressed bands of rows.
+          *
+          * Banded images are written with the extended "PCLZX" header, which
+          * holds the size of every compressed band, and the bands are
+          * compressed (and later decompressed) in parallel. Readers of this
+          * version accept both header variants.
+          * \param[in] band_rows the number of image rows per band. 0 (default)
+          * writes a single band with the original 37 byte PCLZF header, or a
+          * single extended band when a codec other than LZF is selected.
+          */
+        inline void
+        setBandRows (uint32_t band_rows)
+        {
+          band_rows_ = band_rows;
+        }
+
+        /** \brief Get the number of image rows per compressed band (0 if banding is disabled). */
+        inline uint32_t
+        getBandRows () const
+        {
+          return (band_rows_);
+        }
+
+        /** \brief Select the compression backend.
+          *
+          * Images compressed with anything but LZF are written with the extended
+          * "PCLZX" header, which older readers do not understand.
+          * \param[in] id the codec id
+          * \return false if the codec is not available in this build (LZF is kept)
+          */
+        bool
+        setCodec (ImageCodec::Id id);
+
+        /** \brief Get the compression backend. */
+        inline const ImageCodec*
+        getCodec () const
+        {
+          return (codec_);
+        }
+
+        /** \brief Set the number of threads used to compress the bands of an image.
+          * \param[in] nr_threads the number of threads. 0 indicates OpenMP is free to choose.
+          */
+        inline void
+        setNumberOfThreads (unsigned int nr_threads)
+        {
+          nr_threads_ = nr_threads;
+        }
+
+        /** \brief Record the images written with a timestamp into a frame index.
+          * \param[in] frame_index the index to update, NULL (default) to disable.
+          * The index has to outlive the writer.
+          */
+        inline void
+        setFrameIndex (LZFFrameIndex *frame_index)
+        {
+          frame_index_ = frame_index;
+        }
+
+        /** \brief Record the timings of every write into a statistics object.
+          * \param[in] statistics the statistics to update, NULL (default) to disable
+          * the instrumentation. The object has to outlive the writer.
+          */
+        inline void
+        setStatistics (LZFIOStatistics *statistics)
+        {
+          statistics_ = statistics;
+        }
+
+        /** \brief Adapt the compression of every image to a latency budget.
+          * \param[in] controller the controller picking the compression level of
+          * every image, NULL (default) to always compress fully. The controller
+          * has to outlive the writer.
+          */
+        inline void
+        setCompressionController (LZFCompressionController *controller)
+        {
+          controller_ = controller;
+        }
+
+        /** \brief Get the number of bytes of an uncompressed image of the given size.
+          * \param[in] width the with of the image
+          * \param[in] height the height of the image
+          */
+        virtual size_t
+        getImageSize (uint32_t width, uint32_t height) const = 0;
+
+      protected:
+        /** \brief Convert an image into a complete PCLZF blob (header + compressed data).
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[out] output the PCLZF blob. The buffer is only grown, never
+          * shrunk, and may be larger than the returned blob size.
+          * \return the size of the blob, 0 if error
+          */
+        virtual uint32_t
+        encode (const char* data,
+                uint32_t width, uint32_t height,
+                std::vector<char> &output) = 0;
+
+        /** \brief Encode an image at the level picked by the compression
+          * controller (if any), timing it for the controller. Writers call this
+          * instead of \ref encode.
+          */
+        uint32_t
+        encodeImage (const char* data,
+                     uint32_t width, uint32_t height,
+                     std::vector<char> &output);
+
+        /** \brief Called when an encoded image could not be written, so that
+          * writers encoding images relative to previous ones start over.
+          */
+        virtual void
+        discardEncoded () {}
+
+        /** \brief Save a compressed image array to disk
+          * \param[in] data the data to save
+          * \param[in] data_size the size of the data
+          * \param[in] filename the file name to write the data to
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        saveImageBlob (const char* data, size_t data_size,
+                       const std::string &filename);
+
+        /** \brief Realtime LZF compression.
+          * \param[in] input the array to compress
+          * \param[in] input_size the size of the array to compress
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] image_type the type of the image to save. This should be an up to
+          * 16 characters string describing the data type. Examples are: "bayer8", "rgb24",
+          * "yuv422", "depth16".
+          * \param[out] output the compressed output array (must be pre-allocated!)
+          * \return the number of bytes in the output array
+          */
+        uint32_t
+        compress (const char* input, uint32_t input_size,
+                  uint32_t width, uint32_t height,
+                  const std::string &image_type,
+                  char *output);
+
+        /** \brief Compression into the extended header, used by \ref compress
+          * when band rows, a codec other than LZF or pyramid levels are set.
+          * \param[in] input the array to compress
+          * \param[in] input_size the size of the array to compress
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] image_type the type of the image to save
+          * \param[in] codec the codec used for this image, which the adaptive levels may pick instead of \ref codec_
+          * \param[out] output the compressed output array (must be pre-allocated!)
+          * \return the number of bytes in the output array
+          */
+        uint32_t
+        compressBands (const char* input, uint32_t input_size,
+                       uint32_t width, uint32_t height,
+                       const std::string &image_type,
+                       const ImageCodec &codec,
+                       char *output);
+
+        /** \brief Get the output buffer size needed by \ref compress for a given input.
+          * \param[in] input_size the size of the array to compress
+          * \param[in] height the height of the data array
+          */
+        size_t
+        getMaxCompressedSize (uint32_t input_size, uint32_t height) const;
+
+        /** \brief Scratch buffer holding the last PCLZF blob produced by \ref encode. */
+        std::vector<char> compressed_buffer_;
+
+        /** \brief Scratch buffer for the planar reordering done before compression. */
+        std::vector<char> shuffle_buffer_;
+
+        /** \brief A decimated copy of an image, stored ahead of the full resolution data. */
+        struct Level
+        {
+          uint32_t width;
+          uint32_t height;
+          /** Decimation factor with respect to the full resolution image */
+          uint32_t scale;
+          std::vector<char> data;
+        };
+
+        /** \brief Levels of the image being encoded, filled in by the encode ()
+          * of writers supporting pyramids and stored by \ref compress.
+          */
+        std::vector<Level> pyramid_;
+
+        /** \brief Bin size and largest depth value of quantized depth images,
+          * stored by \ref compress, 0 if the images are exact.
+          */
+        uint32_t quantization_step_;
+        uint32_t quantization_max_depth_;
+
+        /** \brief Hash of the image a depth16t image is taken against, stored by
+          * \ref compress if has_reference_hash_ is set, so that readers can tell
+          * whether the image they decoded last is the right reference.
+          */
+        uint64_t reference_hash_;
+        bool has_reference_hash_;
+
+        /** \brief Number of image rows per compressed band, 0 to disable banding. */
+        uint32_t band_rows_;
+
+        /** \brief Number of threads used for banded compression, 0 to let OpenMP decide. */
+        unsigned int nr_threads_;
+
+        /** \brief Optional instrumentation, NULL if disabled. */
+        LZFIOStatistics *statistics_;
+
+        /** \brief Compression backend. */
+        const ImageCodec *codec_;
+
+        /** \brief Optional frame index, NULL if disabled. */
+        LZFFrameIndex *frame_index_;
+
+        /** \brief Sequence number of the next image written with a timestamp. */
+        uint64_t sequence_;
+
+        /** \brief Optional adaptive compression, NULL if disabled. */
+        LZFCompressionController *controller_;
+
+        /** \brief Compression level of the image being encoded, read by the
+          * encode () of every writer and by \ref compress.
+          */
+        LZFCompressionController::Level level_;
+    };
+
+    /** \brief PCL-LZF 16-bit depth image format writer.
+      *
+      * The size of the uncompressed data has to be width * height * 2 bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFDepth16ImageWriter : public LZFImageWriter
+    {
+      public:
+        using LZFImageWriter::write;
+
+        /** Empty constructor */
+        LZFDepth16ImageWriter ()
+          : z_multiplication_factor_ (0.001)      // Set default multiplication factor
+          , nr_levels_ (0)
+          , level_scale_ (4)
+        {}
+
+        /** Empty destructor */
+        virtual ~LZFDepth16ImageWriter () {}
+
+        /** \brief Save a 16-bit depth image into PCL-LZF format.
+          * \param[in] data the array holding the depth image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write (preferred extension: .pclzf)
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               const std::string &filename);
+
+        /** \brief Write camera parameters to disk.
+          * \param[in] parameters the camera parameters
+          * \param[in] filename the file name to write
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        writeParameters (const CameraParameters &parameters,
+                         const std::string &filename);
+
+        /** \brief Record camera parameters in a parameter session.
+          * \param[in] parameters the camera parameters
+          * \param[in] session the session collecting the parameters
+          * \param[in] filename the file name the parameters are written to on sync
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        writeParameters (const CameraParameters &parameters,
+                         LZFParameterSession &session,
+                         const std::string &filename);
+
+        virtual size_t
+        getImageSize (uint32_t width, uint32_t height) const
+        {
+          return (size_t (width) * height * 2);
+        }
+
+        /** \brief Store coarse copies of every depth image ahead of the full resolution data.
+          *
+          * Level l is decimated by scale^l in both directions, every pixel
+          * holding the minimum valid (non zero) depth of its block, so that
+          * obstacles are never lost. Readers can decode a single level with
+          * LZFImageReader::readLevel. Images with levels use the extended
+          * "PCLZX" header.
+          * \param[in] nr_levels the number of coarse levels, 0 (default) to disable
+          * \param[in] scale the decimation factor between two levels
+          */
+        void
+        setPyramidLevels (unsigned int nr_levels, unsigned int scale = 4);
+
+        /** \brief Store depth images clipped to a range and quantized ("depth16q" images).
+          *
+          * Depth values are rounded to bins of 2 * max_error, and the ones
+          * beyond max_range are read back as max_range plus one depth unit, so
+          * that they still count as out of range (see \ref quantizeDepth16).
+          * Coarse bins leave long runs of equal values: a 7 m range at 5 cm
+          * typically compresses several times better, and faster, than exact
+          * depth. LZFDepth16ImageReader reconstructs the depth transparently,
+          * older readers reject the images. The range and the error bound are
+          * also written with the camera parameters (depth.max_range,
+          * depth.quantization_error).
+          * \param[in] max_range the largest depth kept, in meters (e.g. sensor_max_range), 0 to write exact depth again
+          * \param[in] max_error the largest depth error, in meters (e.g. mapping_resolution / 2)
+          * \return false if the range or the error does not fit 16-bit depth values
+          */
+        bool
+        setQuantization (double max_range, double max_error);
+
+        /** \brief Store depth images clipped to a range and quantized to a number of bits.
+          *
+          * Same as \ref setQuantization, with the bin size chosen so that
+          * every value fits \a nr_bits bits (e.g. 8 or 12), out of range
+          * values included.
+          * \param[in] max_range the largest depth kept, in meters, 0 to write exact depth again
+          * \param[in] nr_bits the number of bits of a quantized value, in [2, 16]
+          * \return false if the range does not fit 16-bit depth values
+          */
+        bool
+        setQuantizationBits (double max_range, unsigned int nr_bits);
+
+        /** \brief Get the largest depth error (in meters) of the images written, 0 if they are exact. */
+        inline double
+        getQuantizationError () const
+        {
+          return ((quantization_step_ / 2) * z_multiplication_factor_);
+        }
+
+      protected:
+        virtual uint32_t
+        encode (const char* data,
+                uint32_t width, uint32_t height,
+                std::vector<char> &output);
+
+        /** \brief Set the quantization from a range and a bin size, both in depth units. */
+        bool
+        setQuantizationStep (double max_depth, double step);
+
+        /** \brief Fill \ref pyramid_ with the coarse levels of a depth image. */
+        void
+        buildPyramid (const char *data, uint32_t width, uint32_t height);
+
+        /** \brief Z-value depth multiplication factor
+          * (i.e., if raw data is in [mm] and we want [m], we need to multiply with 0.001)
+          */
+        double z_multiplication_factor_;
+
+        /** \brief Number of coarse levels, 0 if disabled. */
+        unsigned int nr_levels_;
+
+        /** \brief Decimation factor between two levels. */
+        unsigned int level_scale_;
+    };
+
+    /** \brief PCL-LZF 16-bit depth image format writer using the "depth16d" pre-filter.
+      *
+      * The depth image is passed through \ref encodeDepth16Delta before being
+      * compressed, which typically yields noticeably smaller files at a higher
+      * compression speed. LZFDepth16ImageReader undoes the filter transparently,
+      * older readers will reject the "depth16d" image type.
+      *
+      * The size of the uncompressed data has to be width * height * 2 bytes.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFDepth16DeltaImageWriter : public LZFDepth16ImageWriter
+    {
+      public:
+        using LZFDepth16ImageWriter::write;
+
+        /** Empty constructor */
+        LZFDepth16DeltaImageWriter () {}
+        /** Empty destructor */
+        virtual ~LZFDepth16DeltaImageWriter () {}
+
+      protected:
+        virtual uint32_t
+        encode (const char* data,
+                uint32_t width, uint32_t height,
+                std::vector<char> &output);
+    };
+
+    /** \brief PCL-LZF 16-bit depth stream writer using keyframes and temporal deltas.
+      *
+      * Every keyframe interval, an image is written as a self-contained
+      * "depth16d" keyframe. The images in between are written as "depth16t":
+      * the lossless difference to the previous image (see \ref
+      * encodeDepth16Temporal), which is mostly zeros while the camera hovers
+      * or moves slowly. A new keyframe is also started whenever the image size
+      * changes or an image could not be written. When a delta image comes out
+      * larger than the last keyframe (sensor noise, fast motion), the next
+      * keyframe interval is written with keyframes only. With \ref
+      * setQuantization, keyframes are "depth16q" images and the differences
+      * are taken between quantized images.
+      *
+      * LZFDepth16ImageReader undoes the filter transparently as long as the
+      * images are read in order; random access into PCLZS streams decodes
+      * from the preceding keyframe. Meant for streams (or directories of
+      * consecutively numbered files), since a single missing image breaks the
+      * chain up to the next keyframe. Every delta image holds the hash of the
+      * image it was taken against, so readers decoding it against any other
+      * image report an error instead of returning a wrong depth image.
+      *
+      * The size of the uncompressed data has to be width * height * 2 bytes.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFDepth16TemporalImageWriter : public LZFDepth16DeltaImageWriter
+    {
+      public:
+        using LZFDepth16DeltaImageWriter::write;
+
+        /** Empty constructor */
+        LZFDepth16TemporalImageWriter ()
+          : keyframe_interval_ (30)
+          , frames_since_keyframe_ (0)
+          , keyframes_left_ (0)
+          , keyframe_size_ (0)
+          , reference_ ()
+          , reference_width_ (0)
+          , reference_height_ (0)
+          , quantized_image_ ()
+        {}
+        /** Empty destructor */
+        virtual ~LZFDepth16TemporalImageWriter () {}
+
+        /** \brief Set the number of images between two keyframes.
+          * \param[in] keyframe_interval the keyframe interval (default 30),
+          * which bounds the cost of seeking. 1 writes keyframes only.
+          */
+        inline void
+        setKeyframeInterval (unsigned int keyframe_interval)
+        {
+          keyframe_interval_ = std::max (keyframe_interval, 1u);
+        }
+
+        /** \brief Get the number of images between two keyframes. */
+        inline unsigned int
+        getKeyframeInterval () const
+        {
+          return (keyframe_interval_);
+        }
+
+        /** \brief Write the next image as a keyframe, e.g. when starting a new file. */
+        inline void
+        forceKeyframe ()
+        {
+          frames_since_keyframe_ = 0;
+        }
+
+      protected:
+        virtual uint32_t
+        encode (const char* data,
+                uint32_t width, uint32_t height,
+                std::vector<char> &output);
+
+        virtual void
+        discardEncoded ()
+        {
+          forceKeyframe ();
+        }
+
+        /** \brief Number of images between two keyframes. */
+        unsigned int keyframe_interval_;
+
+        /** \brief Number of images written since the last keyframe, 0 to start a new one. */
+        unsigned int frames_since_keyframe_;
+
+        /** \brief Number of upcoming images written as keyframes because deltas did not pay off. */
+        unsigned int keyframes_left_;
+
+        /** \brief Size of the last keyframe blob. */
+        uint32_t keyframe_size_;
+
+        /** \brief The last image written. */
+        std::vector<char> reference_;
+        uint32_t reference_width_;
+        uint32_t reference_height_;
+
+        /** \brief The image being written as readers reconstruct it, if quantized. */
+        std::vector<char> quantized_image_;
+    };
+
+    /** \brief PCL-LZF 24-bit RGB image format writer.
+      *
+      * The size of the uncompressed data has to be width * height * 3 bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFRGB24ImageWriter : public LZFImageWriter
+    {
+      public:
+        using LZFImageWriter::write;
+
+        /** Empty constructor */
+        LZFRGB24ImageWriter () {}
+        /** Empty destructor */
+        virtual ~LZFRGB24ImageWriter () {}
+
+        /** \brief Save a 24-bit RGB image into PCL-LZF format.
+          * \param[in] data the array holding the RGB image (as [RGB..RGB] or [BGR..BGR])
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write (preferred extension: .pclzf)
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        write (const char *data,
+               uint32_t width, uint32_t height,
+               const std::string &filename);
+
+        /** \brief Write camera parameters to disk.
+          * \param[in] parameters the camera parameters
+          * \param[in] filename the file name to write
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        writeParameters (const CameraParameters &parameters,
+                         const std::string &filename);
+
+        /** \brief Record camera parameters in a parameter session.
+          * \param[in] parameters the camera parameters
+          * \param[in] session the session collecting the parameters
+          * \param[in] filename the file name the parameters are written to on sync
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        writeParameters (const CameraParameters &parameters,
+                         LZFParameterSession &session,
+                         const std::string &filename);
+
+        virtual size_t
+        getImageSize (uint32_t width, uint32_t height) const
+        {
+          return (size_t (width) * height * 3);
+        }
+
+      protected:
+        virtual uint32_t
+        encode (const char* data,
+                uint32_t width, uint32_t height,
+                std::vector<char> &output);
+    };
+
+    /** \brief PCL-LZF 16-bit YUV422 image format writer.
+      *
+      * The size of the uncompressed data has to be width * height * 2 bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFYUV422ImageWriter : public LZFRGB24ImageWriter
+    {
+      public:
+        using LZFRGB24ImageWriter::write;
+
+        /** Empty constructor */
+        LZFYUV422ImageWriter () {}
+        /** Empty destructor */
+        virtual ~LZFYUV422ImageWriter () {}
+
+        /** \brief Save a 16-bit YUV422 image into PCL-LZF format.
+          * \param[in] data the array holding the YUV422 image (as [YUYV...YUYV])
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write (preferred extension: .pclzf)
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        write (const char *data,
+               uint32_t width, uint32_t height,
+               const std::string &filename);
+
+        virtual size_t
+        getImageSize (uint32_t width, uint32_t height) const
+        {
+          return (size_t (width) * height * 2);
+        }
+
+      protected:
+        virtual uint32_t
+        encode (const char* data,
+                uint32_t width, uint32_t height,
+                std::vector<char> &output);
+    };
+
+    /** \brief PCL-LZF 8-bit Bayer image format writer.
+      *
+      * The size of the uncompressed data has to be width * height bytes.
+      * \author Radu B. Rusu
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFBayer8ImageWriter : public LZFRGB24ImageWriter
+    {
+      public:
+        using LZFRGB24ImageWriter::write;
+
+        /** Empty constructor */
+        LZFBayer8ImageWriter () {}
+        /** Empty destructor */
+        virtual ~LZFBayer8ImageWriter () {}
+
+        /** \brief Save a 8-bit Bayer image into PCL-LZF format.
+          * \param[in] data the array holding the 8-bit Bayer array
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write (preferred extension: .pclzf)
+          * \return true if operation successful, false otherwise
+          */
+        virtual bool
+        write (const char *data,
+               uint32_t width, uint32_t height,
+               const std::string &filename);
+
+        virtual size_t
+        getImageSize (uint32_t width, uint32_t height) const
+        {
+          return (size_t (width) * height);
+        }
+
+      protected:
+        virtual uint32_t
+        encode (const char* data,
+                uint32_t width, uint32_t height,
+                std::vector<char> &output);
+    };
+
+    /** \brief Asynchronous front-end for the PCL-LZF image writers.
+      *
+      * write () only copies the image into a preallocated slot of a bounded
+      * queue and returns; a background thread compresses the queued images
+      * with the wrapped writer and saves them to disk (or appends them to a
+      * PCLZS stream). The queue is a lock-free single producer / single
+      * consumer ring, so a producer that finds space never waits on the disk;
+      * it only takes a lock to wake the background thread up when that one
+      * ran out of images and went to sleep.
+      *
+      * What happens when the queue is full is selected with a \ref QueuePolicy.
+      * Only BLOCK can make write () wait; the drop policies keep the caller's
+      * latency bounded by a memcpy of the image.
+      *
+      * write () must always be called from the same thread, and the wrapped
+      * writer (as well as any stream passed to write ()) must not be used
+      * elsewhere until \ref flush or \ref stop returned.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFAsyncImageWriter
+    {
+      public:
+        /** \brief What write () does when the queue is full. */
+        enum QueuePolicy
+        {
+          BLOCK,          /**< wait until the background thread frees a slot */
+          DROP_OLDEST,    /**< discard the oldest queued image to make room */
+          DROP_NEWEST     /**< discard the image being written */
+        };
+
+        /** \brief Constructor. Starts the background thread.
+          * \param[in] writer the writer used to compress and save the images
+          * \param[in] queue_size the maximum number of queued images
+          * \param[in] policy what to do when the queue is full
+          */
+        LZFAsyncImageWriter (LZFImageWriter &writer,
+                             size_t queue_size = 8,
+                             QueuePolicy policy = DROP_OLDEST);
+
+        /** \brief Destructor. Writes the queued images and stops the background thread. */
+        ~LZFAsyncImageWriter ();
+
+        /** \brief Queue an image to be saved into PCL-LZF format.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write
+          * \return true if the image was queued, false if it was dropped
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               const std::string &filename);
+
+        /** \brief Queue an image to be saved into PCL-LZF format, with its capture time.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] filename the file name to write
+          * \param[in] timestamp the capture timestamp of the image, recorded in
+          * the frame index of the wrapped writer
+          * \return true if the image was queued, false if it was dropped
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               const std::string &filename,
+               uint64_t timestamp);
+
+        /** \brief Queue an image to be appended to a PCLZS stream.
+          * \param[in] data the array holding the image
+          * \param[in] width the with of the data array
+          * \param[in] height the height of the data array
+          * \param[in] stream the open stream to append the image to
+          * \param[in] timestamp the capture timestamp of the image
+          * \return true if the image was queued, false if it was dropped
+          */
+        bool
+        write (const char* data,
+               uint32_t width, uint32_t height,
+               LZFStreamWriter &stream,
+               uint64_t timestamp);
+
+        /** \brief Wait until every queued image has been written. */
+        void
+        flush ();
+
+        /** \brief Write the queued images and stop the background thread.
+          * Images written afterwards are dropped.
+          */
+        void
+        stop ();
+
+        /** \brief Get the queue policy. */
+        inline QueuePolicy
+        getQueuePolicy () const
+        {
+          return (policy_);
+        }
+
+        /** \brief Get the number of images dropped because the queue was full, or written after stop (). */
+        inline uint64_t
+        getNumberOfDroppedFrames () const
+        {
+          return (dropped_frames_.load ());
+        }
+
+        /** \brief Get the number of images written by the background thread. */
+        inline uint64_t
+        getNumberOfWrittenFrames () const
+        {
+          return (written_frames_.load ());
+        }
+
+        /** \brief Get the number of images the wrapped writer failed to write. */
+        inline uint64_t
+        getNumberOfFailedFrames () const
+        {
+          return (failed_frames_.load ());
+        }
+
+        /** \brief Get the number of images currently waiting in the queue. */
+        inline size_t
+        getQueueDepth () const
+        {
+          uint64_t read_index = read_index_.load ();
+          return (static_cast<size_t> (write_index_.load () - read_index));
+        }
+
+        /** \brief Get the largest queue depth observed so far. */
+        inline size_t
+        getMaxQueueDepth () const
+        {
+          return (max_queue_depth_.load ());
+        }
+
+      protected:
+        /** \brief A queued image and where it goes. */
+        struct Frame
+        {
+          /** \brief Queue position the slot is ready for: equal to the position
+            * when the slot is free for the producer, position + 1 once the
+            * image is queued.
+            */
+          std::atomic<uint64_t> sequence;
+          std::vector<char> data;
+          uint32_t width;
+          uint32_t height;
+          std::string filename;
+          LZFStreamWriter *stream;
+          uint64_t timestamp;
+          bool has_timestamp;
+        };
+
+        /** \brief Reserve a slot for a new image, applying the queue policy.
+          * \return the slot, or NULL if the image has to be dropped
+          */
+        Frame*
+        acquireSlot ();
+
+        /** \brief Copy an image into a slot and make it visible to the background thread. */
+        void
+        publishSlot (Frame &frame, const char *data, uint32_t width, uint32_t height);
+
+        /** \brief Wake up the threads waiting for images to be handled, if there are any. */
+        void
+        notifyDone ();
+
+        /** \brief Background thread main loop. */
+        void
+        run ();
+
+        /** \brief The writer used by the background thread. */
+        LZFImageWriter &writer_;
+
+        /** \brief Queue policy. */
+        QueuePolicy policy_;
+
+        /** \brief Maximum number of queued images. */
+        size_t queue_size_;
+
+        /** \brief Ring of queue_size_ + 1 slots. The spare slot gives the
+          * background thread time to move an image out of its slot before the
+          * producer wraps around to it.
+          */
+        std::vector<Frame> frames_;
+
+        /** \brief The image the background thread is writing. Its buffers are
+          * swapped with those of the queue slot, so no slot is held while the
+          * image is compressed and no memory is allocated in steady state.
+          */
+        Frame current_;
+
+        /** \brief Number of images ever queued. Only written by the producer. */
+        std::atomic<uint64_t> write_index_;
+
+        /** \brief Number of images ever taken off the queue, either by the
+          * background thread or by the producer dropping the oldest image.
+          */
+        std::atomic<uint64_t> read_index_;
+
+        /** \brief Number of images taken off the queue that are completely handled. */
+        std::atomic<uint64_t> done_index_;
+
+        std::atomic<uint64_t> dropped_frames_;
+        std::atomic<uint64_t> written_frames_;
+        std::atomic<uint64_t> failed_frames_;
+        std::atomic<size_t> max_queue_depth_;
+        std::atomic<bool> stopping_;
+
+        /** \brief Number of threads parked on \ref frame_queued_ (the background thread) and on \ref frame_done_. */
+        std::atomic<unsigned int> queued_waiters_;
+        std::atomic<unsigned int> done_waiters_;
+
+        /** \brief Used to park the threads while there is nothing to do. The
+          * queue itself is never accessed under the lock: a thread registers as
+          * a waiter before checking the queue one last time, and the other side
+          * only takes the lock to notify when it sees a waiter, so that a
+          * producer that finds the background thread busy never touches the
+          * lock. Waits are bounded all the same.
+          */
+        std::mutex mutex_;
+        std::condition_variable frame_queued_;
+        std::condition_variable frame_done_;
+
+        std::thread thread_;
+
+      private:
+        LZFAsyncImageWriter (const LZFAsyncImageWriter&) = delete;
+        LZFAsyncImageWriter& operator = (const LZFAsyncImageWriter&) = delete;
+    };
+
+    /** \brief In-memory flight recorder for compressed images.
+      *
+      * Keeps the most recent PCLZF blobs of an image stream in a ring allocated
+      * once at construction, and writes them to a PCLZS stream file only when
+      * \ref trigger is called, e.g. on a collision or a planner failure (use one
+      * recorder per sensor, e.g. one for depth and one for RGB). The ring holds as many images as fit into its capacity; with a
+      * non-zero window, only the images captured during the last \a window
+      * timestamp units before the trigger are written out.
+      *
+      * Images are added with \ref append or LZFImageWriter::write (). Adding an
+      * image copies the blob into the ring and evicts the oldest images to make
+      * room: no memory is allocated and no lock is taken. The background thread
+      * started by \ref trigger reads the images straight from the ring, and the
+      * images it has not written yet are never evicted: while a flush lags
+      * behind, new images that do not fit are dropped instead.
+      *
+      * Temporal ("depth16t") images at the start of a flush cannot be decoded
+      * without the keyframe evicted before them, and are skipped up to the next
+      * keyframe. Writers should use a keyframe interval well below the number
+      * of images held by the ring.
+      *
+      * append () and LZFImageWriter::write () must always be called from the
+      * same thread; trigger () can be called from any thread.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFFlightRecorder
+    {
+      public:
+        /** \brief Constructor. Allocates (and touches) the ring.
+          * \param[in] capacity the size of the ring in bytes
+          * \param[in] window the time span written out on a trigger, in
+          * timestamp units (e.g. ns), 0 to write out the whole ring
+          */
+        LZFFlightRecorder (size_t capacity, uint64_t window = 0);
+
+        /** \brief Destructor. Waits for a running flush to complete. */
+        ~LZFFlightRecorder ();
+
+        /** \brief Copy a PCLZF blob into the ring.
+          * \param[in] blob the PCLZF image (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[in] timestamp the capture timestamp of the frame (e.g., in ns)
+          * \return true if the image was added, false if it was dropped
+          * (larger than half the ring, or no room left next to a running flush)
+          */
+        bool
+        append (const char *blob, uint32_t blob_size, uint64_t timestamp);
+
+        /** \brief Write the images in the ring to a PCLZS stream file on a background thread.
+          * \param[in] filename the stream file to write
+          * \param[in] post_trigger_ms how long to keep writing the images added
+          * after the trigger, in milliseconds
+          * \return false if a previous flush is still running
+          */
+        bool
+        trigger (const std::string &filename, unsigned int post_trigger_ms = 0);
+
+        /** \brief Check whether a flush is running. */
+        inline bool
+        isFlushing () const
+        {
+          return (flushing_.load ());
+        }
+
+        /** \brief Wait until the running flush (if any) is complete.
+          * \return true if the last flush succeeded
+          */
+        bool
+        waitForFlush ();
+
+        /** \brief Get the size of the ring in bytes. */
+        inline size_t
+        getCapacity () const
+        {
+          return (buffer_.size ());
+        }
+
+        /** \brief Get the number of bytes currently held by the ring. */
+        inline size_t
+        getSize () const
+        {
+          uint64_t tail = tail_.load ();
+          return (static_cast<size_t> (head_.load () - tail));
+        }
+
+        /** \brief Get the number of images dropped so far. */
+        inline uint64_t
+        getNumberOfDroppedFrames () const
+        {
+          return (dropped_frames_.load ());
+        }
+
+        /** \brief Get the number of images written by the last flush. */
+        inline uint64_t
+        getNumberOfFlushedFrames () const
+        {
+          return (flushed_frames_.load ());
+        }
+
+      protected:
+        /** \brief Skip the padding left at the end of the ring, if any.
+          * \param[in] position a record position
+          * \return the position of the record actually stored there
+          */
+        uint64_t
+        skipPadding (uint64_t position) const;
+
+        /** \brief Read the header of the record at a given position (after \ref skipPadding).
+          * \return the position of the next record
+          */
+        uint64_t
+        readRecord (uint64_t position, uint64_t &timestamp, uint32_t &blob_size) const;
+
+        /** \brief Background thread main loop, writing one flush. */
+        void
+        run (std::string filename, unsigned int post_trigger_ms, uint64_t first_timestamp);
+
+        /** \brief The ring. Records are 8 byte aligned: a 64-bit timestamp,
+          * the 32-bit blob size, 4 bytes of padding and the blob. A record never
+          * wraps around; the end of the ring is skipped instead (marked by a
+          * record of size 0xffffffff if there is room for its header).
+          */
+        std::vector<char> buffer_;
+
+        /** \brief Time span written out on a trigger, 0 for the whole ring. */
+        uint64_t window_;
+
+        /** \brief End of the newest record. Positions grow monotonically and
+          * are taken modulo the capacity. Only written by the producer.
+          */
+        std::atomic<uint64_t> head_;
+
+        /** \brief Start of the oldest record. Only written by the producer. */
+        std::atomic<uint64_t> tail_;
+
+        /** \brief Start of the oldest record still needed by a running flush,
+          * NO_PIN otherwise. The producer does not evict records past it.
+          */
+        std::atomic<uint64_t> pin_;
+
+        /** \brief Timestamp of the newest record. */
+        std::atomic<uint64_t> newest_timestamp_;
+
+        std::atomic<uint64_t> dropped_frames_;
+        std::atomic<uint64_t> flushed_frames_;
+        std::atomic<bool> flushing_;
+        std::atomic<bool> flush_result_;
+
+        std::thread thread_;
+
+        /** \brief Serializes the calls to trigger (), never taken by the producer. */
+        std::mutex trigger_mutex_;
+
+        static const uint64_t NO_PIN = ~static_cast<uint64_t> (0);
+
+      private:
+        LZFFlightRecorder (const LZFFlightRecorder&) = delete;
+        LZFFlightRecorder& operator = (const LZFFlightRecorder&) = delete;
+    };
+
+    /** \brief Publisher side of a shared memory ring of PCLZF images.
+      *
+      * Hands the images of one writer process to any number of reader
+      * processes on the same machine (see LZFSharedRingReader), without a
+      * round trip through the filesystem. The ring is a POSIX shared memory
+      * object (shm_open) holding:
+      *
+      *  * a 64 byte control block: "PCLZM", a version byte, 2 reserved bytes,
+      *    the number of slots and the slot size (32-bit each), the number of
+      *    images published so far (64-bit), a wake up counter and the number
+      *    of waiting readers (32-bit each) and a closed flag
+      *  * the slots, each a 64 byte header (64-bit sequence word, 64-bit
+      *    timestamp, 32-bit blob size) followed by slot size bytes for the
+      *    unmodified PCLZF blob
+      *
+      * Image n goes into slot n % number of slots. Its sequence word is 2n + 1
+      * while the image is copied in and 2n + 2 once it is published, so readers
+      * can tell when an image was overwritten under them. The writer never
+      * waits for readers: a reader falling more than the number of slots
+      * behind loses images.
+      *
+      * \note Not thread safe: all calls must come from the same thread. Not
+      * available on Windows.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFSharedRingWriter
+    {
+      public:
+        /** Empty constructor */
+        LZFSharedRingWriter ();
+
+        /** Destructor. Closes the ring if still open. */
+        virtual ~LZFSharedRingWriter ();
+
+        /** \brief Create a new ring, replacing any existing one of the same name.
+          *
+          * Readers still attached to a replaced ring see it as closed.
+          * \param[in] name the shared memory object name, e.g. "/mavbench_depth"
+          * \param[in] nr_slots the number of images kept in the ring
+          * \param[in] slot_size the largest PCLZF blob the ring accepts, in bytes
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        create (const std::string &name, uint32_t nr_slots, uint32_t slot_size);
+
+        /** \brief Publish a PCLZF blob to the readers.
+          * \param[in] blob the PCLZF image (header + compressed data)
+          * \param[in] blob_size the size of the blob in bytes
+          * \param[in] timestamp the capture timestamp of the frame (e.g., in ns)
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        append (const char *blob, uint32_t blob_size, uint64_t timestamp);
+
+        /** \brief Mark the ring as closed, unmap it and remove its name. */
+        void
+        close ();
+
+        /** \brief Check whether a ring is open for writing. */
+        inline bool
+        isOpen () const
+        {
+          return (map_ != NULL);
+        }
+
+        /** \brief Get the number of images published so far. */
+        inline uint64_t
+        getNumberOfFrames () const
+        {
+          return (sequence_);
+        }
+
+        /** \brief Get the largest blob the ring accepts, in bytes. */
+        inline uint32_t
+        getSlotSize () const
+        {
+          return (slot_size_);
+        }
+
+      protected:
+        /** \brief The ring mapping. */
+        char *map_;
+
+        /** \brief The size of the mapping. */
+        uint64_t map_size_;
+
+        /** \brief The shared memory object name. */
+        std::string name_;
+
+        uint32_t nr_slots_;
+        uint32_t slot_size_;
+
+        /** \brief Number of the next image. */
+        uint64_t sequence_;
+
+      private:
+        LZFSharedRingWriter (const LZFSharedRingWriter&) = delete;
+        LZFSharedRingWriter& operator = (const LZFSharedRingWriter&) = delete;
+    };
+
+    /** \brief Subscriber side of a shared memory ring written by LZFSharedRingWriter.
+      *
+      * Images are handed out where they lie in the shared segment: \ref read
+      * decompresses them straight from the ring, and \ref consume passes the
+      * in-place blob to any decoder. Readers only write to the segment to
+      * register while they wait (futex on Linux, polling elsewhere), so any
+      * number of them can attach and disappear without affecting the writer.
+      *
+      * Since the writer never waits, an image can be overwritten while it is
+      * decoded. The slot's sequence word is checked again afterwards, and such
+      * an image is counted as overrun and skipped; decoding a torn image is
+      * safe, as all decoders check their bounds.
+      *
+      * Temporal ("depth16t") images can only be decoded right after the image
+      * before them; a reader that lost images waits for the next keyframe.
+      * \note Not thread safe: all calls must come from the same thread.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFSharedRingReader
+    {
+      public:
+        /** \brief Called with the blob of an image inside the shared segment.
+          * The blob is only valid during the call.
+          */
+        typedef boost::function<bool (const char *blob, uint32_t blob_size, uint64_t timestamp)> BlobCallback;
+
+        /** Empty constructor */
+        LZFSharedRingReader ();
+
+        /** Destructor. Unmaps the ring if still open. */
+        virtual ~LZFSharedRingReader ();
+
+        /** \brief Attach to a ring created by LZFSharedRingWriter.
+          *
+          * Reading starts with the next image published.
+          * \param[in] name the shared memory object name
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        open (const std::string &name);
+
+        /** \brief Unmap the ring. */
+        void
+        close ();
+
+        /** \brief Check whether a ring is open for reading. */
+        inline bool
+        isOpen () const
+        {
+          return (map_ != NULL);
+        }
+
+        /** \brief Skip to the newest image on every read instead of handing out
+          * every image in order (e.g. for perception, which only wants the
+          * freshest frame). Skipped images are not counted as overruns.
+          */
+        inline void
+        setSkipToLatest (bool skip_to_latest)
+        {
+          skip_to_latest_ = skip_to_latest;
+        }
+
+        /** \brief Wait for the next image and pass it, in place, to a callback.
+          * \param[in] callback the function decoding or copying the blob
+          * \param[in] timeout_ms how long to wait for an image, in milliseconds
+          * \return the result of the callback, false on timeout, if the ring
+          * was closed or if the image was overwritten during the call
+          */
+        bool
+        consume (const BlobCallback &callback, unsigned int timeout_ms = 1000);
+
+        /** \brief Wait for the next image and decompress it straight from the ring.
+          * \param[in] reader the reader matching the images of the ring
+          * \param[out] output the decompressed image
+          * \param[out] timestamp the capture timestamp of the image
+          * \param[in] timeout_ms how long to wait for an image, in milliseconds
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        read (LZFImageReader &reader, std::vector<char> &output,
+              uint64_t &timestamp, unsigned int timeout_ms = 1000);
+
+        /** \brief Wait for the next image and copy its PCLZF blob, e.g. to log it.
+          * \param[out] blob the PCLZF image (header + compressed data)
+          * \param[out] timestamp the capture timestamp of the image
+          * \param[in] timeout_ms how long to wait for an image, in milliseconds
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        readBlob (std::vector<char> &blob, uint64_t &timestamp, unsigned int timeout_ms = 1000);
+
+        /** \brief Get the sequence number of the last image consumed. */
+        inline uint64_t
+        getSequence () const
+        {
+          return (sequence_);
+        }
+
+        /** \brief Get the number of images lost because the writer overwrote them first. */
+        inline uint64_t
+        getNumberOfOverruns () const
+        {
+          return (overruns_);
+        }
+
+        /** \brief Check whether the writer closed (or replaced) the ring. */
+        bool
+        isWriterClosed () const;
+
+      protected:
+        /** \brief Wait until image \a sequence is published or the deadline passes. */
+        bool
+        waitForFrame (uint64_t sequence, std::chrono::steady_clock::time_point deadline);
+
+        /** \brief The ring mapping. */
+        char *map_;
+
+        /** \brief The size of the mapping. */
+        uint64_t map_size_;
+
+        uint32_t nr_slots_;
+        uint32_t slot_size_;
+
+        /** \brief Number of the next image to consume. */
+        uint64_t next_sequence_;
+
+        /** \brief Number of the last image consumed. */
+        uint64_t sequence_;
+
+        /** \brief One past the number of the last image decoded by \ref read,
+          * 0 if none. A temporal image is only decoded if it follows that image.
+          */
+        uint64_t decoded_sequence_;
+
+        uint64_t overruns_;
+        bool skip_to_latest_;
+
+      private:
+        LZFSharedRingReader (const LZFSharedRingReader&) = delete;
+        LZFSharedRingReader& operator = (const LZFSharedRingReader&) = delete;
+    };
+
+    /** \brief Prefetching, multi-threaded reader for recorded image sequences.
+      *
+      * Replays either a directory of PCLZF files (in file name order) or a
+      * PCLZS stream. Worker threads decompress up to \a prefetch_frames frames
+      * ahead of the consumer, and the kernel is asked to read the frames after
+      * those from disk in the meantime (posix_fadvise / madvise), so a replay
+      * is bounded by the consumer rather than by disk I/O plus a single
+      * decompression thread. Frames are handed out in order by \ref next or
+      * \ref forEach, in the layout the writer was given (rgb24 and yuv422
+      * images are interleaved back on the worker threads).
+      *
+      * Temporal ("depth16t") depth images depend on the frame before them.
+      * As soon as a worker meets one, all workers but one retire and the
+      * rest of the sequence is decoded in order; prefetching still hides the
+      * disk I/O. A temporal frame whose predecessor was decoded by another
+      * worker is decoded from the last keyframe (for streams through
+      * LZFImageReader::read (const LZFStreamReader&, size_t, std::vector<char>&)),
+      * which happens at most once per worker. Nothing is read ahead of time
+      * to find out whether a sequence holds temporal images.
+      *
+      * next () and forEach () must always be called from the same thread.
+      * \ingroup io
+      */
+    class PCL_EXPORTS LZFSequenceReader
+    {
+      public:
+        /** \brief A decompressed frame. */
+        struct Frame
+        {
+          /** Position of the frame in the sequence */
+          size_t index;
+          /** Capture timestamp for streams, 0 for directories */
+          uint64_t timestamp;
+          /** Source file for directories, empty for streams */
+          std::string filename;
+          /** Image type stored in the header, e.g. "depth16" */
+          std::string image_type;
+          uint32_t width;
+          uint32_t height;
+          /** The uncompressed image */
+          std::vector<char> data;
+          /** False if the frame could not be read or decompressed */
+          bool valid;
+        };
+
+        /** \brief Called for every frame by \ref forEach. Return false to stop. */
+        typedef boost::function<bool (const Frame &frame)> FrameCallback;
+
+        /** \brief Constructor.
+          * \param[in] prefetch_frames the number of frames decompressed ahead of the consumer
+          * \param[in] nr_threads the number of decompression threads. 0 uses one
+          * per hardware thread.
+          */
+        LZFSequenceReader (size_t prefetch_frames = 8, unsigned int nr_threads = 0);
+
+        /** \brief Destructor. Stops the worker threads. */
+        virtual ~LZFSequenceReader ();
+
+        /** \brief Replay all the files of a directory, sorted by name.
+          * \param[in] directory the directory holding the PCLZF files
+          * \param[in] extension the extension of the files to replay
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        openDirectory (const std::string &directory,
+                       const std::string &extension = ".pclzf");
+
+        /** \brief Replay all the frames of a PCLZS stream.
+          * \param[in] filename the stream file to replay
+          * \return true if operation successful, false otherwise
+          */
+        bool
+        openStream (const std::string &filename);
+
+        /** \brief Stop the worker threads and release the sequence. */
+        void
+        close ();
+
+        /** \brief Get the number of frames in the sequence. */
+        inline size_t
+        getNumberOfFrames () const
+        {
+          return (nr_frames_);
+        }
+
+        /** \brief Get the next frame of the sequence, waiting for it if needed.
+          * \param[out] frame the frame. Its buffer is recycled by the reader, so
+          * passing the same object on every call avoids allocations.
+          * \return false once the end of the sequence is reached
+          */
+        bool
+        next (Frame &frame);
+
+        /** \brief Hand the remaining frames of the sequence to a callback, in order.
+          * \param[in] callback the function called for every frame
+          * \return the number of frames handed to the callback
+          */
+        size_t
+        forEach (const FrameCallback &callback);
+
+      protected:
+        /** \brief A prefetch slot. */
+        struct Slot
+        {
+          Frame frame;
+          bool ready;
+        };
+
+        /** \brief Start the worker threads on an opened sequence. */
+        void
+        start ();
+
+        /** \brief Worker thread main loop. */
+        void
+        run ();
+
+        /** \brief Read and decompress a frame.
+          * \param[in] index the frame to decode
+          * \param[in] previous the frame last decoded with \a reader, the number of frames if none
+          * \param[in] reader the reader of the calling worker
+          * \param[out] frame the decoded frame
+          * \return true if the frame holds a "depth16t" image
+          */
+        bool
+        decode (size_t index, size_t previous, LZFRGB24ImageReader &reader, Frame &frame);
+
+        /** \brief Decode the files from the last keyframe up to (excluding) a temporal frame of a directory,
+          * so that \a reader holds its reference.
+          */
+        bool
+        decodeReferences (size_t index, LZFRGB24ImageReader &reader, std::vector<char> &scratch) const;
+
+        /** \brief Check whether a frame holds a "depth16t" image, without decompressing it. */
+        bool
+        isTemporalFrame (size_t index) const;
+
+        /** \brief Ask the kernel to read a frame from disk in the background. */
+        void
+        willNeed (size_t index) const;
+
+        /** \brief The number of frames decompressed ahead of the consumer. */
+        size_t prefetch_frames_;
+
+        /** \brief The number of worker threads. */
+        unsigned int nr_threads_;
+
+        /** \brief The files of a directory sequence, empty for streams. */
+        std::vector<std::string> filenames_;
+
+        /** \brief The stream of a stream sequence. */
+        LZFStreamReader stream_;
+
+        size_t nr_frames_;
+
+        /** \brief True once a worker decoded a "depth16t" image. */
+        bool temporal_;
+
+        /** \brief Number of workers still claiming frames. */
+        size_t nr_workers_;
+
+        /** \brief Frame i is decompressed into slot i % prefetch_frames_. */
+        std::vector<Slot> slots_;
+
+        /** \brief The next frame to be claimed by a worker. */
+        size_t next_decode_;
+
+        /** \brief The next frame to be handed to the consumer. */
+        size_t next_consume_;
+
+        bool stopping_;
+
+        /** \brief Guards the slot states and the indices above. */
+        std::mutex mutex_;
+        std::condition_variable slot_free_;
+        std::condition_variable slot_ready_;
+
+        std::vector<std::thread> threads_;
+
+      private:
+        LZFSequenceReader (const LZFSequenceReader&) = delete;
+        LZFSequenceReader& operator = (const LZFSequenceReader&) = delete;
+    };
+  }
+}
+
+#include <pcl/io/impl/lzf_image_io.hpp>
+
+#endif  //#ifndef PCL_LZF_IMAGE_IO_H_
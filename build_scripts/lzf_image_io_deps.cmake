@@ -0,0 +1,36 @@
+# Dependencies of the MAVBench lzf_image_io.cpp, appended to pcl/io/CMakeLists.txt
+# by companion_root_setup.bash. Only pcl_io gets them: the LZ4 / zstd codecs are
+# compiled in when the libraries are found, and librt (shm_open) is linked where
+# it is a separate library.
+if(TARGET pcl_io)
+  find_package(PkgConfig QUIET)
+  if(PKG_CONFIG_FOUND)
+    pkg_check_modules(LZF_LZ4 QUIET liblz4)
+    pkg_check_modules(LZF_ZSTD QUIET libzstd)
+  endif()
+
+  find_path(LZ4_INCLUDE_DIR lz4.h HINTS ${LZF_LZ4_INCLUDE_DIRS})
+  find_library(LZ4_LIBRARY NAMES lz4 HINTS ${LZF_LZ4_LIBRARY_DIRS})
+  if(LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+    message(STATUS "pcl_io: LZ4 codec enabled (${LZ4_LIBRARY})")
+    set_property(TARGET pcl_io APPEND PROPERTY COMPILE_DEFINITIONS HAVE_LZ4)
+    target_include_directories(pcl_io PRIVATE ${LZ4_INCLUDE_DIR})
+    target_link_libraries(pcl_io ${LZ4_LIBRARY})
+  endif()
+
+  find_path(ZSTD_INCLUDE_DIR zstd.h HINTS ${LZF_ZSTD_INCLUDE_DIRS})
+  find_library(ZSTD_LIBRARY NAMES zstd HINTS ${LZF_ZSTD_LIBRARY_DIRS})
+  if(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+    message(STATUS "pcl_io: zstd codec enabled (${ZSTD_LIBRARY})")
+    set_property(TARGET pcl_io APPEND PROPERTY COMPILE_DEFINITIONS HAVE_ZSTD)
+    target_include_directories(pcl_io PRIVATE ${ZSTD_INCLUDE_DIR})
+    target_link_libraries(pcl_io ${ZSTD_LIBRARY})
+  endif()
+
+  if(UNIX AND NOT APPLE)
+    find_library(RT_LIBRARY rt)
+    if(RT_LIBRARY)
+      target_link_libraries(pcl_io ${RT_LIBRARY})
+    endif()
+  endif()
+endif()
@@ -0,0 +1,1053 @@
+// Microbenchmark for the PCL-LZF image I/O path (build_scripts/lzf_image_io.cpp).
+//
+// Measures every writer/reader pair over a set of resolutions, either on
+// synthetic content or on recorded .pclzf images, and reports throughput,
+// compression ratio and the time spent in each stage:
+//   write: shuffle (planar reordering / pre-filter), compress, file I/O
+//   read:  file I/O, decompress, unshuffle
+//
+// Results are printed as a table and written as JSON in the layout of the
+// stats.json files produced by test_benches/scripts/clct_data.py, i.e. an
+// "experiment_set_<n>" list with one flat object per measurement.
+//
+// With --verify, nothing is timed: the codecs are fuzzed instead. Random
+// buffers are compressed and decompressed in both directions against the
+// reference liblzf kernels of PCL (pcl/io/lzf.h), truncated and corrupted
+// compressed data is checked to be rejected without writing past the output,
+// depth16d, depth16t and depth16q images are round-tripped through the
+// writers and readers, and the concurrent components (async writer, flight
+// recorder, shared memory ring) are run against their counters and the data
+// they hand out. The exit code is non-zero if any check fails.
+//
+// Built by build_scripts/companion_root_setup.bash against the installed PCL.
+// Usage:
+//   lzf_image_io_bench [--resolutions 640x480,1280x720] [--iterations 50]
+//                      [--recorded dir_with_pclzf_files] [--dir scratch_dir]
+//                      [--output stats.json] [--experiment_set 0]
+//                      [--codecs lzf,lz4,zstd]
+//   lzf_image_io_bench --verify 20000 [--seed 42] [--codecs lzf,lz4,zstd] [--dir scratch_dir]
+
+#include <pcl/io/lzf_image_io.h>
+#include <pcl/io/lzf.h>
+#include <pcl/console/print.h>
+#include <boost/filesystem.hpp>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  double
+  elapsedMs (const Clock::time_point &start)
+  {
+    return (std::chrono::duration<double, std::milli> (Clock::now () - start).count ());
+  }
+
+  // Expose the protected encode step so compression can be timed without the file I/O
+  template <typename WriterT>
+  struct Probe : public WriterT
+  {
+    using WriterT::encode;
+    using WriterT::compressed_buffer_;
+  };
+
+  struct Image
+  {
+    std::string type;         // writer image type
+    std::string content;      // "synthetic" or the recorded file name
+    uint32_t width;
+    uint32_t height;
+    std::vector<char> data;   // interleaved, as handed to the writers
+  };
+
+  struct Result
+  {
+    std::string type;
+    std::string codec;
+    std::string content;
+    uint32_t width;
+    uint32_t height;
+    size_t raw_size;
+    size_t compressed_size;
+    double shuffle_ms;
+    double compress_ms;
+    double write_io_ms;
+    double read_io_ms;
+    double decompress_ms;
+    double unshuffle_ms;
+  };
+
+  size_t
+  bytesPerPixel (const std::string &type)
+  {
+    if (type == "rgb24")
+      return (3);
+    if (type == "bayer8")
+      return (1);
+    return (2);     // depth16, depth16d, yuv422
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Synthetic content: smooth surfaces with sensor-like noise, plus invalid
+  // (zero) depth pixels, so compression ratios are in the range of real data.
+  Image
+  makeSynthetic (const std::string &type, uint32_t width, uint32_t height, unsigned int seed)
+  {
+    Image image;
+    image.type = type;
+    image.content = "synthetic";
+    image.width = width;
+    image.height = height;
+    image.data.resize (size_t (width) * height * bytesPerPixel (type));
+    srand (seed);
+
+    for (uint32_t v = 0; v < height; ++v)
+    {
+      for (uint32_t u = 0; u < width; ++u)
+      {
+        size_t idx = size_t (v) * width + u;
+        double surface = 0.5 + 0.25 * std::sin (u * 0.013) * std::cos (v * 0.017) + 0.2 * double (v) / height;
+        int noise = rand () % 3 - 1;
+        if (type == "depth16" || type == "depth16d")
+        {
+          uint16_t depth = static_cast<uint16_t> (500 + surface * 6000 + noise);
+          if ((u * 7 + v * 13) % 211 == 0 || (u > width * 3 / 4 && v < height / 5))
+            depth = 0;
+          memcpy (&image.data[idx * 2], &depth, sizeof (uint16_t));
+        }
+        else if (type == "rgb24")
+        {
+          image.data[idx * 3 + 0] = static_cast<char> (surface * 200 + noise);
+          image.data[idx * 3 + 1] = static_cast<char> (surface * 150 + u % 16 + noise);
+          image.data[idx * 3 + 2] = static_cast<char> (255 - surface * 180 + noise);
+        }
+        else if (type == "yuv422")
+        {
+          // UYVY: chroma on even bytes, luma on odd ones
+          image.data[idx * 2 + 0] = static_cast<char> (128 + (u % 2 ? -20 : 20) * surface + noise);
+          image.data[idx * 2 + 1] = static_cast<char> (surface * 220 + noise);
+        }
+        else
+        {
+          // RGGB mosaic
+          bool red = (v % 2 == 0) && (u % 2 == 0), blue = (v % 2 == 1) && (u % 2 == 1);
+          image.data[idx] = static_cast<char> ((red ? 200 : blue ? 80 : 150) * surface + noise);
+        }
+      }
+    }
+    return (image);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  bool
+  loadRecorded (const std::string &filename, Image &image)
+  {
+    pcl::io::LZFRGB24ImageReader rgb_reader;
+    std::vector<char> planar;
+    if (!rgb_reader.read (filename, planar))
+      return (false);
+
+    std::string type = rgb_reader.getImageType ();
+    type = type.substr (0, type.find_first_of (std::string (" \0", 2)));
+    image.content = boost::filesystem::path (filename).filename ().string ();
+    image.width = rgb_reader.getWidth ();
+    image.height = rgb_reader.getHeight ();
+    size_t nr_pixels = size_t (image.width) * image.height;
+
+    if (type == "rgb24" || type == "yuv422")
+    {
+      // Undo the planar reordering done by the writer
+      image.data.resize (planar.size ());
+      if (type == "rgb24")
+        pcl::io::interleaveRGB24 (&planar[0], nr_pixels, &image.data[0]);
+      else
+        pcl::io::interleaveYUV422 (&planar[0], nr_pixels, &image.data[0]);
+    }
+    else if (type == "depth16" || type == "depth16d" || type == "bayer8")
+      image.data.swap (planar);     // depth16d is unfiltered by the reader
+    else
+      return (false);
+
+    image.type = (type == "depth16d") ? "depth16" : type;
+    return (image.data.size () == nr_pixels * bytesPerPixel (image.type));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  double
+  timeShuffle (const Image &image, std::vector<char> &scratch)
+  {
+    size_t nr_pixels = size_t (image.width) * image.height;
+    scratch.resize (image.data.size ());
+    Clock::time_point start = Clock::now ();
+    if (image.type == "rgb24")
+      pcl::io::deinterleaveRGB24 (&image.data[0], nr_pixels, &scratch[0]);
+    else if (image.type == "yuv422")
+      pcl::io::deinterleaveYUV422 (&image.data[0], nr_pixels, &scratch[0]);
+    else if (image.type == "depth16d")
+      pcl::io::encodeDepth16Delta (&image.data[0], image.width, image.height, &scratch[0]);
+    else
+      return (0.0);
+    return (elapsedMs (start));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  double
+  timeUnshuffle (const Image &image, const std::vector<char> &planar, std::vector<char> &scratch)
+  {
+    size_t nr_pixels = size_t (image.width) * image.height;
+    scratch.resize (planar.size ());
+    Clock::time_point start = Clock::now ();
+    if (image.type == "rgb24")
+      pcl::io::interleaveRGB24 (&planar[0], nr_pixels, &scratch[0]);
+    else if (image.type == "yuv422")
+      pcl::io::interleaveYUV422 (&planar[0], nr_pixels, &scratch[0]);
+    else
+      return (0.0);
+    return (elapsedMs (start));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  template <typename WriterT, typename ReaderT> bool
+  run (const Image &image, const pcl::io::ImageCodec &codec, int iterations, const std::string &scratch_dir, Result &result)
+  {
+    Probe<WriterT> writer;
+    ReaderT reader;
+    if (!writer.setCodec (codec.getId ()))
+      return (false);
+    std::string filename = scratch_dir + "/lzf_image_io_bench_" + image.type + ".pclzf";
+    std::vector<char> shuffled, unshuffled, output;
+
+    result.type = image.type;
+    result.codec = codec.getName ();
+    result.content = image.content;
+    result.width = image.width;
+    result.height = image.height;
+    result.raw_size = image.data.size ();
+    result.shuffle_ms = result.compress_ms = result.write_io_ms = 0.0;
+    result.read_io_ms = result.decompress_ms = result.unshuffle_ms = 0.0;
+
+    // Warm up the buffers and the page cache
+    if (!writer.write (&image.data[0], image.width, image.height, filename))
+      return (false);
+
+    for (int i = 0; i < iterations; ++i)
+    {
+      double shuffle_ms = timeShuffle (image, shuffled);
+
+      Clock::time_point start = Clock::now ();
+      uint32_t blob_size = writer.encode (&image.data[0], image.width, image.height, writer.compressed_buffer_);
+      double encode_ms = elapsedMs (start);
+
+      start = Clock::now ();
+      if (!writer.write (&image.data[0], image.width, image.height, filename) || blob_size == 0)
+        return (false);
+      double write_ms = elapsedMs (start);
+
+      start = Clock::now ();
+      if (!reader.read (filename, output))
+        return (false);
+      double read_ms = elapsedMs (start);
+
+      start = Clock::now ();
+      if (!reader.read (&writer.compressed_buffer_[0], blob_size, output))
+        return (false);
+      double decompress_ms = elapsedMs (start);
+
+      double unshuffle_ms = timeUnshuffle (image, output, unshuffled);
+
+      result.compressed_size = blob_size;
+      result.shuffle_ms += shuffle_ms;
+      result.compress_ms += std::max (encode_ms - shuffle_ms, 0.0);
+      result.write_io_ms += std::max (write_ms - encode_ms, 0.0);
+      result.decompress_ms += decompress_ms;
+      result.read_io_ms += std::max (read_ms - decompress_ms, 0.0);
+      result.unshuffle_ms += unshuffle_ms;
+    }
+
+    result.shuffle_ms /= iterations;
+    result.compress_ms /= iterations;
+    result.write_io_ms /= iterations;
+    result.read_io_ms /= iterations;
+    result.decompress_ms /= iterations;
+    result.unshuffle_ms /= iterations;
+    boost::filesystem::remove (filename);
+    return (true);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  bool
+  runImage (const Image &image, const pcl::io::ImageCodec &codec, int iterations, const std::string &scratch_dir, Result &result)
+  {
+    if (image.type == "depth16")
+      return (run<pcl::io::LZFDepth16ImageWriter, pcl::io::LZFDepth16ImageReader> (image, codec, iterations, scratch_dir, result));
+    if (image.type == "depth16d")
+      return (run<pcl::io::LZFDepth16DeltaImageWriter, pcl::io::LZFDepth16ImageReader> (image, codec, iterations, scratch_dir, result));
+    if (image.type == "rgb24")
+      return (run<pcl::io::LZFRGB24ImageWriter, pcl::io::LZFRGB24ImageReader> (image, codec, iterations, scratch_dir, result));
+    if (image.type == "yuv422")
+      return (run<pcl::io::LZFYUV422ImageWriter, pcl::io::LZFYUV422ImageReader> (image, codec, iterations, scratch_dir, result));
+    if (image.type == "bayer8")
+      return (run<pcl::io::LZFBayer8ImageWriter, pcl::io::LZFBayer8ImageReader> (image, codec, iterations, scratch_dir, result));
+    return (false);
+  }
+
+  double
+  throughput (size_t bytes, double ms)
+  {
+    return (ms > 0.0 ? (double (bytes) / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  std::string
+  toJSON (const std::vector<Result> &results, const std::string &experiment_set, int iterations)
+  {
+    std::ostringstream json;
+    json.precision (6);
+    json << "{\n\t\"experiment_set_" << experiment_set << "\":\n\t[\n";
+    for (size_t i = 0; i < results.size (); ++i)
+    {
+      const Result &r = results[i];
+      double write_ms = r.shuffle_ms + r.compress_ms + r.write_io_ms;
+      double read_ms = r.read_io_ms + r.decompress_ms + r.unshuffle_ms;
+      json << "\t{\n"
+           << "\t\"app\":\"lzf_image_io_bench\",\n"
+           << "\t\"image_type\":\"" << r.type << "\",\n"
+           << "\t\"codec\":\"" << r.codec << "\",\n"
+           << "\t\"content\":\"" << r.content << "\",\n"
+           << "\t\"resolution\":\"" << r.width << "x" << r.height << "\",\n"
+           << "\t\"iterations\":" << iterations << ",\n"
+           << "\t\"raw_bytes\":" << r.raw_size << ",\n"
+           << "\t\"compressed_bytes\":" << r.compressed_size << ",\n"
+           << "\t\"compression_ratio\":" << double (r.raw_size) / std::max<size_t> (r.compressed_size, 1) << ",\n"
+           << "\t\"write_MBps\":" << throughput (r.raw_size, write_ms) << ",\n"
+           << "\t\"read_MBps\":" << throughput (r.raw_size, read_ms) << ",\n"
+           << "\t\"write_shuffle_ms\":" << r.shuffle_ms << ",\n"
+           << "\t\"write_compress_ms\":" << r.compress_ms << ",\n"
+           << "\t\"write_io_ms\":" << r.write_io_ms << ",\n"
+           << "\t\"read_io_ms\":" << r.read_io_ms << ",\n"
+           << "\t\"read_decompress_ms\":" << r.decompress_ms << ",\n"
+           << "\t\"read_unshuffle_ms\":" << r.unshuffle_ms << ",\n"
+           << "\t\"experiment_number\":" << i << "\n"
+           << "\t}" << (i + 1 < results.size () ? "," : "") << "\n";
+    }
+    json << "\t]\n}\n";
+    return (json.str ());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // --verify: fuzzing and round trips. Outputs are followed by a canary, so
+  // that writes past the output size are caught even without a sanitizer.
+  const size_t CANARY_SIZE = 64;
+  const char CANARY = static_cast<char> (0xA5);
+
+  struct Checks
+  {
+    Checks () : nr_checks (0), nr_failures (0) {}
+
+    void
+    check (bool ok, const char *what, const pcl::io::ImageCodec &codec, size_t case_nr, size_t size)
+    {
+      ++nr_checks;
+      if (!ok && nr_failures++ < 20)
+        fprintf (stderr, "FAILED: %s (%s, case %zu, %zu bytes)\n", what, codec.getName (), case_nr, size);
+    }
+
+    size_t nr_checks;
+    size_t nr_failures;
+  };
+
+  void
+  resetOutput (std::vector<char> &buffer, size_t size)
+  {
+    buffer.assign (size + CANARY_SIZE, CANARY);
+  }
+
+  bool
+  canaryIntact (const std::vector<char> &buffer, size_t size)
+  {
+    for (size_t i = size; i < buffer.size (); ++i)
+      if (buffer[i] != CANARY)
+        return (false);
+    return (true);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Fuzz input made of noise, runs, copies of earlier data (at offsets up to
+  // beyond the 8 KB LZF window) and 16-bit ramps, so that literal runs and
+  // back references of every length and offset occur.
+  void
+  makeFuzzInput (std::mt19937 &rng, size_t size, std::vector<char> &data)
+  {
+    data.resize (size);
+    for (size_t i = 0; i < size; )
+    {
+      size_t length = std::min<size_t> (size - i, 1 + rng () % 600);
+      unsigned int kind = rng () % 4;
+      if (kind == 2 && i == 0)
+        kind = 0;
+      if (kind == 0)
+      {
+        for (size_t j = 0; j < length; ++j)
+          data[i + j] = static_cast<char> (rng ());
+      }
+      else if (kind == 1)
+        memset (&data[i], static_cast<int> (rng () % 256), length);
+      else if (kind == 2)
+      {
+        // Byte by byte, the copy overlaps itself for offsets below the length
+        size_t offset = 1 + rng () % std::min<size_t> (i, 9000);
+        for (size_t j = 0; j < length; ++j)
+          data[i + j] = data[i + j - offset];
+      }
+      else
+      {
+        uint16_t value = static_cast<uint16_t> (rng ());
+        int slope = static_cast<int> (rng () % 5) - 2;
+        for (size_t j = 0; j < length; ++j)
+          data[i + j] = static_cast<char> ((j % 2) ? (value + slope * int (j / 2)) >> 8 : value + slope * int (j / 2));
+      }
+      i += length;
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Round trip a random buffer through a codec, and for LZF through the
+  // reference liblzf kernels in both directions. Truncated and corrupted
+  // compressed data must never decompress to the full size or write past
+  // the output; for LZF the kernels must agree with liblzf on it.
+  void
+  fuzzCodec (const pcl::io::ImageCodec &codec, std::mt19937 &rng, size_t case_nr, Checks &checks)
+  {
+    // Mostly small buffers, where the boundary cases are, and some up to 256 KB
+    size_t size = (rng () % 4 == 0) ? 1 + rng () % (256 * 1024) : 1 + rng () % 600;
+    uint32_t input_size = static_cast<uint32_t> (size);
+    bool lzf = (codec.getId () == pcl::io::ImageCodec::LZF);
+    // LZF never needs more than a control byte every 32 literals, the other codecs get some slack
+    size_t bound = lzf ? ((size * 33) >> 5) + 1 : size + size / 16 + 1024;
+    std::vector<char> input, compressed, output, reference;
+    makeFuzzInput (rng, size, input);
+
+    resetOutput (compressed, bound);
+    uint32_t compressed_size = codec.compress (&input[0], input_size, &compressed[0], static_cast<uint32_t> (bound));
+    checks.check (compressed_size > 0 && canaryIntact (compressed, bound), "compress into the worst case size", codec, case_nr, size);
+    if (compressed_size == 0)
+      return;
+
+    resetOutput (output, size);
+    checks.check (codec.decompress (&compressed[0], compressed_size, &output[0], input_size) == input_size &&
+                  memcmp (&output[0], &input[0], size) == 0 && canaryIntact (output, size),
+                  "round trip", codec, case_nr, size);
+
+    resetOutput (output, size - 1);
+    checks.check (codec.decompress (&compressed[0], compressed_size, &output[0], input_size - 1) == 0 &&
+                  canaryIntact (output, size - 1), "reject an output one byte short", codec, case_nr, size);
+
+    if (lzf)
+    {
+      resetOutput (output, size);
+      checks.check (pcl::lzfDecompress (&compressed[0], compressed_size, &output[0], input_size) == input_size &&
+                    memcmp (&output[0], &input[0], size) == 0, "liblzf decompresses the output", codec, case_nr, size);
+
+      // liblzf checks the output space conservatively and can give up just short of the worst case size
+      size_t reference_bound = size + size / 16 + 16;
+      resetOutput (reference, reference_bound);
+      unsigned int reference_size = pcl::lzfCompress (&input[0], input_size, &reference[0], static_cast<unsigned int> (reference_bound));
+      resetOutput (output, size);
+      checks.check (reference_size > 0 && codec.decompress (&reference[0], reference_size, &output[0], input_size) == input_size &&
+                    memcmp (&output[0], &input[0], size) == 0 && canaryIntact (output, size),
+                    "decompress the output of liblzf", codec, case_nr, size);
+    }
+
+    for (int i = 0; i < 8; ++i)
+    {
+      // Half of the attempts truncate the data, the others flip a few bytes
+      std::vector<char> damaged (compressed.begin (), compressed.begin () + compressed_size);
+      bool truncated = (i % 2 == 0);
+      if (truncated)
+        damaged.resize (rng () % compressed_size);
+      else
+        for (unsigned int n = 1 + rng () % 4; n > 0; --n)
+          damaged[rng () % compressed_size] ^= static_cast<char> (1 + rng () % 255);
+      uint32_t damaged_size = static_cast<uint32_t> (damaged.size ());
+      damaged.resize (damaged_size + 1);    // &damaged[0] stays valid when truncated to nothing
+
+      resetOutput (output, size);
+      uint32_t result = codec.decompress (&damaged[0], damaged_size, &output[0], input_size);
+      checks.check (result <= input_size && canaryIntact (output, size) && (!truncated || result != input_size),
+                    truncated ? "reject truncated data" : "stay within the output on corrupted data", codec, case_nr, size);
+      if (!lzf)
+        continue;
+      resetOutput (reference, size);
+      unsigned int reference_result = pcl::lzfDecompress (&damaged[0], damaged_size, &reference[0], input_size);
+      checks.check (result == reference_result && memcmp (&output[0], &reference[0], result) == 0,
+                    truncated ? "agree with liblzf on truncated data" : "agree with liblzf on corrupted data", codec, case_nr, size);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Random depth image: smooth surfaces with invalid pixels, plus noise and far outliers
+  std::vector<char>
+  makeFuzzDepth (std::mt19937 &rng, uint32_t width, uint32_t height)
+  {
+    std::vector<char> depth = makeSynthetic ("depth16", width, height, rng ()).data;
+    size_t nr_pixels = size_t (width) * height;
+    for (size_t n = rng () % (nr_pixels / 8 + 1); n > 0; --n)
+    {
+      uint16_t value = (rng () % 4 == 0) ? 65535 : static_cast<uint16_t> (rng ());
+      memcpy (&depth[(rng () % nr_pixels) * 2], &value, sizeof (uint16_t));
+    }
+    return (depth);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Compare a depth image read back with the one written: exactly if
+  // max_depth is 0, else with the "depth16q" guarantees (invalid pixels stay
+  // 0, depth beyond max_depth reads max_depth + 1, any other value is off by
+  // at most max_error depth units).
+  bool
+  depthMatches (const std::vector<char> &expected, const std::vector<char> &actual, uint32_t max_depth, double max_error)
+  {
+    if (max_depth == 0 || actual.size () != expected.size ())
+      return (actual == expected);
+    for (size_t i = 0; i < expected.size () / 2; ++i)
+    {
+      uint16_t x, y;
+      memcpy (&x, &expected[i * 2], sizeof (uint16_t));
+      memcpy (&y, &actual[i * 2], sizeof (uint16_t));
+      if (x == 0 && y != 0)
+        return (false);
+      if (x > max_depth && y != max_depth + 1)
+        return (false);
+      if (x > 0 && x <= max_depth && (y == 0 || y > max_depth || std::fabs (double (x) - y) > max_error))
+        return (false);
+    }
+    return (true);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Round trip random depth images as "depth16d", "depth16q" and "depth16t"
+  // (a stream of slowly changing images, read in order and in random order).
+  void
+  fuzzDepthImages (const pcl::io::ImageCodec &codec, std::mt19937 &rng, size_t case_nr,
+                   const std::string &filename, Checks &checks)
+  {
+    uint32_t width = 1 + rng () % 160, height = 1 + rng () % 120;
+    std::vector<char> depth = makeFuzzDepth (rng, width, height), output;
+    pcl::io::LZFDepth16ImageReader reader;
+
+    Probe<pcl::io::LZFDepth16DeltaImageWriter> delta_writer;
+    delta_writer.setCodec (codec.getId ());
+    uint32_t blob_size = delta_writer.encode (&depth[0], width, height, delta_writer.compressed_buffer_);
+    checks.check (blob_size > 0 && reader.read (&delta_writer.compressed_buffer_[0], blob_size, output) && output == depth,
+                  "depth16d round trip", codec, case_nr, depth.size ());
+    if (blob_size > 0)
+      checks.check (!reader.read (&delta_writer.compressed_buffer_[0], rng () % blob_size, output),
+                    "reject a truncated depth16d image", codec, case_nr, depth.size ());
+
+    // Ranges of 0.5 to 10.4 m, errors of 0.5 mm to 10 cm
+    double max_range = 0.5 + (rng () % 100) * 0.1, max_error = 0.0005 * (1 + rng () % 200);
+    uint32_t max_depth = static_cast<uint32_t> (std::floor (max_range * 1000.0 + 1e-6));
+    Probe<pcl::io::LZFDepth16ImageWriter> quantized_writer;
+    quantized_writer.setCodec (codec.getId ());
+    bool quantized = quantized_writer.setQuantization (max_range, max_error);
+    double max_depth_error = quantized_writer.getQuantizationError () * 1000.0 + 1e-6;
+    blob_size = quantized ? quantized_writer.encode (&depth[0], width, height, quantized_writer.compressed_buffer_) : 0;
+    checks.check (blob_size > 0 && reader.read (&quantized_writer.compressed_buffer_[0], blob_size, output) &&
+                  depthMatches (depth, output, max_depth, max_depth_error),
+                  "depth16q round trip within the quantization error", codec, case_nr, depth.size ());
+
+    pcl::io::LZFDepth16TemporalImageWriter temporal_writer;
+    temporal_writer.setCodec (codec.getId ());
+    temporal_writer.setKeyframeInterval (1 + rng () % 12);
+    bool temporal_quantized = (rng () % 3 == 0);
+    if (temporal_quantized)
+      temporal_writer.setQuantization (max_range, max_error);
+    pcl::io::LZFStreamWriter stream_writer;
+    if (!stream_writer.open (filename, 1024 * 1024))
+    {
+      checks.check (false, "open the scratch stream", codec, case_nr, 0);
+      return;
+    }
+    std::vector<std::vector<char> > frames;
+    for (size_t t = 0, nr_frames = 2 + rng () % 30; t < nr_frames; ++t)
+    {
+      if (t > 0 && rng () % 16 == 0)
+      {
+        // A size change starts a new keyframe
+        width = 1 + rng () % 160;
+        height = 1 + rng () % 120;
+        depth = makeFuzzDepth (rng, width, height);
+      }
+      else if (t > 0)
+      {
+        size_t nr_pixels = size_t (width) * height;
+        for (size_t n = rng () % (nr_pixels / 4 + 1); n > 0; --n)
+        {
+          size_t idx = rng () % nr_pixels;
+          uint16_t value;
+          memcpy (&value, &depth[idx * 2], sizeof (uint16_t));
+          value = (rng () % 16 == 0) ? static_cast<uint16_t> (rng ()) : static_cast<uint16_t> (value + rng () % 21 - 10);
+          memcpy (&depth[idx * 2], &value, sizeof (uint16_t));
+        }
+      }
+      frames.push_back (depth);
+      checks.check (temporal_writer.write (&depth[0], width, height, stream_writer, t),
+                    "write a depth16t stream", codec, case_nr, depth.size ());
+    }
+    stream_writer.close ();
+
+    pcl::io::LZFStreamReader stream;
+    if (!stream.open (filename) || stream.getNumberOfFrames () != frames.size ())
+    {
+      checks.check (false, "read back the depth16t stream", codec, case_nr, 0);
+      return;
+    }
+    uint32_t stream_max_depth = temporal_quantized ? max_depth : 0;
+    pcl::io::LZFDepth16ImageReader in_order;
+    for (size_t i = 0; i < frames.size (); ++i)
+    {
+      const char *blob;
+      uint32_t frame_size;
+      checks.check (stream.getFrame (i, blob, frame_size) && in_order.read (blob, frame_size, output) &&
+                    depthMatches (frames[i], output, stream_max_depth, max_depth_error),
+                    "depth16t round trip in order", codec, case_nr, frames[i].size ());
+    }
+
+    std::vector<size_t> order (frames.size ());
+    for (size_t i = 0; i < order.size (); ++i)
+      order[i] = i;
+    std::shuffle (order.begin (), order.end (), rng);
+    pcl::io::LZFDepth16ImageReader random_access, blob_reader;
+    for (size_t i = 0; i < order.size (); ++i)
+    {
+      const std::vector<char> &frame = frames[order[i]];
+      checks.check (random_access.read (stream, order[i], output) && depthMatches (frame, output, stream_max_depth, max_depth_error),
+                    "depth16t round trip in random order", codec, case_nr, frame.size ());
+      // Decoding a blob against whatever image came before it must fail rather than return a wrong image
+      const char *blob;
+      uint32_t frame_size;
+      stream.getFrame (order[i], blob, frame_size);
+      checks.check (!blob_reader.read (blob, frame_size, output) || depthMatches (frame, output, stream_max_depth, max_depth_error),
+                    "never return a depth16t image decoded against the wrong reference", codec, case_nr, frame.size ());
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Depth image tagged with its timestamp, so that every image handed out by
+  // the concurrent components can be checked against the one written.
+  void
+  stampDepth (const std::vector<char> &base, uint64_t timestamp, std::vector<char> &depth)
+  {
+    depth = base;
+    memcpy (&depth[0], &timestamp, std::min (sizeof (uint64_t), depth.size ()));
+    for (size_t i = 8; i + 1 < depth.size (); i += 4099)
+      depth[i] = static_cast<char> (timestamp * 31 + i);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Read back a stream and check that its timestamps increase and that every
+  // image is the one stamped with its timestamp.
+  bool
+  checkStampedStream (const std::string &filename, const std::vector<char> &base, size_t &nr_frames)
+  {
+    pcl::io::LZFStreamReader stream;
+    nr_frames = 0;
+    if (!stream.open (filename))
+      return (false);
+    pcl::io::LZFDepth16ImageReader reader;
+    std::vector<char> output, expected;
+    for (size_t i = 0; i < stream.getNumberOfFrames (); ++i)
+    {
+      if (i > 0 && stream.getTimestamp (i) <= stream.getTimestamp (i - 1))
+        return (false);
+      stampDepth (base, stream.getTimestamp (i), expected);
+      if (!reader.read (stream, i, output) || output != expected)
+        return (false);
+    }
+    nr_frames = stream.getNumberOfFrames ();
+    return (true);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Async writer: every image submitted is either written or counted as
+  // dropped, under each queue policy, and the stream holds what was written.
+  void
+  verifyAsyncWriter (const pcl::io::ImageCodec &codec, size_t round, const std::string &filename, Checks &checks)
+  {
+    const uint32_t width = 320, height = 240;
+    std::vector<char> base = makeSynthetic ("depth16", width, height, static_cast<unsigned int> (round)).data, depth;
+    const pcl::io::LZFAsyncImageWriter::QueuePolicy policies[] = {pcl::io::LZFAsyncImageWriter::BLOCK,
+                                                                 pcl::io::LZFAsyncImageWriter::DROP_OLDEST,
+                                                                 pcl::io::LZFAsyncImageWriter::DROP_NEWEST};
+    for (size_t p = 0; p < sizeof (policies) / sizeof (policies[0]); ++p)
+    {
+      pcl::io::LZFDepth16ImageWriter writer;
+      writer.setCodec (codec.getId ());
+      pcl::io::LZFStreamWriter stream_writer;
+      if (!stream_writer.open (filename, 1024 * 1024))
+      {
+        checks.check (false, "open the scratch stream", codec, round, 0);
+        return;
+      }
+      // A short queue, so that the producer outruns the background thread
+      pcl::io::LZFAsyncImageWriter async_writer (writer, 2, policies[p]);
+      const uint64_t nr_submitted = 200;
+      uint64_t nr_refused = 0;
+      for (uint64_t t = 1; t <= nr_submitted; ++t)
+      {
+        stampDepth (base, t, depth);
+        if (!async_writer.write (&depth[0], width, height, stream_writer, t))
+          ++nr_refused;
+      }
+      async_writer.stop ();
+      stream_writer.close ();
+
+      uint64_t written = async_writer.getNumberOfWrittenFrames (), dropped = async_writer.getNumberOfDroppedFrames ();
+      checks.check (written + dropped == nr_submitted && async_writer.getNumberOfFailedFrames () == 0,
+                    "async writer: written + dropped == submitted", codec, round, depth.size ());
+      checks.check (policies[p] != pcl::io::LZFAsyncImageWriter::BLOCK || dropped == 0,
+                    "async writer: BLOCK never drops", codec, round, depth.size ());
+      checks.check (policies[p] != pcl::io::LZFAsyncImageWriter::DROP_NEWEST || dropped == nr_refused,
+                    "async writer: DROP_NEWEST drops the refused images", codec, round, depth.size ());
+      size_t nr_frames;
+      checks.check (checkStampedStream (filename, base, nr_frames) && nr_frames == written,
+                    "async writer: the stream holds the written images, in order", codec, round, depth.size ());
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Flight recorder: a trigger from another thread while images are appended
+  // produces a readable stream with increasing timestamps.
+  void
+  verifyFlightRecorder (const pcl::io::ImageCodec &codec, size_t round, const std::string &filename, Checks &checks)
+  {
+    const uint32_t width = 160, height = 120;
+    std::vector<char> base = makeSynthetic ("depth16", width, height, static_cast<unsigned int> (round)).data, depth;
+    pcl::io::LZFDepth16ImageWriter writer;
+    writer.setCodec (codec.getId ());
+    pcl::io::LZFFlightRecorder recorder (1024 * 1024);
+
+    std::atomic<uint64_t> appended (0);
+    std::atomic<bool> triggered (false), flushed (false), done (false);
+    std::thread trigger_thread ([&] ()
+    {
+      while (appended.load () < 50)
+        std::this_thread::yield ();
+      triggered = recorder.trigger (filename, 5);
+      flushed = recorder.waitForFlush ();
+      done = true;
+    });
+    // Keep appending until the flush, including the post trigger time, is over
+    for (uint64_t t = 1; !done.load () || appended.load () < 100; ++t)
+    {
+      stampDepth (base, t, depth);
+      if (writer.write (&depth[0], width, height, recorder, t))
+        appended.fetch_add (1);
+    }
+    trigger_thread.join ();
+
+    size_t nr_frames;
+    checks.check (triggered.load () && flushed.load () && checkStampedStream (filename, base, nr_frames) &&
+                  nr_frames > 0 && nr_frames == recorder.getNumberOfFlushedFrames (),
+                  "flight recorder: a trigger while appending writes a readable stream in order", codec, round, depth.size ());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Shared memory ring: lost images are counted as overruns, an image
+  // overwritten while it is consumed is rejected, and a reader racing a
+  // writer thread only ever gets intact images.
+  void
+  verifySharedRing (const pcl::io::ImageCodec &codec, size_t round, Checks &checks)
+  {
+    const uint32_t width = 160, height = 120, nr_slots = 4;
+    std::vector<char> base = makeSynthetic ("depth16", width, height, static_cast<unsigned int> (round)).data, depth, output, expected;
+    std::ostringstream name;
+    name << "/lzf_image_io_bench_verify_" << getpid ();
+    pcl::io::LZFDepth16ImageWriter writer;
+    writer.setCodec (codec.getId ());
+    pcl::io::LZFDepth16ImageReader reader;
+    pcl::io::LZFSharedRingWriter ring_writer;
+    pcl::io::LZFSharedRingReader ring_reader;
+    if (!ring_writer.create (name.str (), nr_slots, static_cast<uint32_t> (base.size () * 2 + 4096)) ||
+        !ring_reader.open (name.str ()))
+    {
+      checks.check (false, "shared ring: create and attach", codec, round, 0);
+      return;
+    }
+
+    // More images than slots before the reader looks: every image is either read or an overrun
+    const uint64_t nr_images = 3 * nr_slots;
+    for (uint64_t t = 1; t <= nr_images; ++t)
+    {
+      stampDepth (base, t, depth);
+      writer.write (&depth[0], width, height, ring_writer, t);
+    }
+    uint64_t nr_read = 0, timestamp = 0, last = 0;
+    bool intact = true;
+    while (ring_reader.read (reader, output, timestamp, 10))
+    {
+      stampDepth (base, timestamp, expected);
+      intact = intact && output == expected && timestamp > last;
+      last = timestamp;
+      ++nr_read;
+    }
+    checks.check (intact && nr_read > 0 && nr_read <= nr_slots && nr_read + ring_reader.getNumberOfOverruns () == nr_images,
+                  "shared ring: read + overruns == published", codec, round, depth.size ());
+
+    // Overwrite the image under the reader while it is consumed: it has to be
+    // rejected, and the reader moves on to an image written after it
+    const uint64_t torn = ++last;
+    stampDepth (base, torn, depth);
+    writer.write (&depth[0], width, height, ring_writer, torn);
+    uint64_t overruns = ring_reader.getNumberOfOverruns ();
+    timestamp = 0;
+    bool consumed = ring_reader.consume ([&] (const char*, uint32_t, uint64_t frame_timestamp) -> bool
+    {
+      if (frame_timestamp == torn)
+      {
+        for (uint32_t i = 0; i < nr_slots; ++i)
+        {
+          stampDepth (base, ++last, depth);
+          writer.write (&depth[0], width, height, ring_writer, last);
+        }
+      }
+      timestamp = frame_timestamp;
+      return (true);
+    }, 100);
+    checks.check (consumed && timestamp > torn && ring_reader.getNumberOfOverruns () > overruns,
+                  "shared ring: reject an image overwritten while consumed", codec, round, depth.size ());
+
+    // A writer thread racing the reader
+    ring_reader.setSkipToLatest (true);
+    while (ring_reader.read (reader, output, timestamp, 1))
+      ;
+    uint64_t first = last + 1;
+    std::thread writer_thread ([&] ()
+    {
+      std::vector<char> image;
+      for (uint64_t t = first; t < first + 300; ++t)
+      {
+        stampDepth (base, t, image);
+        writer.write (&image[0], width, height, ring_writer, t);
+      }
+      ring_writer.close ();
+    });
+    ring_reader.setSkipToLatest (false);
+    intact = true;
+    last = 0;
+    nr_read = 0;
+    while (ring_reader.read (reader, output, timestamp, 100))
+    {
+      stampDepth (base, timestamp, expected);
+      intact = intact && output == expected && timestamp > last;
+      last = timestamp;
+      ++nr_read;
+    }
+    writer_thread.join ();
+    checks.check (intact, "shared ring: a reader racing the writer only gets intact images, in order", codec, round, depth.size ());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  bool
+  verify (const std::vector<const pcl::io::ImageCodec*> &codecs, size_t nr_cases, unsigned int seed, const std::string &scratch_dir)
+  {
+    // Damaged data is expected to be rejected, with an error message each time
+    pcl::console::setVerbosityLevel (pcl::console::L_ALWAYS);
+    std::string filename = scratch_dir + "/lzf_image_io_bench_verify.pclzs";
+    std::mt19937 rng (seed);
+    Checks checks;
+    for (size_t n = 0; n < nr_cases; ++n)
+    {
+      const pcl::io::ImageCodec &codec = *codecs[n % codecs.size ()];
+      fuzzCodec (codec, rng, n, checks);
+      // The image round trips cost far more than a buffer, run them on a part of the cases
+      if (n % 16 == 0)
+        fuzzDepthImages (codec, rng, n, filename, checks);
+    }
+    // The concurrent components, a round per 5000 cases and codec
+    for (size_t round = 0; round < std::max<size_t> (nr_cases / 5000, 1); ++round)
+    {
+      for (size_t c = 0; c < codecs.size (); ++c)
+      {
+        verifyAsyncWriter (*codecs[c], round, filename, checks);
+        verifyFlightRecorder (*codecs[c], round, filename, checks);
+        verifySharedRing (*codecs[c], round, checks);
+      }
+    }
+    boost::filesystem::remove (filename);
+    printf ("%zu cases, %zu checks, %zu failed (seed %u)\n", nr_cases, checks.nr_checks, checks.nr_failures, seed);
+    return (checks.nr_failures == 0);
+  }
+
+  void
+  printUsage (const char *name)
+  {
+    printf ("Usage: %s [--resolutions 640x480,1280x720,1920x1080] [--iterations 50]\n"
+            "       [--recorded dir_with_pclzf_files] [--dir scratch_dir]\n"
+            "       [--output stats.json] [--experiment_set 0]\n"
+            "       [--codecs lzf,lz4,zstd]\n"
+            "       %s --verify 20000 [--seed 42] [--codecs lzf,lz4,zstd] [--dir scratch_dir]\n", name, name);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  std::string resolutions = "320x240,640x480,1280x720,1920x1080";
+  std::string recorded_dir, output_file, experiment_set = "0", codec_names = "lzf";
+  std::string scratch_dir = boost::filesystem::temp_directory_path ().string ();
+  int iterations = 50;
+  size_t verify_cases = 0;
+  unsigned int seed = 42;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help")
+    {
+      printUsage (argv[0]);
+      return (0);
+    }
+    if (i + 1 >= argc)
+    {
+      printUsage (argv[0]);
+      return (1);
+    }
+    if (arg == "--resolutions")
+      resolutions = argv[++i];
+    else if (arg == "--iterations")
+      iterations = std::max (atoi (argv[++i]), 1);
+    else if (arg == "--recorded")
+      recorded_dir = argv[++i];
+    else if (arg == "--dir")
+      scratch_dir = argv[++i];
+    else if (arg == "--output")
+      output_file = argv[++i];
+    else if (arg == "--experiment_set")
+      experiment_set = argv[++i];
+    else if (arg == "--codecs")
+      codec_names = argv[++i];
+    else if (arg == "--verify")
+      verify_cases = std::max (atoi (argv[++i]), 1);
+    else if (arg == "--seed")
+      seed = static_cast<unsigned int> (strtoul (argv[++i], NULL, 10));
+    else
+    {
+      printUsage (argv[0]);
+      return (1);
+    }
+  }
+
+  std::vector<const pcl::io::ImageCodec*> codecs;
+  std::stringstream codec_list (codec_names);
+  std::string codec_name;
+  while (std::getline (codec_list, codec_name, ','))
+  {
+    const pcl::io::ImageCodec *codec = pcl::io::ImageCodec::get (codec_name);
+    if (codec == NULL)
+    {
+      fprintf (stderr, "Codec %s is unknown or not compiled into pcl_io\n", codec_name.c_str ());
+      return (1);
+    }
+    codecs.push_back (codec);
+  }
+  if (codecs.empty ())
+  {
+    printUsage (argv[0]);
+    return (1);
+  }
+
+  if (verify_cases > 0)
+    return (verify (codecs, verify_cases, seed, scratch_dir) ? 0 : 1);
+
+  // Collect the images to benchmark
+  std::vector<Image> images;
+  if (!recorded_dir.empty ())
+  {
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator it (recorded_dir); it != end; ++it)
+    {
+      if (it->path ().extension () != ".pclzf")
+        continue;
+      Image image;
+      if (loadRecorded (it->path ().string (), image))
+      {
+        images.push_back (image);
+        if (image.type == "depth16")
+        {
+          images.push_back (image);
+          images.back ().type = "depth16d";
+        }
+      }
+      else
+        fprintf (stderr, "Skipping %s: not a supported PCLZF image\n", it->path ().string ().c_str ());
+    }
+  }
+  else
+  {
+    const char *types[] = {"depth16", "depth16d", "rgb24", "yuv422", "bayer8"};
+    std::stringstream ss (resolutions);
+    std::string resolution;
+    while (std::getline (ss, resolution, ','))
+    {
+      unsigned int width, height;
+      if (sscanf (resolution.c_str (), "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+      {
+        fprintf (stderr, "Invalid resolution %s\n", resolution.c_str ());
+        return (1);
+      }
+      for (size_t t = 0; t < sizeof (types) / sizeof (types[0]); ++t)
+        images.push_back (makeSynthetic (types[t], width, height, 42));
+    }
+  }
+
+  printf ("%-9s %-5s %-11s %-20s %7s %10s %10s %9s %9s %9s %9s %9s %9s\n",
+          "type", "codec", "resolution", "content", "ratio", "write MB/s", "read MB/s",
+          "shuf ms", "comp ms", "wio ms", "rio ms", "dec ms", "unsh ms");
+  std::vector<Result> results;
+  for (size_t n = 0; n < images.size () * codecs.size (); ++n)
+  {
+    const Image &image = images[n / codecs.size ()];
+    const pcl::io::ImageCodec &codec = *codecs[n % codecs.size ()];
+    Result r;
+    if (!runImage (image, codec, iterations, scratch_dir, r))
+    {
+      fprintf (stderr, "Failed to benchmark %s %ux%u with %s\n", image.type.c_str (), image.width, image.height, codec.getName ());
+      continue;
+    }
+    char resolution[32];
+    snprintf (resolution, sizeof (resolution), "%ux%u", r.width, r.height);
+    printf ("%-9s %-5s %-11s %-20.20s %7.2f %10.1f %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+            r.type.c_str (), r.codec.c_str (), resolution, r.content.c_str (),
+            double (r.raw_size) / std::max<size_t> (r.compressed_size, 1),
+            throughput (r.raw_size, r.shuffle_ms + r.compress_ms + r.write_io_ms),
+            throughput (r.raw_size, r.read_io_ms + r.decompress_ms + r.unshuffle_ms),
+            r.shuffle_ms, r.compress_ms, r.write_io_ms, r.read_io_ms, r.decompress_ms, r.unshuffle_ms);
+    results.push_back (r);
+  }
+
+  if (!output_file.empty ())
+  {
+    std::ofstream out (output_file.c_str ());
+    out << toJSON (results, experiment_set, iterations);
+    if (!out)
+    {
+      fprintf (stderr, "Could not write %s\n", output_file.c_str ());
+      return (1);
+    }
+  }
+  return (results.size () == images.size () * codecs.size () ? 0 : 1);
+}
@@ -0,0 +1,420 @@
+// Closed-loop replay of recorded PCL-LZF sequences, standing in for Unreal/AirSim.
+//
+// A sensor thread publishes the frames of a recorded depth sequence (and,
+// optionally, an RGB sequence) at a fixed rate with random timing jitter.
+// Like a ROS subscriber with a queue size of 1, the perception front-end only
+// ever sees the latest frame: frames it was too busy to pick up are dropped.
+// For every frame the front-end
+//   * decompresses the depth image straight into a point cloud, cropped at
+//     the sensor range (LZFDepth16ImageReader's fused read path),
+//   * inserts the points into a voxel set at the mapping resolution,
+//   * decompresses the RGB image, if any.
+//
+// Measured: end-to-end latency (from the publication of a frame to the end of
+// its processing), deadline misses (frames processed after the deadline, plus
+// dropped frames) and throughput. Results are printed and written as a single
+// flat JSON object, which test_benches/scripts/clct_data_replay.py merges into
+// a stats.json file.
+//
+// Frames are picked by publication number, so temporal ("depth16t")
+// recordings, whose frames can only be decoded in order, are not supported.
+//
+// Built by build_scripts/companion_root_setup.bash against the installed PCL.
+// Usage:
+//   lzf_replay --depth depth.pclzs|dir [--rgb rgb.pclzs|dir] [--parameters depth.xml]
+//              [--rate 30] [--jitter_ms 2] [--deadline_ms 1000/rate]
+//              [--duration 60] [--sensor_max_range 7] [--mapping_resolution 0.1]
+//              [--stride 1] [--seed 42] [--output replay.json]
+
+#include <pcl/io/lzf_image_io.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  double
+  elapsedMs (const Clock::time_point &start, const Clock::time_point &end)
+  {
+    return (std::chrono::duration<double, std::milli> (end - start).count ());
+  }
+
+  // The compressed frames of a PCLZS stream, or of a directory of PCLZF files loaded in memory
+  class Sequence
+  {
+    public:
+      bool
+      open (const std::string &path)
+      {
+        if (!boost::filesystem::is_directory (path))
+          return (stream_.open (path) && stream_.getNumberOfFrames () > 0);
+
+        std::vector<std::string> filenames;
+        boost::filesystem::directory_iterator end;
+        for (boost::filesystem::directory_iterator it (path); it != end; ++it)
+          if (it->path ().extension () == ".pclzf")
+            filenames.push_back (it->path ().string ());
+        std::sort (filenames.begin (), filenames.end ());
+
+        // Load everything up front, so that the replay does not measure the disk
+        for (size_t i = 0; i < filenames.size (); ++i)
+        {
+          std::ifstream file (filenames[i].c_str (), std::ios::binary);
+          std::vector<char> blob ((std::istreambuf_iterator<char> (file)), std::istreambuf_iterator<char> ());
+          if (!blob.empty ())
+            files_.push_back (blob);
+        }
+        return (!files_.empty ());
+      }
+
+      size_t
+      size () const
+      {
+        return (files_.empty () ? stream_.getNumberOfFrames () : files_.size ());
+      }
+
+      bool
+      getFrame (size_t index, const char* &blob, uint32_t &blob_size) const
+      {
+        if (files_.empty ())
+          return (stream_.getFrame (index, blob, blob_size));
+        blob = &files_[index][0];
+        blob_size = static_cast<uint32_t> (files_[index].size ());
+        return (true);
+      }
+
+    private:
+      pcl::io::LZFStreamReader stream_;
+      std::vector<std::vector<char> > files_;
+  };
+
+  struct Options
+  {
+    std::string depth;
+    std::string rgb;
+    std::string parameters;
+    std::string output;
+    double rate;
+    double jitter_ms;
+    double deadline_ms;
+    double duration;
+    float sensor_max_range;
+    float mapping_resolution;
+    unsigned int stride;
+    unsigned int seed;
+  };
+
+  // The single slot between the sensor and the front-end
+  struct Mailbox
+  {
+    std::mutex mutex;
+    std::condition_variable published;
+    bool full;
+    bool done;
+    size_t frame;
+    Clock::time_point stamp;
+    size_t dropped;
+  };
+
+  struct Stats
+  {
+    size_t published;
+    size_t processed;
+    size_t failed;
+    size_t deadline_misses;
+    std::vector<double> latencies_ms;
+    double processing_ms;
+    size_t points;
+    size_t voxels;
+    double wall_s;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////
+  void
+  publish (const Options &options, Mailbox &mailbox, Stats &stats)
+  {
+    std::mt19937 generator (options.seed);
+    std::uniform_real_distribution<double> jitter (-options.jitter_ms, options.jitter_ms);
+    const std::chrono::duration<double, std::milli> period (1000.0 / options.rate);
+    const Clock::time_point start = Clock::now ();
+    const Clock::time_point stop = start + std::chrono::duration_cast<Clock::duration> (std::chrono::duration<double> (options.duration));
+
+    Clock::time_point last = start;
+    for (size_t k = 0; ; ++k)
+    {
+      Clock::time_point due = start + std::chrono::duration_cast<Clock::duration> (period * double (k) + std::chrono::duration<double, std::milli> (jitter (generator)));
+      due = std::max (due, last);
+      if (due >= stop)
+        break;
+      std::this_thread::sleep_until (due);
+      last = due;
+
+      std::lock_guard<std::mutex> lock (mailbox.mutex);
+      if (mailbox.full)
+        ++mailbox.dropped;
+      mailbox.full = true;
+      mailbox.frame = k;
+      mailbox.stamp = Clock::now ();
+      ++stats.published;
+      mailbox.published.notify_one ();
+    }
+
+    std::lock_guard<std::mutex> lock (mailbox.mutex);
+    mailbox.done = true;
+    mailbox.published.notify_one ();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  inline uint64_t
+  voxelKey (const pcl::PointXYZ &p, float inv_resolution)
+  {
+    // 21 bits per axis, enough for +-100 km at 0.1 m
+    uint64_t x = static_cast<uint64_t> (static_cast<int64_t> (std::floor (p.x * inv_resolution)) & 0x1fffff);
+    uint64_t y = static_cast<uint64_t> (static_cast<int64_t> (std::floor (p.y * inv_resolution)) & 0x1fffff);
+    uint64_t z = static_cast<uint64_t> (static_cast<int64_t> (std::floor (p.z * inv_resolution)) & 0x1fffff);
+    return ((x << 42) | (y << 21) | z);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  void
+  process (const Options &options, const Sequence &depth, const Sequence *rgb,
+           Mailbox &mailbox, Stats &stats)
+  {
+    pcl::io::LZFDepth16ImageReader depth_reader;
+    pcl::io::LZFRGB24ImageReader rgb_reader;
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    std::vector<char> image;
+    std::unordered_set<uint64_t> voxels;
+    const float inv_resolution = 1.0f / options.mapping_resolution;
+    const char *blob;
+    uint32_t blob_size;
+
+    if (options.parameters.empty () || !depth_reader.readParameters (options.parameters))
+    {
+      // AirSim's default camera: 90 degrees horizontal field of view
+      if (depth.getFrame (0, blob, blob_size))
+        depth_reader.read (blob, blob_size, image);
+      pcl::io::CameraParameters parameters;
+      parameters.focal_length_x = parameters.focal_length_y = depth_reader.getWidth () / 2.0;
+      parameters.principal_point_x = depth_reader.getWidth () / 2.0;
+      parameters.principal_point_y = depth_reader.getHeight () / 2.0;
+      depth_reader.setParameters (parameters);
+    }
+
+    for (;;)
+    {
+      size_t k;
+      Clock::time_point stamp;
+      {
+        std::unique_lock<std::mutex> lock (mailbox.mutex);
+        while (!mailbox.full && !mailbox.done)
+          mailbox.published.wait (lock);
+        if (!mailbox.full)
+          return;
+        mailbox.full = false;
+        k = mailbox.frame;
+        stamp = mailbox.stamp;
+      }
+
+      Clock::time_point start = Clock::now ();
+      bool ok = depth.getFrame (k % depth.size (), blob, blob_size);
+      ok = ok && depth_reader.read (blob, blob_size, cloud, 0.0f, options.sensor_max_range, options.stride);
+      if (ok)
+      {
+        for (size_t i = 0; i < cloud.points.size (); ++i)
+          if (std::isfinite (cloud.points[i].z))
+          {
+            voxels.insert (voxelKey (cloud.points[i], inv_resolution));
+            ++stats.points;
+          }
+      }
+      if (ok && rgb)
+        ok = rgb->getFrame (k % rgb->size (), blob, blob_size) && rgb_reader.readInterleaved (blob, blob_size, image);
+      Clock::time_point end = Clock::now ();
+
+      double latency_ms = elapsedMs (stamp, end);
+      stats.processing_ms += elapsedMs (start, end);
+      stats.latencies_ms.push_back (latency_ms);
+      ++stats.processed;
+      if (!ok)
+        ++stats.failed;
+      if (latency_ms > options.deadline_ms)
+        ++stats.deadline_misses;
+      stats.voxels = voxels.size ();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  double
+  percentile (std::vector<double> values, double p)
+  {
+    if (values.empty ())
+      return (0.0);
+    size_t n = std::min (values.size () - 1, static_cast<size_t> (p * double (values.size ())));
+    std::nth_element (values.begin (), values.begin () + n, values.end ());
+    return (values[n]);
+  }
+
+  void
+  printUsage (const char *name)
+  {
+    printf ("Usage: %s --depth depth.pclzs|dir [--rgb rgb.pclzs|dir] [--parameters depth.xml]\n"
+            "       [--rate 30] [--jitter_ms 2] [--deadline_ms 1000/rate] [--duration 60]\n"
+            "       [--sensor_max_range 7] [--mapping_resolution 0.1] [--stride 1]\n"
+            "       [--seed 42] [--output replay.json]\n", name);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  Options options;
+  options.rate = 30.0;
+  options.jitter_ms = 2.0;
+  options.deadline_ms = 0.0;
+  options.duration = 60.0;
+  options.sensor_max_range = 7.0f;
+  options.mapping_resolution = 0.1f;
+  options.stride = 1;
+  options.seed = 42;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help")
+    {
+      printUsage (argv[0]);
+      return (0);
+    }
+    if (i + 1 >= argc)
+    {
+      printUsage (argv[0]);
+      return (1);
+    }
+    if (arg == "--depth")
+      options.depth = argv[++i];
+    else if (arg == "--rgb")
+      options.rgb = argv[++i];
+    else if (arg == "--parameters")
+      options.parameters = argv[++i];
+    else if (arg == "--output")
+      options.output = argv[++i];
+    else if (arg == "--rate")
+      options.rate = atof (argv[++i]);
+    else if (arg == "--jitter_ms")
+      options.jitter_ms = std::max (atof (argv[++i]), 0.0);
+    else if (arg == "--deadline_ms")
+      options.deadline_ms = atof (argv[++i]);
+    else if (arg == "--duration")
+      options.duration = atof (argv[++i]);
+    else if (arg == "--sensor_max_range")
+      options.sensor_max_range = static_cast<float> (atof (argv[++i]));
+    else if (arg == "--mapping_resolution")
+      options.mapping_resolution = static_cast<float> (atof (argv[++i]));
+    else if (arg == "--stride")
+      options.stride = std::max (atoi (argv[++i]), 1);
+    else if (arg == "--seed")
+      options.seed = static_cast<unsigned int> (atoi (argv[++i]));
+    else
+    {
+      printUsage (argv[0]);
+      return (1);
+    }
+  }
+  if (options.depth.empty () || options.rate <= 0.0 || options.duration <= 0.0 || options.mapping_resolution <= 0.0f)
+  {
+    printUsage (argv[0]);
+    return (1);
+  }
+  if (options.deadline_ms <= 0.0)
+    options.deadline_ms = 1000.0 / options.rate;
+
+  Sequence depth, rgb;
+  if (!depth.open (options.depth))
+  {
+    fprintf (stderr, "Could not load a depth sequence from %s\n", options.depth.c_str ());
+    return (1);
+  }
+  if (!options.rgb.empty () && !rgb.open (options.rgb))
+  {
+    fprintf (stderr, "Could not load an RGB sequence from %s\n", options.rgb.c_str ());
+    return (1);
+  }
+
+  Mailbox mailbox;
+  mailbox.full = mailbox.done = false;
+  mailbox.frame = mailbox.dropped = 0;
+  Stats stats;
+  stats.published = stats.processed = stats.failed = stats.deadline_misses = 0;
+  stats.processing_ms = 0.0;
+  stats.points = stats.voxels = 0;
+  stats.latencies_ms.reserve (static_cast<size_t> (options.rate * options.duration) + 1);
+
+  Clock::time_point start = Clock::now ();
+  std::thread front_end (process, std::cref (options), std::cref (depth),
+                         options.rgb.empty () ? static_cast<const Sequence*> (NULL) : &rgb,
+                         std::ref (mailbox), std::ref (stats));
+  publish (options, mailbox, stats);
+  front_end.join ();
+  stats.wall_s = elapsedMs (start, Clock::now ()) / 1000.0;
+
+  double mean_latency_ms = 0.0;
+  for (size_t i = 0; i < stats.latencies_ms.size (); ++i)
+    mean_latency_ms += stats.latencies_ms[i];
+  mean_latency_ms /= std::max<size_t> (stats.latencies_ms.size (), 1);
+  size_t misses = stats.deadline_misses + mailbox.dropped;
+
+  printf ("published %zu frames at %.1f Hz (jitter +-%.1f ms), processed %zu, dropped %zu, failed %zu\n",
+          stats.published, options.rate, options.jitter_ms, stats.processed, mailbox.dropped, stats.failed);
+  printf ("latency ms: mean %.3f p50 %.3f p99 %.3f max %.3f; deadline %.1f ms missed by %zu frames (%.1f%%)\n",
+          mean_latency_ms, percentile (stats.latencies_ms, 0.5), percentile (stats.latencies_ms, 0.99),
+          percentile (stats.latencies_ms, 1.0), options.deadline_ms, misses,
+          100.0 * double (misses) / std::max<size_t> (stats.published, 1));
+  printf ("throughput %.1f frames/s, %.3f ms of processing per frame, %zu voxels mapped\n",
+          double (stats.processed) / stats.wall_s, stats.processing_ms / std::max<size_t> (stats.processed, 1), stats.voxels);
+
+  if (!options.output.empty ())
+  {
+    std::ofstream out (options.output.c_str ());
+    out.precision (6);
+    out << "{\n"
+        << "\t\"replay_depth\":\"" << options.depth << "\",\n"
+        << "\t\"replay_rgb\":\"" << options.rgb << "\",\n"
+        << "\t\"replay_rate_hz\":" << options.rate << ",\n"
+        << "\t\"replay_jitter_ms\":" << options.jitter_ms << ",\n"
+        << "\t\"deadline_ms\":" << options.deadline_ms << ",\n"
+        << "\t\"frames_published\":" << stats.published << ",\n"
+        << "\t\"frames_processed\":" << stats.processed << ",\n"
+        << "\t\"frames_dropped\":" << mailbox.dropped << ",\n"
+        << "\t\"frames_failed\":" << stats.failed << ",\n"
+        << "\t\"deadline_misses\":" << misses << ",\n"
+        << "\t\"latency_mean_ms\":" << mean_latency_ms << ",\n"
+        << "\t\"latency_p50_ms\":" << percentile (stats.latencies_ms, 0.5) << ",\n"
+        << "\t\"latency_p99_ms\":" << percentile (stats.latencies_ms, 0.99) << ",\n"
+        << "\t\"latency_max_ms\":" << percentile (stats.latencies_ms, 1.0) << ",\n"
+        << "\t\"processing_mean_ms\":" << stats.processing_ms / std::max<size_t> (stats.processed, 1) << ",\n"
+        << "\t\"throughput_fps\":" << double (stats.processed) / stats.wall_s << ",\n"
+        << "\t\"points_mapped\":" << stats.points << ",\n"
+        << "\t\"voxels_mapped\":" << stats.voxels << "\n"
+        << "}\n";
+    if (!out)
+    {
+      fprintf (stderr, "Could not write %s\n", options.output.c_str ());
+      return (1);
+    }
+  }
+  return (stats.failed == 0 ? 0 : 1);
+}
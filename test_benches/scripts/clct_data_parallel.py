@@ -0,0 +1,335 @@
+#!/usr/bin/env python
+# Parallel version of clct_data_replay.py for config sweeps.
+#
+# Every (experiment, number of cores, processor frequency, run) combination of
+# a config is an independent job, like the nested loops of
+# clct_data_diff_cores_freq.py. Instead of running them one after another,
+# jobs run side by side on disjoint sets of cores of the local machine: each
+# job is pinned (sched_setaffinity, or a cpuset cgroup with --cgroup) to as
+# many cores as its num_of_cores, hyperthread siblings being kept together.
+#
+# Runs whose measurements would interfere are serialized:
+#   * --mode serial runs every job alone,
+#   * experiments with "exclusive": true in the config always run alone,
+#   * with --set_freq, jobs at different frequencies never overlap, since
+#     cores usually share their cpufreq policy.
+#
+# Runs record what they actually got: num_of_cores is the number of cores the
+# job was pinned to (fewer than requested when the pool is smaller) and
+# processor_freq the frequency read back from cpufreq (empty without
+# --set_freq); the requested values are kept as requested_*. With --set_freq,
+# a run whose frequency could not be applied fails instead of running.
+#
+# The swept values come from a "sweep_setting" object of the config, e.g.
+#   "sweep_setting": {"num_of_cores": [4, 3, 2], "processor_frequency": [2035200, 1574400, 806400]}
+# or from --cores / --freqs. All the results end up in one stats.json file, with
+# one "experiment_set_<n>" list per (experiment, cores, frequency) combination
+# and the runs in order, whatever order they completed in.
+from __future__ import print_function
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+import traceback
+
+from data_clct_conf_class import *
+from clct_data_replay import get_host_base, get_replay_setting, get_replay_cmd
+
+
+class Job:
+    def __init__(self, experiment_set, experiment_setting, num_of_cores, freq, run, experiment_number):
+        self.experiment_set = experiment_set
+        self.experiment_setting = experiment_setting
+        self.num_of_cores = num_of_cores
+        self.freq = freq
+        self.run = run
+        self.experiment_number = experiment_number
+        self.exclusive = experiment_setting.get("exclusive", False)
+        self.cpus = []
+        self.applied_freq = None
+        self.process = None
+        self.output = None
+        self.start_time = None
+
+
+def parse_int_list(value):
+    if value is None:
+        return None
+    return [int(x) for x in value.split(",") if x != ""]
+
+
+def parse_cpu_list(value):
+    cpus = []
+    for part in value.split(","):
+        if "-" in part:
+            first, last = part.split("-")
+            cpus += range(int(first), int(last) + 1)
+        elif part != "":
+            cpus.append(int(part))
+    return cpus
+
+
+def format_cpu_list(cpus):
+    return ",".join([str(cpu) for cpu in cpus])
+
+
+def read_sysfs(path, default=None):
+    try:
+        with open(path) as sysfs_file:
+            return sysfs_file.read().strip()
+    except (IOError, OSError):
+        return default
+
+
+def get_cpu_pool(cpus_arg):
+    if cpus_arg is not None:
+        cpus = parse_cpu_list(cpus_arg)
+    elif hasattr(os, "sched_getaffinity"):
+        cpus = sorted(os.sched_getaffinity(0))
+    else:
+        import multiprocessing
+        cpus = list(range(multiprocessing.cpu_count()))
+
+    # Keep the hyperthreads of a physical core next to each other, so that
+    # contiguous allocations do not split cores between jobs
+    def topology(cpu):
+        base = "/sys/devices/system/cpu/cpu" + str(cpu) + "/topology/"
+        return (int(read_sysfs(base + "physical_package_id", 0)), int(read_sysfs(base + "core_id", cpu)), cpu)
+    return sorted(cpus, key=topology)
+
+
+def expand_jobs(config_data, args):
+    sweep_setting = config_data.get("sweep_setting", {})
+    cores_list = parse_int_list(args.cores) or sweep_setting.get("num_of_cores")
+    freq_list = parse_int_list(args.freqs) or sweep_setting.get("processor_frequency")
+
+    jobs = []
+    experiment_sets = []
+    total_run_ctr = 0
+    for experiment_setting in config_data["experiment_setting_list"]:
+        for num_of_cores in (cores_list or [experiment_setting.get("num_of_cores", args.cores_per_run)]):
+            for freq in (freq_list or [experiment_setting.get("processor_frequency")]):
+                experiment_set = len(experiment_sets)
+                experiment_sets.append((experiment_setting, num_of_cores, freq))
+                for run in range(0, experiment_setting["number_of_runs"]):
+                    total_run_ctr += 1
+                    jobs.append(Job(experiment_set, experiment_setting, num_of_cores, freq, run, total_run_ctr))
+    return jobs, experiment_sets
+
+
+def can_start(job, running, free_cpus, pool, args):
+    if not running:
+        return True
+    if args.mode == "serial" or job.exclusive or any([r.exclusive for r in running]):
+        return False
+    if args.set_freq and any([r.freq != job.freq for r in running]):
+        return False
+    return len(free_cpus) >= min(job.num_of_cores, len(pool))
+
+
+def set_frequency(cpus, freq):
+    for cpu in cpus:
+        base = "/sys/devices/system/cpu/cpu" + str(cpu) + "/cpufreq/"
+        try:
+            # Open the range first, so that min <= max holds at every step
+            for name, value in [("scaling_min_freq", read_sysfs(base + "cpuinfo_min_freq")),
+                                ("scaling_max_freq", freq), ("scaling_min_freq", freq)]:
+                with open(base + name, "w") as sysfs_file:
+                    sysfs_file.write(str(value))
+        except (IOError, OSError) as e:
+            print("could not set the frequency of cpu " + str(cpu) + ": " + str(e))
+            return False
+    return True
+
+
+def read_frequency(cpus):
+    # The frequency the cores are pinned to, None if they do not all agree
+    freqs = set()
+    for cpu in cpus:
+        base = "/sys/devices/system/cpu/cpu" + str(cpu) + "/cpufreq/"
+        freqs.add((read_sysfs(base + "scaling_min_freq"), read_sysfs(base + "scaling_max_freq")))
+    if len(freqs) != 1:
+        return None
+    min_freq, max_freq = freqs.pop()
+    if min_freq is None or min_freq != max_freq:
+        return None
+    return int(max_freq)
+
+
+def restore_frequency(cpus):
+    for cpu in cpus:
+        base = "/sys/devices/system/cpu/cpu" + str(cpu) + "/cpufreq/"
+        try:
+            with open(base + "scaling_min_freq", "w") as sysfs_file:
+                sysfs_file.write(read_sysfs(base + "cpuinfo_min_freq"))
+            with open(base + "scaling_max_freq", "w") as sysfs_file:
+                sysfs_file.write(read_sysfs(base + "cpuinfo_max_freq"))
+        except (IOError, OSError, TypeError):
+            pass
+
+
+def start_job(job, cpus, config_data, args):
+    job.cpus = cpus
+    replay_setting = get_replay_setting(config_data, job.experiment_setting, args)
+    if "depth" not in replay_setting:
+        print("experiment set " + str(job.experiment_set) + ": no depth sequence to replay (replay_setting.depth or --depth)")
+        sys.exit(1)
+    run_time = job.experiment_setting["max_run_time"]
+    if args.max_run_time is not None:
+        run_time = min(run_time, args.max_run_time)
+    job.output = tempfile.mktemp(suffix=".json", prefix="lzf_replay_")
+    cmd = get_replay_cmd(args.replay_bin, replay_setting, job.experiment_setting, run_time, job.run, job.output)
+    if args.set_freq and job.freq is not None:
+        # Runs at another frequency than the one requested would end up in the
+        # wrong experiment set, so they fail instead
+        if set_frequency(cpus, job.freq):
+            job.applied_freq = read_frequency(cpus)
+        if job.applied_freq != int(job.freq):
+            print("run " + str(job.experiment_number) + ": cpus " + format_cpu_list(cpus) + " are at " +
+                  str(job.applied_freq) + " instead of " + str(job.freq) + " kHz, not running it")
+            return False
+
+    preexec_fn = None
+    if args.cgroup:
+        cmd = ["systemd-run", "--user", "--scope", "--quiet", "-p", "AllowedCPUs=" + format_cpu_list(cpus)] + cmd
+    if hasattr(os, "sched_setaffinity"):
+        preexec_fn = lambda: os.sched_setaffinity(0, cpus)
+    else:
+        cmd = ["taskset", "-c", format_cpu_list(cpus)] + cmd
+
+    print("[cpus " + format_cpu_list(cpus) + "] " + " ".join(cmd))
+    sys.stdout.flush()
+    log = open(job.output + ".log", "w")
+    job.process = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT, preexec_fn=preexec_fn)
+    log.close()
+    job.start_time = time.time()
+    return True
+
+
+def collect_job(job):
+    result = None
+    if os.path.isfile(job.output):
+        with open(job.output) as result_file:
+            result = json.load(result_file)
+        os.remove(job.output)
+    with open(job.output + ".log") as log:
+        sys.stdout.write(log.read())
+    os.remove(job.output + ".log")
+    if result is None:
+        print("run " + str(job.experiment_number) + " produced no results")
+        return None
+
+    # Same keys as clct_data.py / clct_data_diff_cores_freq.py, with what was
+    # actually applied: the frequency read back from cpufreq (empty without
+    # --set_freq) and the number of cores the job ran on
+    experiment_setting = job.experiment_setting
+    result["app"] = experiment_setting["application"]
+    result["processor_freq"] = str(job.applied_freq if job.applied_freq is not None else "")
+    result["requested_processor_freq"] = str(job.freq if job.freq is not None else "")
+    for param in experiment_setting.get("ros_params", {}).keys():
+        result[param] = str(experiment_setting["ros_params"][param])
+    result["experiment_number"] = job.experiment_number
+    result["num_of_cores"] = len(job.cpus)
+    result["requested_num_of_cores"] = job.num_of_cores
+    result["cpus"] = format_cpu_list(job.cpus)
+    result["replay_exit_code"] = job.process.returncode
+    result["run_time_s"] = time.time() - job.start_time
+    return result
+
+
+def schedule(jobs, pool, config_data, args):
+    pending = list(jobs)
+    running = []
+    free_cpus = list(pool)
+    results = {}
+    while pending or running:
+        # Start jobs in order; a job that does not fit blocks the ones after it,
+        # so that large jobs are not starved by small ones
+        while pending and can_start(pending[0], running, free_cpus, pool, args):
+            job = pending.pop(0)
+            n = min(job.num_of_cores, len(pool))
+            cpus, free_cpus = free_cpus[:n], free_cpus[n:]
+            if start_job(job, cpus, config_data, args):
+                running.append(job)
+            else:
+                free_cpus = sorted(free_cpus + cpus, key=pool.index)
+                results[job] = None
+                if args.set_freq and not running:
+                    restore_frequency(pool)
+
+        time.sleep(0.1)
+        for job in [r for r in running if r.process.poll() is not None]:
+            running.remove(job)
+            if args.set_freq and not running:
+                restore_frequency(pool)
+            free_cpus = sorted(free_cpus + job.cpus, key=pool.index)
+            results[job] = collect_job(job)
+    return results
+
+
+def main():
+    host_base_dir = get_host_base()
+    parser = argparse.ArgumentParser(description='MAVBench parallel local experiment sweep.')
+    parser.add_argument('--config', metavar='c', type=str,
+                        default=os.path.join(host_base_dir, "test_benches", "configs", "scaling.json"),
+                        help='config json file path')
+    parser.add_argument('--replay_bin', type=str,
+                        default=os.path.join(host_base_dir, "test_benches", "benchmarks", "lzf_replay"),
+                        help='lzf_replay executable')
+    parser.add_argument('--output', type=str, default="stats.json", help='merged stats file to write')
+    parser.add_argument('--mode', choices=["parallel", "serial"], default="parallel",
+                        help='run independent jobs side by side, or one at a time')
+    parser.add_argument('--cpus', type=str, help='cores available to the jobs, e.g. 0-7 (default: all)')
+    parser.add_argument('--cores', type=str, help='numbers of cores to sweep, e.g. 4,3,2')
+    parser.add_argument('--freqs', type=str, help='processor frequencies to sweep (kHz), e.g. 2035200,806400')
+    parser.add_argument('--cores_per_run', type=int, default=2,
+                        help='cores of a job when neither the sweep nor the experiment gives num_of_cores')
+    parser.add_argument('--set_freq', action='store_true',
+                        help='apply processor_frequency through cpufreq (needs root); serializes different frequencies')
+    parser.add_argument('--cgroup', action='store_true',
+                        help='also confine every job to a cpuset cgroup (systemd-run)')
+    parser.add_argument('--max_run_time', type=float,
+                        help='cap the max_run_time of every experiment (in s), e.g. for quick checks')
+    for key, key_type in [("depth", str), ("rgb", str), ("parameters", str), ("rate", float),
+                          ("jitter_ms", float), ("deadline_ms", float), ("stride", int)]:
+        parser.add_argument('--' + key, type=key_type, help='replay ' + key + ', see clct_data_replay.py')
+    args = parser.parse_args()
+
+    config_data = DataClctConf(args.config).get_config_data()
+    jobs, experiment_sets = expand_jobs(config_data, args)
+    pool = get_cpu_pool(args.cpus)
+    print(str(len(jobs)) + " runs in " + str(len(experiment_sets)) + " experiment sets on cpus " + format_cpu_list(pool))
+    for num_of_cores in sorted(set([job.num_of_cores for job in jobs])):
+        if num_of_cores > len(pool):
+            print("runs with num_of_cores " + str(num_of_cores) + " only get " + str(len(pool)) +
+                  " cores, recorded as num_of_cores " + str(len(pool)))
+
+    failed = False
+    results = {}
+    try:
+        results = schedule(jobs, pool, config_data, args)
+    except Exception:
+        print(traceback.format_exception(*sys.exc_info()))
+        failed = True
+
+    stats = {}
+    for experiment_set in range(0, len(experiment_sets)):
+        stats["experiment_set_" + str(experiment_set)] = []
+    for job in jobs:
+        result = results.get(job)
+        if result is None:
+            failed = True
+            continue
+        stats["experiment_set_" + str(job.experiment_set)].append(result)
+
+    with open(args.output, "w") as stats_file:
+        json.dump(stats, stats_file, indent=4, sort_keys=True)
+    print("wrote " + args.output)
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
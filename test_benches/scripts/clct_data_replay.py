@@ -0,0 +1,139 @@
+#!/usr/bin/env python
+# Local stand-in for clct_data.py: instead of driving Unreal/AirSim on a
+# Windows host and the companion computer over ssh, every experiment of the
+# config replays recorded PCL-LZF depth/RGB sequences into the local
+# perception front-end (test_benches/benchmarks/lzf_replay) and collects the
+# frame latency, deadline misses and throughput into a stats.json file with
+# the usual "experiment_set_<n>" layout (see manipulate_json.py).
+#
+# The experiment configs are used as is (experiment_setting_list,
+# number_of_runs, max_run_time, ros_params.sensor_max_range and
+# mapping_resolution). What to replay is given by a "replay_setting" object,
+# either at the top level of the config or per experiment, e.g.
+#   "replay_setting": {"depth": "/data/depth.pclzs", "rgb": "/data/rgb.pclzs",
+#                      "rate": 30, "jitter_ms": 2}
+# or on the command line (--depth, --rgb), which takes precedence.
+from __future__ import print_function
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import traceback
+
+from data_clct_conf_class import *
+
+
+def get_host_base():
+    file_dir = os.path.dirname(os.path.abspath(sys.argv[0]))
+    return os.path.abspath(os.path.join(file_dir, "..", ".."))
+
+
+def get_replay_setting(config_data, experiment_setting, args):
+    replay_setting = dict(config_data.get("replay_setting", {}))
+    replay_setting.update(experiment_setting.get("replay_setting", {}))
+    for key in ["depth", "rgb", "parameters", "rate", "jitter_ms", "deadline_ms", "stride"]:
+        value = getattr(args, key)
+        if value is not None:
+            replay_setting[key] = value
+    return replay_setting
+
+
+def get_replay_cmd(replay_bin, replay_setting, experiment_setting, run_time, seed, output):
+    ros_params = experiment_setting.get("ros_params", {})
+    cmd = [replay_bin,
+           "--depth", str(replay_setting["depth"]),
+           "--duration", str(run_time),
+           "--seed", str(seed),
+           "--output", output]
+    for key in ["rgb", "parameters", "rate", "jitter_ms", "deadline_ms", "stride"]:
+        if replay_setting.get(key) is not None:
+            cmd += ["--" + key, str(replay_setting[key])]
+    for key in ["sensor_max_range", "mapping_resolution"]:
+        if key in ros_params:
+            cmd += ["--" + key, str(ros_params[key])]
+    return cmd
+
+
+def run_experiment(cmd):
+    print(" ".join(cmd))
+    sys.stdout.flush()
+    ret = subprocess.call(cmd)
+    output = cmd[cmd.index("--output") + 1]
+    if not os.path.isfile(output):
+        return None
+    with open(output) as result_file:
+        result = json.load(result_file)
+    os.remove(output)
+    result["replay_exit_code"] = ret
+    return result
+
+
+def main():
+    host_base_dir = get_host_base()
+    parser = argparse.ArgumentParser(description='MAVBench local replay data collection.')
+    parser.add_argument('--config', metavar='c', type=str,
+                        default=os.path.join(host_base_dir, "test_benches", "configs", "helloworld_config.json"),
+                        help='config json file path')
+    parser.add_argument('--replay_bin', type=str,
+                        default=os.path.join(host_base_dir, "test_benches", "benchmarks", "lzf_replay"),
+                        help='lzf_replay executable')
+    parser.add_argument('--output', type=str, default="stats.json", help='stats file to write')
+    parser.add_argument('--depth', type=str, help='depth .pclzs stream or directory of .pclzf files')
+    parser.add_argument('--rgb', type=str, help='rgb .pclzs stream or directory of .pclzf files')
+    parser.add_argument('--parameters', type=str, help='depth camera parameters (.xml)')
+    parser.add_argument('--rate', type=float, help='sensor rate in Hz')
+    parser.add_argument('--jitter_ms', type=float, help='sensor timing jitter in ms')
+    parser.add_argument('--deadline_ms', type=float, help='per frame deadline in ms (default: the sensor period)')
+    parser.add_argument('--stride', type=int, help='depth decimation factor')
+    parser.add_argument('--max_run_time', type=float,
+                        help='cap the max_run_time of every experiment (in s), e.g. for quick checks')
+    args = parser.parse_args()
+
+    config_data = DataClctConf(args.config).get_config_data()
+    experiment_setting_list = config_data["experiment_setting_list"]
+    stats = {}
+    total_run_ctr = 0
+    failed = False
+    try:
+        for experiment_set_ctr, experiment_setting in enumerate(experiment_setting_list):
+            replay_setting = get_replay_setting(config_data, experiment_setting, args)
+            if "depth" not in replay_setting:
+                print("experiment " + str(experiment_set_ctr) + ": no depth sequence to replay (replay_setting.depth or --depth)")
+                sys.exit(1)
+            run_time = experiment_setting["max_run_time"]
+            if args.max_run_time is not None:
+                run_time = min(run_time, args.max_run_time)
+
+            runs = []
+            for experiment_run_ctr in range(0, experiment_setting["number_of_runs"]):
+                total_run_ctr += 1
+                output = tempfile.mktemp(suffix=".json", prefix="lzf_replay_")
+                cmd = get_replay_cmd(args.replay_bin, replay_setting, experiment_setting,
+                                     run_time, experiment_run_ctr, output)
+                result = run_experiment(cmd)
+                if result is None:
+                    print("run " + str(total_run_ctr) + " produced no results")
+                    failed = True
+                    continue
+                # Same keys as clct_data.py, so both kinds of stats can be plotted together
+                result["app"] = experiment_setting["application"]
+                result["processor_freq"] = str(experiment_setting.get("processor_frequency", ""))
+                for param in experiment_setting.get("ros_params", {}).keys():
+                    result[param] = str(experiment_setting["ros_params"][param])
+                result["experiment_number"] = total_run_ctr
+                runs.append(result)
+            stats["experiment_set_" + str(experiment_set_ctr)] = runs
+    except Exception:
+        print(traceback.format_exception(*sys.exc_info()))
+        failed = True
+
+    with open(args.output, "w") as stats_file:
+        json.dump(stats, stats_file, indent=4, sort_keys=True)
+    print("wrote " + args.output)
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()